@@ -6,38 +6,151 @@
 
 #include "AVLTree.h"
 
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+
 namespace tree {
 
-template<typename T>
-AVLTree<T>::AVLTree() :
-		BinarySearchTree<T>() {
+template<typename T, typename N>
+AVLTree<T, N>::AVLTree(std::pmr::memory_resource* resource) :
+		BinarySearchTree<T, N>(resource) {
 }
 
-template<typename T>
-bool AVLTree<T>::insertNode(Node<T>* node) {
+template<typename T, typename N>
+void AVLTree<T, N>::rebalanceInsert(Node<T>* node, NodePath<T>& path) {
+	// The node has been linked to the tree without restrictions => balance the
+	// tree going up its path
+	setHeight(node, 1);
+	balanceTree(path, true);
+}
 
-	// This first part consists of inserting the node into the tree, without
-	// restrictions.
-	std::stack<Node<T>*> stackTree = std::stack<Node<T>*>();
-	if (!BinarySearchTree<T>::insertNode(node, &stackTree))
+template<typename T, typename N>
+bool AVLTree<T, N>::deleteNode(const T& key) {
+	NodePath<T> path;
+	if (!BinarySearchTree<T, N>::deleteNode(key, &path))
 		return false;
-
-	// This second part consists of balancing the tree
-	balanceTree(stackTree, node->key);
+	balanceTree(path, false);
 	return true;
 }
 
-template<typename T>
-bool AVLTree<T>::deleteNode(const T& key) {
-	std::stack<Node<T>*> stackTree;
-	if (!BinarySearchTree<T>::deleteNode(key, &stackTree))
-		return false;
-	balanceTree(stackTree, key);
-	return true;
+template<typename T, typename N>
+size_t AVLTree<T, N>::insertSorted(const std::vector<T>& keys) {
+	size_t inserted = 0;
+	this->root = mergeSubtree(this->root, keys.data(), keys.data() + keys.size(),
+			inserted);
+	return inserted;
+}
+
+template<typename T, typename N>
+void AVLTree<T, N>::resetBalance() {
+	// The mirrored pre-order (node, right, left) backwards is the post-order, so
+	// the children of every node are set before it. Heights saturate: no AVL tree
+	// is nearly as high as the maximum one
+	std::vector<Node<T>*> nodes;
+	this->walkNodes(this->root, true, true, [&nodes](Node<T>* node, size_t) {
+		nodes.push_back(node);
+	});
+	bool balanced = true;
+	for (typename std::vector<Node<T>*>::reverse_iterator it = nodes.rbegin();
+			it != nodes.rend(); ++it) {
+		Node<T>* node = *it;
+		int left = height(node->left);
+		int right = height(node->right);
+		balanced = balanced && (std::abs(left - right) <= 1);
+		setHeight(node, std::min(1 + std::max(left, right), int(UCHAR_MAX)));
+	}
+	if (!balanced || ((this->root != nullptr) && (height(this->root) == UCHAR_MAX)))
+		this->rebuild();
+}
+
+template<typename T, typename N>
+Node<T>* AVLTree<T, N>::mergeSubtree(Node<T>* node, const T* first,
+		const T* last, size_t& inserted) {
+	if (first == last)
+		return node;
+	// An empty place => the keys become a subtree of minimum height
+	if (node == nullptr) {
+		size_t n = last - first;
+		inserted += n;
+		const T* it = first;
+		return this->buildSubtree(it, last, n);
+	}
+	const T* mid = std::lower_bound(first, last, node->key);
+	// The key of the node is not inserted again
+	const T* next = ((mid != last) && !(node->key < *mid)) ? mid + 1 : mid;
+	Node<T>* left = mergeSubtree(node->left, first, mid, inserted);
+	Node<T>* right = mergeSubtree(node->right, next, last, inserted);
+	return join(left, node, right);
+}
+
+template<typename T, typename N>
+Node<T>* AVLTree<T, N>::join(Node<T>* left, Node<T>* node, Node<T>* right) {
+	if (height(left) > height(right) + 1)
+		return joinRight(left, node, right);
+	if (height(right) > height(left) + 1)
+		return joinLeft(left, node, right);
+	node->left = left;
+	node->right = right;
+	updateNode(node);
+	return node;
+}
+
+template<typename T, typename N>
+Node<T>* AVLTree<T, N>::joinRight(Node<T>* left, Node<T>* node,
+		Node<T>* right) {
+	// Go down the right spine until a subtree which is low enough
+	Node<T>* spine = left->right;
+	if (height(spine) <= height(right) + 1) {
+		node->left = spine;
+		node->right = right;
+		updateNode(node);
+		left->right = node;
+		if (height(node) <= height(left->left) + 1) {
+			updateNode(left);
+			return left;
+		}
+		// => R+L
+		left->right = rotateRight(node);
+		return rotateLeft(left);
+	}
+	left->right = joinRight(spine, node, right);
+	if (height(left->right) <= height(left->left) + 1) {
+		updateNode(left);
+		return left;
+	}
+	// => R+R
+	return rotateLeft(left);
 }
 
-template<typename T>
-void AVLTree<T>::pointParentToChild(Node<T>** root, Node<T>** parent,
+template<typename T, typename N>
+Node<T>* AVLTree<T, N>::joinLeft(Node<T>* left, Node<T>* node,
+		Node<T>* right) {
+	Node<T>* spine = right->left;
+	if (height(spine) <= height(left) + 1) {
+		node->left = left;
+		node->right = spine;
+		updateNode(node);
+		right->left = node;
+		if (height(node) <= height(right->right) + 1) {
+			updateNode(right);
+			return right;
+		}
+		// => L+R
+		right->left = rotateLeft(node);
+		return rotateRight(right);
+	}
+	right->left = joinLeft(left, node, spine);
+	if (height(right->left) <= height(right->right) + 1) {
+		updateNode(right);
+		return right;
+	}
+	// => L+L
+	return rotateRight(right);
+}
+
+template<typename T, typename N>
+void AVLTree<T, N>::pointParentToChild(Node<T>** root, Node<T>** parent,
 		Node<T>** child) {
 	if (*parent != nullptr) {
 		if ((*parent)->key < (*child)->key)
@@ -49,22 +162,46 @@ void AVLTree<T>::pointParentToChild(Node<T>** root, Node<T>** parent,
 
 }
 
-template<typename T>
-void AVLTree<T>::balanceTree(std::stack<Node<T>*>& stackTree, T nodeKey) {
-	Node<T>* x;
-	Node<T>* y;
-	Node<T>* z;
+template<typename T, typename N>
+int AVLTree<T, N>::height(Node<T>* node) {
+	return (node == nullptr) ? 0 : static_cast<N*>(node)->height;
+}
 
-	if (stackTree.size() < 2) {
-		return;
-	}
-	// The element inserted is not in the stack tree
-	// The parent of the element inserted can be removed from the stack
-	// because we can only have an unbalanced tree after when height >= 2
-	stackTree.pop();
+template<typename T, typename N>
+void AVLTree<T, N>::setHeight(Node<T>* node, int height) {
+	static_cast<N*>(node)->height = height;
+}
 
-	Node<T>* parent = nullptr;
+template<typename T, typename N>
+void AVLTree<T, N>::updateNode(Node<T>* node) {
+	setHeight(node, 1 + std::max(height(node->left), height(node->right)));
+	BinarySearchTree<T, N>::setSize(node,
+			1 + BinarySearchTree<T, N>::subtreeSize(node->left)
+					+ BinarySearchTree<T, N>::subtreeSize(node->right));
+}
+
+template<typename T, typename N>
+Node<T>* AVLTree<T, N>::rotateLeft(Node<T>* z) {
+	Node<T>* y = z->right;
+	z->right = y->left;
+	y->left = z;
+	updateNode(z);
+	updateNode(y);
+	return y;
+}
+
+template<typename T, typename N>
+Node<T>* AVLTree<T, N>::rotateRight(Node<T>* z) {
+	Node<T>* y = z->left;
+	z->left = y->right;
+	y->right = z;
+	updateNode(z);
+	updateNode(y);
+	return y;
+}
 
+template<typename T, typename N>
+void AVLTree<T, N>::balanceTree(NodePath<T>& path, bool insertion) {
 	//		LL CASE
 	//		___________________________________________________________
 	//		T1, T2, T3 and T4 are subtrees.
@@ -106,72 +243,50 @@ void AVLTree<T>::balanceTree(std::stack<Node<T>*>& stackTree, T nodeKey) {
 	//		  / \                              /  \
 	//		T2   T3                           T3   T4
 
-	// If the stackTree is empty, the root node has 1 or 2 children.
-	// Otherwise, we have to check whether it is balanced or not
-	// To get the first unbalanced subtree, we go from the bottom to the top
-	// The first time we find the unbalanced tree, we balance it by using
-	// the RR, RL, LL or LR movement
-	while (!stackTree.empty()) {
-		Node<T>* subtree = stackTree.top();
-		stackTree.pop();
-		std::cout << "stack size: " << stackTree.size() << std::endl;
-		int balance = BinarySearchTree<T>::getHeight(subtree->right)
-				- BinarySearchTree<T>::getHeight(subtree->left);
-		if (std::abs(balance) > 1) {
-			z = subtree;
-			BinarySearchTree<T>::search(BinarySearchTree<T>::root, z->key,
-					&parent);
-			if (balance == -1) { // => L
-				y = subtree->left;
-				if (nodeKey > subtree->left->key) { // => L+R
-					x = subtree->left->right;
-					// Turn left the small subtree and then right the big subtree
-					y->right = x->left;
-					z->left = x->right;
-					x->left = y;
-					x->right = z;
-					pointParentToChild(&(BinarySearchTree<T>::root), &parent,
-							&x);
-				} else { // L+L
-					x = subtree->left->left;
-					// Turn left the subtree once
-					z->left = y->right;
-					y->right = z;
-					pointParentToChild(&(BinarySearchTree<T>::root), &parent,
-							&y);
-				}
-			} else { // balance == +1 => R
-				y = subtree->right;
-				if (nodeKey < subtree->right->key) { // => R+L
-					x = subtree->right->left;
-					// Turn right the small subtree and then left the big subtree
-					z->right = x->left;
-					y->left = x->right;
-					x->left = z;
-					x->right = y;
-					pointParentToChild(&(BinarySearchTree<T>::root), &parent,
-							&x);
-				} else { // => R + R
-					x = subtree->right->right;
-					// Turn right the subtree once
-					z->right = y->left;
-					y->left = z;
-					pointParentToChild(&(BinarySearchTree<T>::root), &parent,
-							&y);
-				}
-			}
+	// We go from the bottom to the top updating the cached heights. Each time we
+	// find an unbalanced subtree, we balance it by using the RR, RL, LL or LR
+	// movement. After an insertion, the rotated subtree gets back the height it
+	// had before the insertion, so nothing changes above it and we can stop. After
+	// a deletion, the rotated subtree may be one level shorter, so we have to go
+	// on up to the root. In both cases we can stop as soon as the height of a
+	// balanced subtree does not change.
+	while (!path.empty()) {
+		Node<T>* z = path.top();
+		path.pop();
+		int oldHeight = height(z);
+		updateNode(z);
+		int balance = height(z->right) - height(z->left);
+		if (std::abs(balance) <= 1) {
+			if (height(z) == oldHeight)
+				break;
+			continue;
+		}
 
-			break;
+		Node<T>* subtree;
+		if (balance < 0) { // => L
+			if (height(z->left->right) > height(z->left->left)) // => L+R
+				z->left = rotateLeft(z->left);
+			// L+L (or L+R after turning left the small subtree)
+			subtree = rotateRight(z);
+		} else { // => R
+			if (height(z->right->left) > height(z->right->right)) // => R+L
+				z->right = rotateRight(z->right);
+			// R+R (or R+L after turning right the small subtree)
+			subtree = rotateLeft(z);
 		}
+		Node<T>* parent = path.empty() ? nullptr : path.top();
+		pointParentToChild(&(BinarySearchTree<T, N>::root), &parent, &subtree);
+		if (insertion || (height(subtree) == oldHeight))
+			break;
 	}
-	// Empty the stack tree
-	while (!stackTree.empty())
-		stackTree.pop();
+	path.clear();
 }
 
 template class AVLTree<int> ;
 template class AVLTree<float> ;
 template class AVLTree<double> ;
 template class AVLTree<std::string> ;
+template class AVLTree<int, AVLNode<ExtendedNode<int, int>>> ;
+template class AVLTree<int, AVLNode<SizedNode<Node<int>>>> ;
 
 } /* namespace tree */
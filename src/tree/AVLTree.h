@@ -9,8 +9,10 @@
 
 #include "BinarySearchTree.h"
 #include "Node.h"
+#include "NodePath.h"
 
-#include <stack>
+#include <cstddef>
+#include <vector>
 
 namespace tree {
 
@@ -20,27 +22,45 @@ namespace tree {
  * is balanced, i.e. the difference between the shortest and the longest
  * path is, as much, 1
  */
-template<typename T>
-class AVLTree: public BinarySearchTree<T> {
+template<typename T, typename N = AVLNode<Node<T>>>
+class AVLTree: public BinarySearchTree<T, N> {
+	static_assert(N::HAS_HEIGHT, "The nodes of an AVL tree are AVLNode");
 public:
 	/**
 	 * Class constructor
+	 * @param[in] resource Memory resource backing the nodes created by the tree
 	 */
-	AVLTree();
-	/**
-	 * Insert a new node with a given value in the tree
-	 * @param[in] node Node to insert in the tree
-	 * @return Returns true if the node has been inserted, or false
-	 * otherwise
-	 * @see BinaryTree
-	 */
-	bool insertNode(Node<T>* node);
+	explicit AVLTree(std::pmr::memory_resource* resource =
+			std::pmr::get_default_resource());
 	/**
 	 * Removes a node with a given value
 	 * @param[in] key Key to remove from the tree
 	 * @see BinaryTree
 	 */
 	bool deleteNode(const T& key);
+protected:
+	/**
+	 * Balance the tree going up from a new node (see balanceTree)
+	 * @param[in] node Node which has been linked
+	 * @param[in|out] path Nodes from the root to the parent of the node (it is
+	 * cleared)
+	 */
+	void rebalanceInsert(Node<T>* node, NodePath<T>& path);
+	/**
+	 * Merge a batch of keys into the tree, keeping it balanced (see
+	 * BinarySearchTree::insertBatch)
+	 * @param[in] keys Keys to insert, sorted in ascending order and without
+	 * repeated ones
+	 * @return Number of keys which have been inserted
+	 */
+	size_t insertSorted(const std::vector<T>& keys);
+	/**
+	 * Check a tree built by buildFromSorted or deserialize: the heights are
+	 * computed again, and a tree which is not balanced (e.g. one written by a
+	 * BinarySearchTree) is linked again as a tree of minimum height (see
+	 * BinarySearchTree::rebuild)
+	 */
+	void resetBalance();
 private:
 	/**
 	 * Set the child in the right place for the parent, or to the root if
@@ -52,13 +72,81 @@ private:
 	void pointParentToChild(Node<T>** root, Node<T>** parent, Node<T>** child);
 	/**
 	 * This method balances the tree by applying the RR, RL, LL, LR movements regarding
-	 * the condition of the balancing
-	 * @param[in] parent Parent of the unbalanced subtree
-	 * @param[in] stackTree Stack with the nodes from the bottom to the top after the
-	 * insertion
-	 * @param[in] nodeKey Key of the last node inserted
+	 * the condition of the balancing. The cached heights of the nodes in the path are
+	 * updated on the way up, so only O(log n) nodes are visited. The sizes of the
+	 * subtrees in the path have already been updated by BinarySearchTree (so the
+	 * walk can stop early), and rotations only recount the nodes they move.
+	 * @param[in] path Nodes from the root to the parent of the inserted node, or to
+	 * the parent of the node unlinked by a deletion
+	 * @param[in] insertion Whether the path comes from an insertion (at most one
+	 * rotation is needed) or from a deletion (rotations may be needed up to the root)
+	 */
+	void balanceTree(NodePath<T>& path, bool insertion);
+	/**
+	 * Merge a sorted range of keys into a subtree. Both children are merged first,
+	 * and then they are joined again with the node, which balances the subtree
+	 * even if many keys have gone down the same side
+	 * @param[in] node Root of the subtree (a valid AVL tree)
+	 * @param[in] first Beginning of the range of keys which go into the subtree
+	 * @param[in] last End of the range
+	 * @param[in|out] inserted Number of keys inserted so far
+	 * @return New root of the subtree
+	 */
+	Node<T>* mergeSubtree(Node<T>* node, const T* first, const T* last,
+			size_t& inserted);
+	/**
+	 * Join two AVL trees and a node whose key goes between them into a single AVL
+	 * tree, in O(difference of heights)
+	 * @param[in] left Tree with the lower keys
+	 * @param[in] node Node with the key in the middle
+	 * @param[in] right Tree with the higher keys
+	 * @return Root of the joined tree
+	 */
+	static Node<T>* join(Node<T>* left, Node<T>* node, Node<T>* right);
+	/**
+	 * Join two trees when the left one is higher: the node and the right tree are
+	 * linked down the right spine of the left one, and rotations balance it on the
+	 * way up
+	 * @see join
+	 */
+	static Node<T>* joinRight(Node<T>* left, Node<T>* node, Node<T>* right);
+	/**
+	 * Join two trees when the right one is higher (the mirror of joinRight)
+	 * @see join
+	 */
+	static Node<T>* joinLeft(Node<T>* left, Node<T>* node, Node<T>* right);
+	/**
+	 * Get the cached height of a subtree
+	 * @param[in] node Root of the subtree
+	 * @return Height of the subtree (0 for an empty one)
+	 */
+	static int height(Node<T>* node);
+	/**
+	 * Set the cached height of a subtree
+	 * @param[in] node Root of the subtree
+	 * @param[in] height Height of the subtree
+	 */
+	static void setHeight(Node<T>* node, int height);
+	/**
+	 * Recompute the cached height and size of a node from those of its children.
+	 * Sizes are recomputed even if the tree does not keep order statistics (they
+	 * are counted again when it starts to), since the children are already in the
+	 * cache
+	 * @param[in|out] node Node to update
+	 */
+	static void updateNode(Node<T>* node);
+	/**
+	 * Rotate a subtree to the left: the right child becomes the root of the subtree
+	 * @param[in] z Root of the subtree
+	 * @return New root of the subtree
+	 */
+	static Node<T>* rotateLeft(Node<T>* z);
+	/**
+	 * Rotate a subtree to the right: the left child becomes the root of the subtree
+	 * @param[in] z Root of the subtree
+	 * @return New root of the subtree
 	 */
-	void balanceTree(std::stack<Node<T>*>& stackTree, T nodeKey);
+	static Node<T>* rotateRight(Node<T>* z);
 };
 
 } /* namespace tree */
@@ -7,26 +7,128 @@
 #ifndef SRC_TREE_BNODE_H_
 #define SRC_TREE_BNODE_H_
 
+#include "OptimisticLock.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <string>
-#include <vector>
 
 namespace tree {
 
-template <typename T>
-struct BNode {
-	std::vector<T> keys;
-	std::vector<T> values;
-	std::vector<BNode<T>*> children;
-	BNode() : keys(), values(), children() {
-	};
-	virtual ~BNode() {
-		keys.clear();
-		values.clear();
-		for (BNode<T>* node : children)
-			delete node;
-		children.clear();
+/**
+ * Size (in bytes) b-tree nodes are sized to by default: 16 cache lines
+ */
+const size_t BNODE_DEFAULT_SIZE = 1024;
+/**
+ * Size (in bytes) of a memory page, for nodes which fill a whole page
+ */
+const size_t BNODE_PAGE_SIZE = 4096;
+
+/**
+ * Get the minimum degree d for b-tree nodes of a given size. A node with degree d
+ * keeps up to 2d-1 keys and values and up to 2d children.
+ * @param[in] bytes Size of the node
+ * @return Minimum degree (2 at least)
+ */
+template<typename K, typename V = K>
+constexpr unsigned short bnodeDegree(size_t bytes) {
+	return static_cast<unsigned short>(std::max<size_t>(2,
+			(bytes - 64 + sizeof(K) + sizeof(V))
+					/ (2 * (sizeof(K) + sizeof(V) + sizeof(void*)))));
+}
+
+/**
+ * Move the elements at [pos, count) of an array one position to the right
+ * @param[in|out] array Array to update (it must have room for count + 1 elements)
+ * @param[in] pos First position to move
+ * @param[in] count Number of elements in the array
+ */
+template<typename E>
+void shiftRight(E* array, size_t pos, size_t count) {
+	std::move_backward(array + pos, array + count, array + count + 1);
+}
+
+/**
+ * Move the elements at (pos, count) of an array one position to the left,
+ * overwriting the element at pos
+ * @param[in|out] array Array to update
+ * @param[in] pos Position to overwrite
+ * @param[in] count Number of elements in the array
+ */
+template<typename E>
+void shiftLeft(E* array, size_t pos, size_t count) {
+	std::move(array + pos + 1, array + count, array + pos);
+}
+
+/**
+ * This structure represents a node in the b-tree. Keys, values and children are
+ * kept inline in fixed arrays, keys first, so the keys of a node are a single
+ * contiguous block and nodes can be aligned to cache lines. Nodes are owned by the
+ * tree, which destroys them (children are not destroyed together with their parent).
+ * Every slot of the arrays holds an object, so keys and values must be default
+ * constructible; entries are moved from slot to slot, so values may be move-only.
+ */
+template<typename K, typename V = K,
+		unsigned short Degree = bnodeDegree<K, V>(BNODE_DEFAULT_SIZE)>
+struct alignas(64) BNode {
+	static_assert(Degree >= 2, "The minimum degree of a b-tree is 2");
+	// Maximum number of keys (and values) in a node
+	static constexpr unsigned short MAX_KEYS = 2 * Degree - 1;
+	// Number of keys in the node
+	unsigned short count;
+	// Whether the node has no children
+	bool leaf;
+	K keys[MAX_KEYS];
+	V values[MAX_KEYS];
+	BNode<K, V, Degree>* children[MAX_KEYS + 1];
+	BNode(bool leaf = true) :
+			count(0), leaf(leaf) {
+	}
+};
+
+/**
+ * This structure represents a node in the concurrent b-tree: a b-tree node with
+ * a version latch, which readers check instead of locking the node.
+ */
+template<typename T, unsigned short Degree = bnodeDegree<T>(BNODE_DEFAULT_SIZE)>
+struct alignas(64) ConcurrentBNode {
+	static_assert(Degree >= 2, "The minimum degree of a b-tree is 2");
+	// Maximum number of keys (and values) in a node
+	static constexpr unsigned short MAX_KEYS = 2 * Degree - 1;
+	OptimisticLock lock;
+	// Number of keys in the node
+	unsigned short count;
+	// Whether the node has no children
+	bool leaf;
+	T keys[MAX_KEYS];
+	T values[MAX_KEYS];
+	ConcurrentBNode<T, Degree>* children[MAX_KEYS + 1];
+	ConcurrentBNode(bool leaf = true) :
+			lock(), count(0), leaf(leaf) {
 	}
 };
+
+/**
+ * This structure represents a b-tree node in a page file (see MappedBtree). It has
+ * the layout of BNode, but children are page numbers instead of pointers, so the
+ * node is valid wherever the file is mapped (page 0 is never a node, so it stands
+ * for no child). Keys and values are stored as they are in memory, so they must
+ * be trivially copyable.
+ */
+template<typename T, unsigned short Degree = bnodeDegree<T>(BNODE_PAGE_SIZE)>
+struct alignas(64) BPage {
+	static_assert(Degree >= 2, "The minimum degree of a b-tree is 2");
+	// Maximum number of keys (and values) in a node
+	static constexpr unsigned short MAX_KEYS = 2 * Degree - 1;
+	// Number of keys in the node
+	unsigned short count;
+	// Whether the node has no children
+	bool leaf;
+	T keys[MAX_KEYS];
+	T values[MAX_KEYS];
+	uint64_t children[MAX_KEYS + 1];
+};
 }
 
 template struct tree::BNode<int> ;
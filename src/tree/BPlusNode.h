@@ -0,0 +1,95 @@
+/**
+ * @file BPlusNode.h
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#ifndef SRC_TREE_BPLUSNODE_H_
+#define SRC_TREE_BPLUSNODE_H_
+
+#include "BNode.h"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace tree {
+
+/**
+ * Get the minimum degree d for internal b+tree nodes of a given size. Internal
+ * nodes keep up to 2d-1 separator keys and up to 2d children, and no values.
+ * @param[in] bytes Size of the node
+ * @return Minimum degree (2 at least)
+ */
+template<typename T>
+constexpr unsigned short bplusInnerDegree(size_t bytes) {
+	return static_cast<unsigned short>(std::max<size_t>(2,
+			(bytes - 64 + sizeof(T)) / (2 * (sizeof(T) + sizeof(void*)))));
+}
+
+/**
+ * Get the minimum degree d for b+tree leaves of a given size. Leaves keep up to
+ * 2d-1 keys and values, and the links to their siblings.
+ * @param[in] bytes Size of the node
+ * @return Minimum degree (2 at least)
+ */
+template<typename T>
+constexpr unsigned short bplusLeafDegree(size_t bytes) {
+	return static_cast<unsigned short>(std::max<size_t>(2,
+			(bytes - 64 - 2 * sizeof(void*) + 2 * sizeof(T))
+					/ (4 * sizeof(T))));
+}
+
+/**
+ * Common header of the b+tree nodes, so that internal nodes can point to both
+ * internal nodes and leaves
+ */
+struct BPlusNodeHeader {
+	// Number of keys in the node
+	unsigned short count;
+	// Whether the node is a leaf (and so, which structure it is)
+	bool leaf;
+	BPlusNodeHeader(bool leaf) :
+			count(0), leaf(leaf) {
+	}
+};
+
+/**
+ * This structure represents an internal node in the b+tree. It only keeps
+ * separator keys and children: every key in children[i] is lower than keys[i],
+ * and every key in children[i + 1] is higher or equal.
+ */
+template<typename T, unsigned short Degree = bplusInnerDegree<T>(
+		BNODE_DEFAULT_SIZE)>
+struct alignas(64) BPlusInnerNode: public BPlusNodeHeader {
+	static_assert(Degree >= 2, "The minimum degree of a b+tree is 2");
+	// Maximum number of keys in a node
+	static constexpr unsigned short MAX_KEYS = 2 * Degree - 1;
+	T keys[MAX_KEYS];
+	BPlusNodeHeader* children[MAX_KEYS + 1];
+	BPlusInnerNode() :
+			BPlusNodeHeader(false) {
+	}
+};
+
+/**
+ * This structure represents a leaf in the b+tree. Leaves keep all the keys and
+ * values of the tree, and they are linked in a list in key order.
+ */
+template<typename T, unsigned short Degree = bplusLeafDegree<T>(
+		BNODE_DEFAULT_SIZE)>
+struct alignas(64) BPlusLeafNode: public BPlusNodeHeader {
+	static_assert(Degree >= 2, "The minimum degree of a b+tree is 2");
+	// Maximum number of keys (and values) in a node
+	static constexpr unsigned short MAX_KEYS = 2 * Degree - 1;
+	T keys[MAX_KEYS];
+	T values[MAX_KEYS];
+	BPlusLeafNode<T, Degree>* prev;
+	BPlusLeafNode<T, Degree>* next;
+	BPlusLeafNode() :
+			BPlusNodeHeader(true), prev(nullptr), next(nullptr) {
+	}
+};
+
+} /* namespace tree */
+
+#endif /* SRC_TREE_BPLUSNODE_H_ */
@@ -0,0 +1,377 @@
+/**
+ * @file BPlusTree.cpp
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#include "BPlusTree.h"
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+namespace tree {
+
+template<typename T, unsigned short Degree, unsigned short LeafDegree>
+BPlusTree<T, Degree, LeafDegree>::BPlusTree(
+		std::pmr::memory_resource* resource) :
+		root(nullptr), first(nullptr), last(nullptr), innerPool(resource), leafPool(
+				resource) {
+
+}
+
+template<typename T, unsigned short Degree, unsigned short LeafDegree>
+BPlusTree<T, Degree, LeafDegree>::~BPlusTree() {
+	clear();
+}
+
+template<typename T, unsigned short Degree, unsigned short LeafDegree>
+void BPlusTree<T, Degree, LeafDegree>::clear() {
+	// Nodes only need to be destroyed one by one if their keys do. In any case,
+	// node memory goes back to the memory resource slab by slab
+	if (!std::is_trivially_destructible<T>::value) {
+		std::vector<BPlusNodeHeader*> pending;
+		if (this->root != nullptr)
+			pending.push_back(this->root);
+		while (!pending.empty()) {
+			BPlusNodeHeader* node = pending.back();
+			pending.pop_back();
+			if (!node->leaf) {
+				InnerType* inner = static_cast<InnerType*>(node);
+				pending.insert(pending.end(), inner->children,
+						inner->children + inner->count + 1);
+			}
+			destroyNode(node);
+		}
+	}
+	this->root = nullptr;
+	this->first = this->last = nullptr;
+	innerPool.release();
+	leafPool.release();
+}
+
+template<typename T, unsigned short Degree, unsigned short LeafDegree>
+void BPlusTree<T, Degree, LeafDegree>::destroyNode(BPlusNodeHeader* node) {
+	if (node->leaf)
+		leafPool.destroy(static_cast<LeafType*>(node));
+	else
+		innerPool.destroy(static_cast<InnerType*>(node));
+}
+
+template<typename T, unsigned short Degree, unsigned short LeafDegree>
+size_t BPlusTree<T, Degree, LeafDegree>::getChildPosition(
+		const InnerType* node, const T& key) {
+	// Keys equal to a separator are on its right
+	size_t pos = rankInNode(node->keys, node->count, key);
+	if ((pos < node->count) && (node->keys[pos] == key))
+		++pos;
+	return pos;
+}
+
+template<typename T, unsigned short Degree, unsigned short LeafDegree>
+typename BPlusTree<T, Degree, LeafDegree>::LeafType* BPlusTree<T, Degree,
+		LeafDegree>::findLeaf(const T& key) const {
+	BPlusNodeHeader* node = this->root;
+	if (node == nullptr)
+		return nullptr;
+	while (!node->leaf) {
+		InnerType* inner = static_cast<InnerType*>(node);
+		node = inner->children[getChildPosition(inner, key)];
+	}
+	return static_cast<LeafType*>(node);
+}
+
+template<typename T, unsigned short Degree, unsigned short LeafDegree>
+bool BPlusTree<T, Degree, LeafDegree>::isFull(const BPlusNodeHeader* node) {
+	return node->count
+			== (node->leaf ? LeafType::MAX_KEYS : InnerType::MAX_KEYS);
+}
+
+template<typename T, unsigned short Degree, unsigned short LeafDegree>
+bool BPlusTree<T, Degree, LeafDegree>::canLend(const BPlusNodeHeader* node) {
+	return node->count >= (node->leaf ? LeafDegree : Degree);
+}
+
+template<typename T, unsigned short Degree, unsigned short LeafDegree>
+typename BPlusTree<T, Degree, LeafDegree>::LeafType* BPlusTree<T, Degree,
+		LeafDegree>::search(const T& key) {
+	LeafType* leaf = findLeaf(key);
+	if (leaf == nullptr)
+		return nullptr;
+	size_t pos = rankInNode(leaf->keys, leaf->count, key);
+	if ((pos < leaf->count) && (leaf->keys[pos] == key))
+		return leaf;
+	return nullptr;
+}
+
+template<typename T, unsigned short Degree, unsigned short LeafDegree>
+void BPlusTree<T, Degree, LeafDegree>::getInorder(
+		std::list<T>& orderedList) const {
+	for (const LeafType* leaf = this->first; leaf != nullptr; leaf = leaf->next)
+		orderedList.insert(orderedList.end(), leaf->keys,
+				leaf->keys + leaf->count);
+}
+
+template<typename T, unsigned short Degree, unsigned short LeafDegree>
+typename BPlusTree<T, Degree, LeafDegree>::const_iterator BPlusTree<T, Degree,
+		LeafDegree>::begin() const {
+	return const_iterator(this, this->first, 0);
+}
+
+template<typename T, unsigned short Degree, unsigned short LeafDegree>
+typename BPlusTree<T, Degree, LeafDegree>::const_iterator BPlusTree<T, Degree,
+		LeafDegree>::end() const {
+	return const_iterator(this, nullptr, 0);
+}
+
+template<typename T, unsigned short Degree, unsigned short LeafDegree>
+typename BPlusTree<T, Degree, LeafDegree>::const_iterator BPlusTree<T, Degree,
+		LeafDegree>::lower_bound(const T& key) const {
+	LeafType* leaf = findLeaf(key);
+	if (leaf == nullptr)
+		return end();
+	return const_iterator(this, leaf, rankInNode(leaf->keys, leaf->count, key));
+}
+
+template<typename T, unsigned short Degree, unsigned short LeafDegree>
+typename BPlusTree<T, Degree, LeafDegree>::const_iterator BPlusTree<T, Degree,
+		LeafDegree>::upper_bound(const T& key) const {
+	LeafType* leaf = findLeaf(key);
+	if (leaf == nullptr)
+		return end();
+	return const_iterator(this, leaf,
+			std::upper_bound(leaf->keys, leaf->keys + leaf->count, key)
+					- leaf->keys);
+}
+
+template<typename T, unsigned short Degree, unsigned short LeafDegree>
+std::pair<typename BPlusTree<T, Degree, LeafDegree>::const_iterator,
+		typename BPlusTree<T, Degree, LeafDegree>::const_iterator> BPlusTree<T,
+		Degree, LeafDegree>::equal_range(const T& key) const {
+	return std::make_pair(lower_bound(key), upper_bound(key));
+}
+
+template<typename T, unsigned short Degree, unsigned short LeafDegree>
+bool BPlusTree<T, Degree, LeafDegree>::insert(const T& key, const T& value) {
+	// 1. The tree is empty => the root is a leaf
+	if (this->root == nullptr) {
+		LeafType* leaf = leafPool.create();
+		this->root = this->first = this->last = leaf;
+	}
+	// 2. The root node is full => split it before going down, so that the tree
+	//    grows from the top and every node we go through has room for one more key
+	else if (isFull(this->root)) {
+		InnerType* newRoot = innerPool.create();
+		newRoot->children[0] = this->root;
+		splitChild(newRoot, 0);
+		this->root = newRoot;
+	}
+
+	// 3. Go down to the leaf, splitting every full child before going into it
+	BPlusNodeHeader* node = this->root;
+	while (!node->leaf) {
+		InnerType* inner = static_cast<InnerType*>(node);
+		size_t pos = getChildPosition(inner, key);
+		if (isFull(inner->children[pos])) {
+			splitChild(inner, pos);
+			if (!(key < inner->keys[pos]))
+				++pos;
+		}
+		node = inner->children[pos];
+	}
+
+	// 4. Insert the key in its sorted place of the leaf (if it is not there yet)
+	LeafType* leaf = static_cast<LeafType*>(node);
+	size_t pos = rankInNode(leaf->keys, leaf->count, key);
+	if ((pos < leaf->count) && (leaf->keys[pos] == key))
+		return false;
+	shiftRight(leaf->keys, pos, leaf->count);
+	shiftRight(leaf->values, pos, leaf->count);
+	leaf->keys[pos] = key;
+	leaf->values[pos] = value;
+	++leaf->count;
+	return true;
+}
+
+template<typename T, unsigned short Degree, unsigned short LeafDegree>
+void BPlusTree<T, Degree, LeafDegree>::splitChild(InnerType* parent,
+		size_t pos) {
+	BPlusNodeHeader* child = parent->children[pos];
+	BPlusNodeHeader* right;
+	if (child->leaf) {
+		// The left leaf keeps LeafDegree keys and the right one gets the rest.
+		// The separator is a copy of the first key on the right
+		LeafType* l = static_cast<LeafType*>(child);
+		LeafType* r = leafPool.create();
+		std::move(l->keys + LeafDegree, l->keys + LeafType::MAX_KEYS, r->keys);
+		std::move(l->values + LeafDegree, l->values + LeafType::MAX_KEYS,
+				r->values);
+		r->count = LeafType::MAX_KEYS - LeafDegree;
+		l->count = LeafDegree;
+		// Link the new leaf after the original one
+		r->prev = l;
+		r->next = l->next;
+		if (l->next != nullptr)
+			l->next->prev = r;
+		else
+			this->last = r;
+		l->next = r;
+		shiftRight(parent->keys, pos, parent->count);
+		parent->keys[pos] = r->keys[0];
+		right = r;
+	} else {
+		// The mid key goes up to the parent, as in a b-tree
+		InnerType* l = static_cast<InnerType*>(child);
+		InnerType* r = innerPool.create();
+		shiftRight(parent->keys, pos, parent->count);
+		parent->keys[pos] = std::move(l->keys[Degree - 1]);
+		std::move(l->keys + Degree, l->keys + InnerType::MAX_KEYS, r->keys);
+		std::copy(l->children + Degree, l->children + InnerType::MAX_KEYS + 1,
+				r->children);
+		r->count = Degree - 1;
+		l->count = Degree - 1;
+		right = r;
+	}
+	shiftRight(parent->children, pos + 1, parent->count + 1);
+	parent->children[pos + 1] = right;
+	++parent->count;
+}
+
+template<typename T, unsigned short Degree, unsigned short LeafDegree>
+bool BPlusTree<T, Degree, LeafDegree>::remove(const T& key) {
+	if (this->root == nullptr)
+		return false;
+
+	// 1. Go down to the leaf, making sure every child we go into has more keys
+	//    than the minimum, so that removing one does not need to go back up
+	BPlusNodeHeader* node = this->root;
+	while (!node->leaf) {
+		InnerType* inner = static_cast<InnerType*>(node);
+		size_t pos = getChildPosition(inner, key);
+		if (!canLend(inner->children[pos])) {
+			//    1.1 A sibling has more keys than the minimum => borrow one
+			if ((pos > 0) && canLend(inner->children[pos - 1]))
+				borrow(inner, pos, true);
+			else if ((pos < inner->count) && canLend(inner->children[pos + 1]))
+				borrow(inner, pos, false);
+			//    1.2 Both siblings have the minimum => merge with one of them
+			else if (pos < inner->count)
+				merge(inner, pos);
+			else
+				merge(inner, --pos);
+		}
+		node = inner->children[pos];
+	}
+
+	// 2. The root may have been left empty after a merge => the tree shrinks
+	if (!this->root->leaf && (this->root->count == 0)) {
+		BPlusNodeHeader* oldRoot = this->root;
+		this->root = static_cast<InnerType*>(oldRoot)->children[0];
+		destroyNode(oldRoot);
+	}
+
+	// 3. Remove the key from the leaf
+	LeafType* leaf = static_cast<LeafType*>(node);
+	size_t pos = rankInNode(leaf->keys, leaf->count, key);
+	if ((pos == leaf->count) || !(leaf->keys[pos] == key))
+		return false;
+	shiftLeft(leaf->keys, pos, leaf->count);
+	shiftLeft(leaf->values, pos, leaf->count);
+	--leaf->count;
+	if (leaf->count == 0) { // Only the root can be left empty
+		destroyNode(leaf);
+		this->root = this->first = this->last = nullptr;
+	}
+	return true;
+}
+
+template<typename T, unsigned short Degree, unsigned short LeafDegree>
+void BPlusTree<T, Degree, LeafDegree>::borrow(InnerType* parent, size_t pos,
+		bool fromLeft) {
+	BPlusNodeHeader* child = parent->children[pos];
+	if (child->leaf) {
+		// Leaves move the key itself, and the separator becomes the first key of
+		// the right leaf
+		LeafType* c = static_cast<LeafType*>(child);
+		if (fromLeft) {
+			LeafType* s = static_cast<LeafType*>(parent->children[pos - 1]);
+			shiftRight(c->keys, 0, c->count);
+			shiftRight(c->values, 0, c->count);
+			c->keys[0] = std::move(s->keys[s->count - 1]);
+			c->values[0] = std::move(s->values[s->count - 1]);
+			--s->count;
+			++c->count;
+			parent->keys[pos - 1] = c->keys[0];
+		} else {
+			LeafType* s = static_cast<LeafType*>(parent->children[pos + 1]);
+			c->keys[c->count] = std::move(s->keys[0]);
+			c->values[c->count] = std::move(s->values[0]);
+			++c->count;
+			shiftLeft(s->keys, 0, s->count);
+			shiftLeft(s->values, 0, s->count);
+			--s->count;
+			parent->keys[pos] = s->keys[0];
+		}
+	} else {
+		// Internal nodes rotate the key through the parent, together with the
+		// child next to it
+		InnerType* c = static_cast<InnerType*>(child);
+		if (fromLeft) {
+			InnerType* s = static_cast<InnerType*>(parent->children[pos - 1]);
+			shiftRight(c->keys, 0, c->count);
+			shiftRight(c->children, 0, c->count + 1);
+			c->keys[0] = std::move(parent->keys[pos - 1]);
+			c->children[0] = s->children[s->count];
+			parent->keys[pos - 1] = std::move(s->keys[s->count - 1]);
+			--s->count;
+		} else {
+			InnerType* s = static_cast<InnerType*>(parent->children[pos + 1]);
+			c->keys[c->count] = std::move(parent->keys[pos]);
+			c->children[c->count + 1] = s->children[0];
+			parent->keys[pos] = std::move(s->keys[0]);
+			shiftLeft(s->keys, 0, s->count);
+			shiftLeft(s->children, 0, s->count + 1);
+			--s->count;
+		}
+		++c->count;
+	}
+}
+
+template<typename T, unsigned short Degree, unsigned short LeafDegree>
+void BPlusTree<T, Degree, LeafDegree>::merge(InnerType* parent, size_t pos) {
+	BPlusNodeHeader* left = parent->children[pos];
+	BPlusNodeHeader* right = parent->children[pos + 1];
+	if (left->leaf) {
+		// The separator is simply dropped, and the right leaf is unlinked
+		LeafType* l = static_cast<LeafType*>(left);
+		LeafType* r = static_cast<LeafType*>(right);
+		std::move(r->keys, r->keys + r->count, l->keys + l->count);
+		std::move(r->values, r->values + r->count, l->values + l->count);
+		l->count += r->count;
+		l->next = r->next;
+		if (r->next != nullptr)
+			r->next->prev = l;
+		else
+			this->last = l;
+	} else {
+		// The separator goes down between the keys of both nodes
+		InnerType* l = static_cast<InnerType*>(left);
+		InnerType* r = static_cast<InnerType*>(right);
+		l->keys[l->count] = std::move(parent->keys[pos]);
+		std::move(r->keys, r->keys + r->count, l->keys + l->count + 1);
+		std::copy(r->children, r->children + r->count + 1,
+				l->children + l->count + 1);
+		l->count += 1 + r->count;
+	}
+	shiftLeft(parent->keys, pos, parent->count);
+	shiftLeft(parent->children, pos + 1, parent->count + 1);
+	--parent->count;
+	destroyNode(right);
+}
+
+template class BPlusTree<int> ;
+template class BPlusTree<float> ;
+template class BPlusTree<double> ;
+template class BPlusTree<std::string> ;
+
+} /* namespace tree */
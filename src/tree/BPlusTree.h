@@ -0,0 +1,255 @@
+/**
+ * @file BPlusTree.h
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#ifndef SRC_TREE_BPLUSTREE_H_
+#define SRC_TREE_BPLUSTREE_H_
+
+#include "BPlusNode.h"
+#include "NodePool.h"
+#include "NodeSearch.h"
+
+#include <cstddef>
+#include <iterator>
+#include <list>
+#include <memory_resource>
+#include <string>
+#include <utility>
+
+namespace tree {
+
+/**
+ * This class implements a b+tree. Unlike Btree, keys and values are only kept in
+ * the leaves, which are linked in key order, and internal nodes only keep
+ * separator keys (so they have a higher fan-out than b-tree nodes of the same
+ * size). Scans are then a walk along the leaves, without going up and down the
+ * tree. Degrees are set at compile time, as in Btree: by default, both kinds of
+ * node take BNODE_DEFAULT_SIZE bytes.
+ * NOTE: the tree is instantiated in BPlusTree.cpp for int, float, double and
+ * std::string with the default degrees.
+ */
+template<typename T, unsigned short Degree = bplusInnerDegree<T>(
+		BNODE_DEFAULT_SIZE), unsigned short LeafDegree = bplusLeafDegree<T>(
+		BNODE_DEFAULT_SIZE)>
+class BPlusTree {
+public:
+	typedef BPlusInnerNode<T, Degree> InnerType;
+	typedef BPlusLeafNode<T, LeafDegree> LeafType;
+private:
+	BPlusNodeHeader* root;
+	// First and last leaves of the list
+	LeafType* first;
+	LeafType* last;
+	NodePool<InnerType> innerPool;
+	NodePool<LeafType> leafPool;
+public:
+	/**
+	 * Bidirectional iterator which goes along the leaves in key order. Iterators
+	 * are invalidated by any change in the tree.
+	 */
+	class const_iterator {
+	public:
+		typedef std::bidirectional_iterator_tag iterator_category;
+		typedef T value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const T* pointer;
+		typedef const T& reference;
+
+		const_iterator() :
+				tree(nullptr), leaf(nullptr), pos(0) {
+		}
+		reference operator*() const {
+			return leaf->keys[pos];
+		}
+		pointer operator->() const {
+			return &(leaf->keys[pos]);
+		}
+		/**
+		 * Get the value associated to the current key
+		 * @return Value of the current element
+		 */
+		const T& value() const {
+			return leaf->values[pos];
+		}
+		const_iterator& operator++() {
+			if (++pos == leaf->count) {
+				leaf = leaf->next;
+				pos = 0;
+			}
+			return *this;
+		}
+		const_iterator operator++(int) {
+			const_iterator previous = *this;
+			++(*this);
+			return previous;
+		}
+		const_iterator& operator--() {
+			if (leaf == nullptr) {
+				leaf = tree->last;
+				pos = leaf->count - 1;
+			} else if (pos > 0) {
+				--pos;
+			} else {
+				leaf = leaf->prev;
+				pos = leaf->count - 1;
+			}
+			return *this;
+		}
+		const_iterator operator--(int) {
+			const_iterator previous = *this;
+			--(*this);
+			return previous;
+		}
+		bool operator==(const const_iterator& other) const {
+			return (leaf == other.leaf) && (pos == other.pos);
+		}
+		bool operator!=(const const_iterator& other) const {
+			return !(*this == other);
+		}
+	private:
+		friend class BPlusTree<T, Degree, LeafDegree>;
+
+		const_iterator(const BPlusTree<T, Degree, LeafDegree>* tree,
+				const LeafType* leaf, size_t pos) :
+				tree(tree), leaf(leaf), pos(pos) {
+			// A position past the end of a leaf is the beginning of the next one
+			if ((leaf != nullptr) && (pos == leaf->count)) {
+				this->leaf = leaf->next;
+				this->pos = 0;
+			}
+		}
+		const BPlusTree<T, Degree, LeafDegree>* tree;
+		const LeafType* leaf;
+		size_t pos;
+	};
+	typedef const_iterator iterator;
+
+	/**
+	 * Class constructor
+	 * @param[in] resource: memory resource backing the nodes
+	 */
+	explicit BPlusTree(std::pmr::memory_resource* resource =
+			std::pmr::get_default_resource());
+	/**
+	 * Class destructor
+	 */
+	virtual ~BPlusTree();
+	BPlusTree(const BPlusTree&) = delete;
+	BPlusTree& operator=(const BPlusTree&) = delete;
+	/**
+	 * Remove all the elements from the tree
+	 */
+	void clear();
+	/**
+	 * Search a given key in the b+tree
+	 * @param[in] key Key to find
+	 * @return Returns the leaf which contains the key, or nullptr if it is not
+	 * found
+	 */
+	LeafType* search(const T& key);
+	/**
+	 * Go along the tree in an in-order order (i.e. along the leaves).
+	 * @param[out] orderedList List in an in-order order
+	 */
+	void getInorder(std::list<T>& orderedList) const;
+	/**
+	 * Get an iterator to the minimum key of the tree
+	 * @return Iterator to the first key in an in-order order
+	 */
+	const_iterator begin() const;
+	/**
+	 * Get an iterator past the maximum key of the tree
+	 * @return Iterator to the end of the tree
+	 */
+	const_iterator end() const;
+	/**
+	 * Get an iterator to the first key which is not lower than a given one
+	 * @param[in] key Key to compare with
+	 * @return Iterator to the first key >= key, or end() if there is none
+	 */
+	const_iterator lower_bound(const T& key) const;
+	/**
+	 * Get an iterator to the first key which is higher than a given one
+	 * @param[in] key Key to compare with
+	 * @return Iterator to the first key > key, or end() if there is none
+	 */
+	const_iterator upper_bound(const T& key) const;
+	/**
+	 * Get the range of keys which are equal to a given one
+	 * @param[in] key Key to compare with
+	 * @return Pair of iterators with lower_bound(key) and upper_bound(key)
+	 */
+	std::pair<const_iterator, const_iterator> equal_range(const T& key) const;
+	/**
+	 * Insert an element into the tree (if it does not exist yet)
+	 * @param[in] key	Key to add to the tree
+	 * @param[in] value	Value associated to the key
+	 * @return Returns whether the element has been inserted or not
+	 */
+	bool insert(const T& key, const T& value);
+	/**
+	 * Removes an element from the tree (if exists)
+	 * @param[in] key 	Key to remove
+	 * @return 	Returns whether the element has been removed or not
+	 */
+	bool remove(const T& key);
+private:
+	/**
+	 * Get the child of an internal node where a key is (or would be)
+	 * @param[in] node Internal node
+	 * @param[in] key Key to search
+	 * @return Position of the child
+	 */
+	static size_t getChildPosition(const InnerType* node, const T& key);
+	/**
+	 * Go down from the root to the leaf where a key is (or would be)
+	 * @param[in] key Key to search
+	 * @return Leaf for the key, or nullptr if the tree is empty
+	 */
+	LeafType* findLeaf(const T& key) const;
+	/**
+	 * Whether a node has room for no more keys
+	 * @param[in] node Node to check
+	 * @return Returns true if the node is full
+	 */
+	static bool isFull(const BPlusNodeHeader* node);
+	/**
+	 * Whether a key can be removed from a node without going under the minimum
+	 * number of keys
+	 * @param[in] node Node to check
+	 * @return Returns true if the node has more than the minimum number of keys
+	 */
+	static bool canLend(const BPlusNodeHeader* node);
+	/**
+	 * Split a full child of an internal node in two halves. The new (right) node
+	 * is added as the next child, together with its separator key
+	 * @param[in|out] parent Parent node, which must not be full
+	 * @param[in] pos Position of the child to split
+	 */
+	void splitChild(InnerType* parent, size_t pos);
+	/**
+	 * Move a key from a sibling of a child into the child, through the parent
+	 * @param[in|out] parent Parent node
+	 * @param[in] pos Position of the child
+	 * @param[in] fromLeft Whether the key comes from the left sibling (or the
+	 *                     right one)
+	 */
+	void borrow(InnerType* parent, size_t pos, bool fromLeft);
+	/**
+	 * Merge a child with its right sibling. The sibling is destroyed
+	 * @param[in|out] parent Parent node
+	 * @param[in] pos Position of the (left) child
+	 */
+	void merge(InnerType* parent, size_t pos);
+	/**
+	 * Destroy a node (its children are not destroyed)
+	 * @param[in] node Node to destroy
+	 */
+	void destroyNode(BPlusNodeHeader* node);
+};
+
+} /* namespace tree */
+
+#endif /* SRC_TREE_BPLUSTREE_H_ */
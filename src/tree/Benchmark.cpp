@@ -0,0 +1,786 @@
+/**
+ * @file Benchmark.cpp
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ *
+ * Throughput benchmark for the tree structures. Every structure runs an insert,
+ * search, full scan and delete workload for int, double and std::string keys, under several
+ * key distributions and for sizes from 1K up to 100M elements. std::set and
+ * std::map are run as a baseline with exactly the same key sequences.
+ *
+ * Usage: Benchmark [-n maxSize] [-m minSize] [-t budgetSeconds] [-M maxMemoryMB]
+ *                  [-s structures] [-d distributions] [-k keyTypes]
+ *                  [-j threads] [-c]
+ *   -n  Largest number of elements to run (default 100000000)
+ *   -m  Smallest number of elements to run (default 1000)
+ *   -t  Once a run takes longer than this, larger sizes of the same
+ *       structure/key/distribution are skipped (default 10)
+ *   -M  Runs whose estimated footprint is above this are skipped (default: half
+ *       of the physical memory)
+ *   -s  Comma separated subset of: bst,avl,rbt,splay,semisplay,btree,bplus,
+ *       cbtree,savl,sharded,set,map
+ *   -d  Comma separated subset of: uniform,sorted,reverse,zipf,mixed,writeheavy
+ *   -k  Comma separated subset of: int,double,string
+ *   -j  Threads running the search and mixed phases of the concurrent
+ *       structures (cbtree, savl, sharded) (default 1)
+ *   -c  Print results as CSV
+ */
+#include "AVLTree.h"
+#include "BPlusTree.h"
+#include "BinarySearchTree.h"
+#include "Btree.h"
+#include "ConcurrentBtree.h"
+#include "RedBlackTree.h"
+#include "ShardedTree.h"
+#include "SplayTree.h"
+#include "SnapshotAVLTree.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <map>
+#include <numeric>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+/**
+ * Benchmark settings, as read from the command line
+ */
+struct Options {
+	uint64_t minSize = 1000;
+	uint64_t maxSize = 100000000;
+	double budget = 10.0;
+	uint64_t maxMemory = 0;
+	std::string structures =
+			"bst,avl,rbt,splay,semisplay,btree,bplus,cbtree,savl,sharded,set,map";
+	std::string distributions = "uniform,sorted,reverse,zipf,mixed,writeheavy";
+	std::string keyTypes = "int,double,string";
+	unsigned int threads = 1;
+	bool csv = false;
+};
+
+/**
+ * Checks whether a name is in a comma separated list
+ * @param[in] list Comma separated list
+ * @param[in] name Name to look for
+ * @return Returns true if the name is in the list
+ */
+bool selected(const std::string& list, const std::string& name) {
+	std::istringstream is(list);
+	std::string item;
+	while (std::getline(is, item, ','))
+		if (item == name)
+			return true;
+	return false;
+}
+
+/**
+ * Converts an ordinal into a key. Ordinals are mapped so that the key order
+ * is the same as the ordinal order for every key type
+ * @param[in] i Ordinal
+ * @return Key for the ordinal
+ */
+template<typename T>
+T makeKey(uint64_t i);
+
+template<>
+int makeKey<int>(uint64_t i) {
+	return static_cast<int>(i);
+}
+
+template<>
+double makeKey<double>(uint64_t i) {
+	return static_cast<double>(i) * 0.5;
+}
+
+template<>
+std::string makeKey<std::string>(uint64_t i) {
+	char buffer[16];
+	std::snprintf(buffer, sizeof(buffer), "%010llu",
+			static_cast<unsigned long long>(i));
+	return std::string(buffer);
+}
+
+/**
+ * Zipfian generator over [0, n) (Gray et al., "Quickly generating billion-record
+ * synthetic databases"), as used by YCSB. Rank 0 is the most popular item.
+ */
+class ZipfGenerator {
+public:
+	ZipfGenerator(uint64_t n, double theta) :
+			n(n), theta(theta), dist(0.0, 1.0) {
+		double zeta2 = 1.0 + std::pow(0.5, theta);
+		zetan = 0;
+		for (uint64_t i = 1; i <= n; ++i)
+			zetan += 1.0 / std::pow(static_cast<double>(i), theta);
+		alpha = 1.0 / (1.0 - theta);
+		eta = (1.0 - std::pow(2.0 / static_cast<double>(n), 1.0 - theta))
+				/ (1.0 - zeta2 / zetan);
+		half = 1.0 + std::pow(0.5, theta);
+	}
+	uint64_t next(std::mt19937_64& rng) {
+		double u = dist(rng);
+		double uz = u * zetan;
+		if (uz < 1.0)
+			return 0;
+		if (uz < half)
+			return 1;
+		uint64_t r = static_cast<uint64_t>(static_cast<double>(n)
+				* std::pow(eta * u - eta + 1.0, alpha));
+		return std::min(r, n - 1);
+	}
+private:
+	uint64_t n;
+	double theta;
+	double zetan;
+	double alpha;
+	double eta;
+	double half;
+	std::uniform_real_distribution<double> dist;
+};
+
+/**
+ * Operation kinds for the mixed workload
+ */
+enum Operation {
+	SEARCH, INSERT, DELETE
+};
+
+/**
+ * Key sequences for one run. All the structures get exactly the same sequences.
+ */
+template<typename T>
+struct Workload {
+	// Keys inserted during the load phase
+	std::vector<T> inserts;
+	// Keys looked up during the search phase
+	std::vector<T> searches;
+	// Keys removed during the delete phase
+	std::vector<T> deletes;
+	// Mixed read/write phase (only for the mixed and writeheavy distributions)
+	std::vector<Operation> mixedOps;
+	std::vector<T> mixedKeys;
+};
+
+/**
+ * Builds the key sequences for a distribution. Loaded keys use even ordinals,
+ * so odd ordinals are available for keys which are not in the structure yet.
+ * @param[in] distribution Distribution name
+ * @param[in] n Number of elements
+ * @param[out] w Workload
+ */
+template<typename T>
+void buildWorkload(const std::string& distribution, uint64_t n,
+		Workload<T>& w) {
+	std::mt19937_64 rng(n * 7919 + distribution.size());
+	std::vector<uint64_t> ordinals(n);
+	for (uint64_t i = 0; i < n; ++i)
+		ordinals[i] = 2 * i;
+	if (distribution == "reverse")
+		std::reverse(ordinals.begin(), ordinals.end());
+	else if (distribution != "sorted")
+		std::shuffle(ordinals.begin(), ordinals.end(), rng);
+
+	w.inserts.reserve(n);
+	for (uint64_t o : ordinals)
+		w.inserts.push_back(makeKey<T>(o));
+
+	if (distribution == "zipf") {
+		// Hot keys are spread over the key space, since ordinals are shuffled
+		ZipfGenerator zipf(n, 0.99);
+		w.searches.reserve(n);
+		w.deletes.reserve(n);
+		for (uint64_t i = 0; i < n; ++i)
+			w.searches.push_back(makeKey<T>(ordinals[zipf.next(rng)]));
+		for (uint64_t i = 0; i < n; ++i)
+			w.deletes.push_back(makeKey<T>(ordinals[zipf.next(rng)]));
+	} else {
+		w.searches = w.inserts;
+		w.deletes = w.inserts;
+		if (distribution == "uniform" || distribution == "mixed"
+				|| distribution == "writeheavy") {
+			std::shuffle(w.searches.begin(), w.searches.end(), rng);
+			std::shuffle(w.deletes.begin(), w.deletes.end(), rng);
+		}
+	}
+
+	if (distribution == "mixed" || distribution == "writeheavy") {
+		// mixed: 90% reads, 5% inserts of new keys, 5% deletes of loaded keys
+		// writeheavy: 40% reads, 30% inserts, 30% deletes
+		int reads = (distribution == "mixed") ? 90 : 40;
+		std::uniform_int_distribution<uint64_t> pick(0, n - 1);
+		std::uniform_int_distribution<int> percent(0, 99);
+		w.mixedOps.reserve(n);
+		w.mixedKeys.reserve(n);
+		for (uint64_t i = 0; i < n; ++i) {
+			int p = percent(rng);
+			if (p < reads) {
+				w.mixedOps.push_back(SEARCH);
+				w.mixedKeys.push_back(makeKey<T>(2 * pick(rng)));
+			} else if (p < reads + (100 - reads) / 2) {
+				w.mixedOps.push_back(INSERT);
+				w.mixedKeys.push_back(makeKey<T>(2 * pick(rng) + 1));
+			} else {
+				w.mixedOps.push_back(DELETE);
+				w.mixedKeys.push_back(makeKey<T>(2 * pick(rng)));
+			}
+		}
+	}
+}
+
+/**
+ * Adapter for the BinarySearchTree based structures. Lookups are not const, since
+ * splay trees change on every access
+ */
+template<typename T, typename Tree>
+class NodeTreeAdapter {
+public:
+	bool insert(const T& key) {
+		return tree.insert(key);
+	}
+	bool find(const T& key) {
+		return tree.search(key) != nullptr;
+	}
+	bool erase(const T& key) {
+		return tree.deleteNode(key);
+	}
+	uint64_t scan() const {
+		uint64_t count = 0;
+		for (auto it = tree.begin(); it != tree.end(); ++it)
+			++count;
+		return count;
+	}
+private:
+	Tree tree;
+};
+
+/**
+ * Splay tree which semi-splays accessed nodes, for NodeTreeAdapter
+ */
+template<typename T>
+class SemiSplayTree: public tree::SplayTree<T> {
+public:
+	SemiSplayTree() :
+			tree::SplayTree<T>(tree::SplayTree<T>::SEMI_SPLAY) {
+	}
+};
+
+/**
+ * Adapter for the B-tree (values are the keys themselves)
+ */
+template<typename T>
+class BtreeAdapter {
+public:
+	bool insert(const T& key) {
+		return tree.insert(key, key);
+	}
+	bool find(const T& key) {
+		return tree.contains(key);
+	}
+	bool erase(const T& key) {
+		return tree.remove(key);
+	}
+	uint64_t scan() const {
+		uint64_t count = 0;
+		for (auto it = tree.begin(); it != tree.end(); ++it)
+			++count;
+		return count;
+	}
+private:
+	tree::Btree<T> tree;
+};
+
+/**
+ * Adapter for the B+tree (values are the keys themselves)
+ */
+template<typename T>
+class BPlusTreeAdapter {
+public:
+	bool insert(const T& key) {
+		return tree.insert(key, key);
+	}
+	bool find(const T& key) {
+		return tree.search(key) != nullptr;
+	}
+	bool erase(const T& key) {
+		return tree.remove(key);
+	}
+	uint64_t scan() const {
+		uint64_t count = 0;
+		for (auto it = tree.begin(); it != tree.end(); ++it)
+			++count;
+		return count;
+	}
+private:
+	tree::BPlusTree<T> tree;
+};
+
+/**
+ * Adapter for the concurrent B-tree (values are the keys themselves). It is the
+ * only structure whose search and mixed phases run with several threads
+ */
+template<typename T>
+class ConcurrentBtreeAdapter {
+public:
+	bool insert(const T& key) {
+		return tree.insert(key, key);
+	}
+	bool find(const T& key) const {
+		return tree.contains(key);
+	}
+	bool erase(const T& key) {
+		return tree.remove(key);
+	}
+	uint64_t scan() const {
+		std::list<T> keys;
+		tree.getInorder(keys);
+		return keys.size();
+	}
+private:
+	tree::ConcurrentBtree<T> tree;
+};
+
+/**
+ * Adapter for the AVL tree with lock-free readers. Its search and mixed phases run
+ * with several threads as well (changes are made one at a time)
+ */
+template<typename T>
+class SnapshotAVLTreeAdapter {
+public:
+	bool insert(const T& key) {
+		return tree.insert(key);
+	}
+	bool find(const T& key) const {
+		return tree.contains(key);
+	}
+	bool erase(const T& key) {
+		return tree.remove(key);
+	}
+	uint64_t scan() const {
+		std::list<T> keys;
+		tree.getInorder(keys);
+		return keys.size();
+	}
+private:
+	tree::SnapshotAVLTree<T> tree;
+};
+
+/**
+ * Adapter for the sharded AVL tree. It starts with a single shard, which is split
+ * online as it grows. Its search and mixed phases run with several threads
+ */
+template<typename T>
+class ShardedTreeAdapter {
+public:
+	ShardedTreeAdapter() :
+			tree(std::vector<T>(), SHARD_SIZE) {
+	}
+	bool insert(const T& key) {
+		return tree.insert(key);
+	}
+	bool find(const T& key) const {
+		return tree.contains(key);
+	}
+	bool erase(const T& key) {
+		return tree.deleteNode(key);
+	}
+	uint64_t scan() const {
+		uint64_t n = 0;
+		for (auto it = tree.begin(); it != tree.end(); ++it)
+			++n;
+		return n;
+	}
+private:
+	static const size_t SHARD_SIZE = 16 * 1024;
+	tree::ShardedTree<T> tree;
+};
+
+/**
+ * Adapter for the std::set baseline
+ */
+template<typename T>
+class SetAdapter {
+public:
+	bool insert(const T& key) {
+		return set.insert(key).second;
+	}
+	bool find(const T& key) const {
+		return set.find(key) != set.end();
+	}
+	bool erase(const T& key) {
+		return set.erase(key) != 0;
+	}
+	uint64_t scan() const {
+		uint64_t count = 0;
+		for (auto it = set.begin(); it != set.end(); ++it)
+			++count;
+		return count;
+	}
+private:
+	std::set<T> set;
+};
+
+/**
+ * Adapter for the std::map baseline (values are the keys themselves)
+ */
+template<typename T>
+class MapAdapter {
+public:
+	bool insert(const T& key) {
+		return map.emplace(key, key).second;
+	}
+	bool find(const T& key) const {
+		return map.find(key) != map.end();
+	}
+	bool erase(const T& key) {
+		return map.erase(key) != 0;
+	}
+	uint64_t scan() const {
+		uint64_t count = 0;
+		for (auto it = map.begin(); it != map.end(); ++it)
+			++count;
+		return count;
+	}
+private:
+	std::map<T, T> map;
+};
+
+/**
+ * Result of a single phase
+ */
+struct PhaseResult {
+	const char* phase;
+	uint64_t ops;
+	uint64_t hits;
+	double seconds;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsed(Clock::time_point start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * Runs the iterations [0, n) of a loop split in even chunks among threads
+ * @param[in] n Number of iterations
+ * @param[in] threads Number of threads
+ * @param[in] body Function which runs the iterations [begin, end) and returns
+ * their hits
+ * @return Total number of hits
+ */
+template<typename Body>
+uint64_t runParallel(size_t n, unsigned int threads, Body body) {
+	if (threads <= 1)
+		return body(0, n);
+	std::vector<uint64_t> hits(threads, 0);
+	std::vector<std::thread> workers;
+	for (unsigned int t = 0; t < threads; ++t)
+		workers.emplace_back([&, t]() {
+			hits[t] = body(n * t / threads, n * (t + 1) / threads);
+		});
+	for (std::thread& worker : workers)
+		worker.join();
+	return std::accumulate(hits.begin(), hits.end(), uint64_t(0));
+}
+
+/**
+ * Runs all the phases of a workload against a structure
+ * @param[in] w Workload
+ * @param[out] results Results for each phase
+ * @param[in] threads Number of threads for the search and mixed phases (only
+ * for structures which are safe to use concurrently)
+ */
+template<typename T, typename Adapter>
+void runWorkload(const Workload<T>& w, std::vector<PhaseResult>& results,
+		unsigned int threads = 1) {
+	Adapter* adapter = new Adapter();
+
+	uint64_t hits = 0;
+	Clock::time_point start = Clock::now();
+	for (const T& key : w.inserts)
+		hits += adapter->insert(key);
+	results.push_back( { "insert", w.inserts.size(), hits, elapsed(start) });
+
+	start = Clock::now();
+	hits = runParallel(w.searches.size(), threads,
+			[&](size_t begin, size_t end) {
+				uint64_t chunkHits = 0;
+				for (size_t i = begin; i < end; ++i)
+					chunkHits += adapter->find(w.searches[i]);
+				return chunkHits;
+			});
+	results.push_back( { "search", w.searches.size(), hits, elapsed(start) });
+
+	// Full in-order scan (ops are the number of keys visited)
+	start = Clock::now();
+	hits = adapter->scan();
+	results.push_back( { "scan", hits, hits, elapsed(start) });
+
+	if (!w.mixedOps.empty()) {
+		start = Clock::now();
+		hits = runParallel(w.mixedOps.size(), threads,
+				[&](size_t begin, size_t end) {
+					uint64_t chunkHits = 0;
+					for (size_t i = begin; i < end; ++i) {
+						switch (w.mixedOps[i]) {
+						case SEARCH:
+							chunkHits += adapter->find(w.mixedKeys[i]);
+							break;
+						case INSERT:
+							chunkHits += adapter->insert(w.mixedKeys[i]);
+							break;
+						case DELETE:
+							chunkHits += adapter->erase(w.mixedKeys[i]);
+							break;
+						}
+					}
+					return chunkHits;
+				});
+		results.push_back(
+				{ "mixed", w.mixedOps.size(), hits, elapsed(start) });
+	}
+
+	hits = 0;
+	start = Clock::now();
+	for (const T& key : w.deletes)
+		hits += adapter->erase(key);
+	results.push_back( { "delete", w.deletes.size(), hits, elapsed(start) });
+
+	start = Clock::now();
+	delete adapter;
+	results.push_back( { "destroy", w.inserts.size(), 0, elapsed(start) });
+}
+
+/**
+ * Silences std::cout while it is alive, so that the report is not mixed up with
+ * any output written by the structures themselves
+ */
+class MuteStdout {
+public:
+	MuteStdout() :
+			saved(std::cout.rdbuf(nullptr)) {
+	}
+	~MuteStdout() {
+		std::cout.rdbuf(saved);
+	}
+private:
+	std::streambuf* saved;
+};
+
+/**
+ * Estimated bytes per element of a run (keys kept by the workload plus a node
+ * and its allocation overhead)
+ */
+template<typename T>
+uint64_t bytesPerElement() {
+	uint64_t keyBytes = sizeof(T)
+			+ (std::is_same<T, std::string>::value ? 16 : 0);
+	return 4 * keyBytes + sizeof(Node<T>) + 32;
+}
+
+const char* keyTypeName(int) {
+	return "int";
+}
+const char* keyTypeName(double) {
+	return "double";
+}
+const char* keyTypeName(const std::string&) {
+	return "string";
+}
+
+/**
+ * Runs one key type through every selected structure and distribution
+ * @param[in] opts Benchmark options
+ */
+template<typename T>
+void runKeyType(const Options& opts) {
+	static const char* distributions[] = { "uniform", "sorted", "reverse",
+			"zipf", "mixed", "writeheavy" };
+	static const char* structures[] = { "bst", "avl", "rbt", "splay",
+			"semisplay", "btree", "bplus", "cbtree", "savl", "sharded", "set",
+			"map" };
+	const size_t nStructures = sizeof(structures) / sizeof(structures[0]);
+	const char* typeName = keyTypeName(T());
+
+	for (const char* distribution : distributions) {
+		if (!selected(opts.distributions, distribution))
+			continue;
+		std::vector<bool> skipped(nStructures, false);
+		for (uint64_t n = opts.minSize; n <= opts.maxSize; n *= 10) {
+			if (n * bytesPerElement<T>() > opts.maxMemory) {
+				std::cerr << "skipping " << typeName << "/" << distribution
+						<< " n=" << n << ": above the memory limit"
+						<< std::endl;
+				break;
+			}
+			Workload<T> w;
+			buildWorkload<T>(distribution, n, w);
+			for (size_t s = 0; s < nStructures; ++s) {
+				if (!selected(opts.structures, structures[s]) || skipped[s])
+					continue;
+				std::vector<PhaseResult> results;
+				{
+					MuteStdout mute;
+					switch (s) {
+					case 0:
+						runWorkload<T,
+								NodeTreeAdapter<T, tree::BinarySearchTree<T>>>(
+								w, results);
+						break;
+					case 1:
+						runWorkload<T, NodeTreeAdapter<T, tree::AVLTree<T>>>(w,
+								results);
+						break;
+					case 2:
+						runWorkload<T,
+								NodeTreeAdapter<T, tree::RedBlackTree<T>>>(w,
+								results);
+						break;
+					case 3:
+						runWorkload<T, NodeTreeAdapter<T, tree::SplayTree<T>>>(
+								w, results);
+						break;
+					case 4:
+						runWorkload<T, NodeTreeAdapter<T, SemiSplayTree<T>>>(w,
+								results);
+						break;
+					case 5:
+						runWorkload<T, BtreeAdapter<T>>(w, results);
+						break;
+					case 6:
+						runWorkload<T, BPlusTreeAdapter<T>>(w, results);
+						break;
+					case 7:
+						// Only keys which are trivially copyable
+						if constexpr (std::is_trivially_copyable<T>::value)
+							runWorkload<T, ConcurrentBtreeAdapter<T>>(w,
+									results, opts.threads);
+						break;
+					case 8:
+						runWorkload<T, SnapshotAVLTreeAdapter<T>>(w, results,
+								opts.threads);
+						break;
+					case 9:
+						runWorkload<T, ShardedTreeAdapter<T>>(w, results,
+								opts.threads);
+						break;
+					case 10:
+						runWorkload<T, SetAdapter<T>>(w, results);
+						break;
+					case 11:
+						runWorkload<T, MapAdapter<T>>(w, results);
+						break;
+					}
+				}
+				double total = 0;
+				for (const PhaseResult& r : results) {
+					total += r.seconds;
+					double nsPerOp = 1e9 * r.seconds / r.ops;
+					if (opts.csv)
+						std::printf("%s,%s,%s,%llu,%s,%llu,%.1f\n",
+								structures[s], typeName, distribution,
+								static_cast<unsigned long long>(n), r.phase,
+								static_cast<unsigned long long>(r.hits),
+								nsPerOp);
+					else
+						std::printf(
+								"%-7s %-7s %-8s %10llu %-8s hits=%-10llu %12.1f ns/op\n",
+								structures[s], typeName, distribution,
+								static_cast<unsigned long long>(n), r.phase,
+								static_cast<unsigned long long>(r.hits),
+								nsPerOp);
+				}
+				std::fflush(stdout);
+				if (total > opts.budget) {
+					std::cerr << "skipping larger " << structures[s] << "/"
+							<< typeName << "/" << distribution
+							<< " runs: n=" << n << " took " << total << " s"
+							<< std::endl;
+					skipped[s] = true;
+				}
+			}
+		}
+	}
+}
+
+void usage(const char* program) {
+	std::cerr << "Usage: " << program
+			<< " [-n maxSize] [-m minSize] [-t budgetSeconds]"
+			<< " [-M maxMemoryMB] [-s structures] [-d distributions]"
+			<< " [-k keyTypes] [-j threads] [-c]" << std::endl;
+}
+
+} /* namespace */
+
+/*
+ * Benchmark entry point
+ */
+int main(int argc, char** argv) {
+	Options opts;
+	opts.maxMemory = static_cast<uint64_t>(sysconf(_SC_PHYS_PAGES))
+			* static_cast<uint64_t>(sysconf(_SC_PAGE_SIZE)) / 2;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:m:t:M:s:d:k:j:ch")) != -1) {
+		switch (opt) {
+		case 'n':
+			opts.maxSize = std::strtoull(optarg, nullptr, 10);
+			break;
+		case 'm':
+			opts.minSize = std::strtoull(optarg, nullptr, 10);
+			break;
+		case 't':
+			opts.budget = std::strtod(optarg, nullptr);
+			break;
+		case 'M':
+			opts.maxMemory = std::strtoull(optarg, nullptr, 10) << 20;
+			break;
+		case 's':
+			opts.structures = optarg;
+			break;
+		case 'd':
+			opts.distributions = optarg;
+			break;
+		case 'k':
+			opts.keyTypes = optarg;
+			break;
+		case 'j':
+			opts.threads = std::strtoul(optarg, nullptr, 10);
+			break;
+		case 'c':
+			opts.csv = true;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (opts.minSize == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (opts.csv)
+		std::printf("structure,key,distribution,n,phase,hits,ns_per_op\n");
+	if (selected(opts.keyTypes, "int"))
+		runKeyType<int>(opts);
+	if (selected(opts.keyTypes, "double"))
+		runKeyType<double>(opts);
+	if (selected(opts.keyTypes, "string"))
+		runKeyType<std::string>(opts);
+	return 0;
+}
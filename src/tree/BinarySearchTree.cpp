@@ -6,46 +6,381 @@
 
 #include "BinarySearchTree.h"
 
-#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <sstream>
 #include <string>
+#include <type_traits>
 
 namespace tree {
 
+namespace {
+
+/**
+ * First bytes of a serialized tree
+ */
+const char SERIAL_MAGIC[8] = { 'B', 'S', 'T', 'S', 'H', 'A', 'P', 'E' };
+/**
+ * First bytes of a serialized tree whose nodes keep a value
+ */
+const char SERIAL_VALUES_MAGIC[8] = { 'B', 'S', 'T', 'V', 'A', 'L', 'U', 'E' };
+/**
+ * Format of the serialized trees written by this version
+ */
+const uint32_t SERIAL_VERSION = 1;
+/**
+ * Bits of the shape of a node: whether it has a left and a right child
+ */
+const unsigned char HAS_LEFT = 1;
+const unsigned char HAS_RIGHT = 2;
+/**
+ * Height of the highest tree drawn level by level by toString. The width of the
+ * drawing doubles with every level, so higher trees are listed node by node
+ */
+const unsigned int MAX_DRAWN_HEIGHT = 10;
+
+/**
+ * Write a key as its bytes
+ * @param[out] out Stream to write to
+ * @param[in] key Key to write
+ */
 template<typename T>
-BinarySearchTree<T>::BinarySearchTree() :
-		root(nullptr) {
+void writeKey(std::ostream& out, const T& key) {
+	out.write(reinterpret_cast<const char*>(&key), sizeof(T));
 }
 
-template<typename T>
-BinarySearchTree<T>::~BinarySearchTree() {
-	delete this->root;
+/**
+ * Write a string as its length and its characters
+ */
+void writeKey(std::ostream& out, const std::string& key) {
+	uint64_t length = key.size();
+	out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+	out.write(key.data(), length);
 }
 
+/**
+ * Read a key written by writeKey
+ * @param[in] in Stream to read from
+ * @param[out] key Key read
+ * @return Returns whether the key has been read
+ */
 template<typename T>
-bool BinarySearchTree<T>::insertNode(Node<T>* node) {
-	return insertNode(node, nullptr);
+bool readKey(std::istream& in, T& key) {
+	return static_cast<bool>(in.read(reinterpret_cast<char*>(&key), sizeof(T)));
 }
 
+bool readKey(std::istream& in, std::string& key) {
+	uint64_t length;
+	if (!in.read(reinterpret_cast<char*>(&length), sizeof(length)))
+		return false;
+	// Characters are read in chunks, so a corrupt length fails at the end of the
+	// stream instead of allocating it all at once
+	key.clear();
+	char chunk[4096];
+	while (length > 0) {
+		size_t n = std::min<uint64_t>(length, sizeof(chunk));
+		if (!in.read(chunk, n))
+			return false;
+		key.append(chunk, n);
+		length -= n;
+	}
+	return true;
+}
+
+/**
+ * Size of the keys (or values) of a serialized tree (0 for strings, which have no
+ * fixed one)
+ */
 template<typename T>
-bool BinarySearchTree<T>::deleteNode(const T& key) {
+uint32_t serialKeySize() {
+	return std::is_same<T, std::string>::value ? 0 : sizeof(T);
+}
+
+}
+
+template<typename T, typename N>
+BinarySearchTree<T, N>::BinarySearchTree(std::pmr::memory_resource* resource) :
+		root(nullptr), pool(resource), adopted(), orderStatistics(false) {
+}
+
+template<typename T, typename N>
+BinarySearchTree<T, N>::~BinarySearchTree() {
+	clear();
+}
+
+template<typename T, typename N>
+bool BinarySearchTree<T, N>::insertNode(N* node) {
+	NodePath<T> path;
+	if (!insertNode(node, &path))
+		return false;
+	rebalanceInsert(node, path);
+	return true;
+}
+
+template<typename T, typename N>
+bool BinarySearchTree<T, N>::insert(const T& key) {
+	return insertKey(nullptr, key).second;
+}
+
+template<typename T, typename N>
+bool BinarySearchTree<T, N>::insert(T&& key) {
+	return insertKey(nullptr, std::move(key)).second;
+}
+
+template<typename T, typename N>
+Node<T>* BinarySearchTree<T, N>::findPlace(const T& key,
+		NodePath<T>& path) const {
+	Node<T>* node = this->root;
+	while (node != nullptr) {
+		if (key < node->key) {
+			path.push(node);
+			node = node->left;
+		} else if (node->key < key) {
+			path.push(node);
+			node = node->right;
+		} else
+			return node;
+	}
+	return nullptr;
+}
+
+template<typename T, typename N>
+void BinarySearchTree<T, N>::linkNode(Node<T>* node, NodePath<T>& path) {
+	if (path.empty()) {
+		this->root = node;
+	} else {
+		Node<T>* parent = path.top();
+		if (node->key < parent->key)
+			parent->left = node;
+		else
+			parent->right = node;
+		if (orderStatistics)
+			for (size_t i = 0; i < path.size(); ++i)
+				setSize(path[i], subtreeSize(path[i]) + 1);
+	}
+	rebalanceInsert(node, path);
+}
+
+template<typename T, typename N>
+bool BinarySearchTree<T, N>::isPath(const NodePath<T>& path) const {
+	if (path.empty() || (path[0] != this->root))
+		return false;
+	for (size_t i = 1; i < path.size(); ++i)
+		if ((path[i - 1]->left != path[i]) && (path[i - 1]->right != path[i]))
+			return false;
+	return true;
+}
+
+template<typename T, typename N>
+void BinarySearchTree<T, N>::rebalanceInsert(Node<T>*, NodePath<T>& path) {
+	path.clear();
+}
+
+template<typename T, typename N>
+void BinarySearchTree<T, N>::clear() {
+	if (adopted.empty() && TrivialNodeMembers<N>::value) {
+		this->root = nullptr;
+		pool.release();
+		return;
+	}
+	// Nodes have to be destroyed one by one => go along the tree with an explicit
+	// stack of pending subtrees
+	NodePath<T> pending;
+	if (this->root != nullptr)
+		pending.push(this->root);
+	while (!pending.empty()) {
+		Node<T>* node = pending.top();
+		pending.pop();
+		if (node->left != nullptr)
+			pending.push(node->left);
+		if (node->right != nullptr)
+			pending.push(node->right);
+		destroyNode(node);
+	}
+	this->root = nullptr;
+	pool.release();
+}
+
+template<typename T, typename N>
+bool BinarySearchTree<T, N>::serialize(std::ostream& out) const {
+	// 1. Shape of the nodes in a pre-order order (the right child is pushed
+	//    before the left one, so the left subtree is walked first)
+	std::vector<unsigned char> shape;
+	uint64_t count = 0;
+	NodePath<T> pending;
+	if (this->root != nullptr)
+		pending.push(this->root);
+	while (!pending.empty()) {
+		Node<T>* node = pending.top();
+		pending.pop();
+		unsigned char bits = ((node->left != nullptr) ? HAS_LEFT : 0)
+				| ((node->right != nullptr) ? HAS_RIGHT : 0);
+		if (count % 4 == 0)
+			shape.push_back(0);
+		shape.back() |= bits << (2 * (count % 4));
+		++count;
+		if (node->right != nullptr)
+			pending.push(node->right);
+		if (node->left != nullptr)
+			pending.push(node->left);
+	}
+
+	// 2. Header and shape. Trees with values have a magic of their own, and the
+	//    size of the values follows the size of the keys
+	uint32_t version = SERIAL_VERSION;
+	uint32_t keySize = serialKeySize<T>();
+	out.write(N::HAS_VALUE ? SERIAL_VALUES_MAGIC : SERIAL_MAGIC,
+			sizeof(SERIAL_MAGIC));
+	out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+	out.write(reinterpret_cast<const char*>(&keySize), sizeof(keySize));
+	if constexpr (N::HAS_VALUE) {
+		uint32_t valueSize = serialKeySize<typename N::value_type>();
+		out.write(reinterpret_cast<const char*>(&valueSize), sizeof(valueSize));
+	}
+	out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+	out.write(reinterpret_cast<const char*>(shape.data()), shape.size());
+
+	// 3. Keys (each one followed by its value), in the same order
+	if (this->root != nullptr)
+		pending.push(this->root);
+	while (!pending.empty() && out) {
+		Node<T>* node = pending.top();
+		pending.pop();
+		writeKey(out, node->key);
+		if constexpr (N::HAS_VALUE)
+			writeKey(out, static_cast<N*>(node)->value);
+		if (node->right != nullptr)
+			pending.push(node->right);
+		if (node->left != nullptr)
+			pending.push(node->left);
+	}
+	return static_cast<bool>(out);
+}
+
+template<typename T, typename N>
+bool BinarySearchTree<T, N>::deserialize(std::istream& in) {
+	clear();
+	char magic[sizeof(SERIAL_MAGIC)];
+	uint32_t version;
+	uint32_t keySize;
+	uint64_t count;
+	if (!in.read(magic, sizeof(magic))
+			|| (std::memcmp(magic,
+					N::HAS_VALUE ? SERIAL_VALUES_MAGIC : SERIAL_MAGIC,
+					sizeof(magic)) != 0)
+			|| !in.read(reinterpret_cast<char*>(&version), sizeof(version))
+			|| (version != SERIAL_VERSION)
+			|| !in.read(reinterpret_cast<char*>(&keySize), sizeof(keySize))
+			|| (keySize != serialKeySize<T>()))
+		return false;
+	if constexpr (N::HAS_VALUE) {
+		uint32_t valueSize;
+		if (!in.read(reinterpret_cast<char*>(&valueSize), sizeof(valueSize))
+				|| (valueSize != serialKeySize<typename N::value_type>()))
+			return false;
+	}
+	if (!in.read(reinterpret_cast<char*>(&count), sizeof(count)))
+		return false;
+	std::vector<unsigned char> shape;
+	// The shape is read in chunks, so a corrupt count fails at the end of the
+	// stream instead of allocating it all at once
+	for (uint64_t left = (count + 3) / 4; left > 0;) {
+		size_t n = std::min<uint64_t>(left, 1 << 20);
+		shape.resize(shape.size() + n);
+		if (!in.read(reinterpret_cast<char*>(shape.data() + shape.size() - n), n))
+			return false;
+		left -= n;
+	}
+	if (count == 0)
+		return true;
+	pool.reserve(count);
+
+	// Nodes are created in a pre-order order. The path from the root to the
+	// current node is kept with the children each node is still waiting for, and
+	// a node's height and size are set once both its subtrees are complete
+	struct Pending {
+		Node<T>* node;
+		unsigned char waiting;
+	};
+	std::vector<Pending> path;
+	uint64_t created = 0;
+	Node<T>** place = &(this->root);
+	for (;;) {
+		if (place != nullptr) {
+			if (created == count)
+				break;
+			T key;
+			if (!readKey(in, key))
+				break;
+			Node<T>* node;
+			if constexpr (N::HAS_VALUE) {
+				typename N::value_type value;
+				if (!readKey(in, value))
+					break;
+				node = pool.create(std::move(key), std::move(value));
+			} else
+				node = pool.create(std::move(key));
+			*place = node;
+			path.push_back(Pending { node, static_cast<unsigned char>(
+					(shape[created / 4] >> (2 * (created % 4))) & 3) });
+			++created;
+		}
+		Pending& top = path.back();
+		if (top.waiting & HAS_LEFT) {
+			top.waiting &= ~HAS_LEFT;
+			place = &(top.node->left);
+		} else if (top.waiting & HAS_RIGHT) {
+			top.waiting &= ~HAS_RIGHT;
+			place = &(top.node->right);
+		} else {
+			Node<T>* node = top.node;
+			setSize(node, 1 + subtreeSize(node->left) + subtreeSize(node->right));
+			path.pop_back();
+			place = nullptr;
+			if (path.empty())
+				break;
+		}
+	}
+	// Every node must have been read, and no node may be waiting for more
+	if (!path.empty() || (created != count)) {
+		clear();
+		return false;
+	}
+	resetBalance();
+	return true;
+}
+
+template<typename T, typename N>
+void BinarySearchTree<T, N>::destroyNode(Node<T>* node) {
+	node->left = nullptr;
+	node->right = nullptr;
+	// Every node of the tree is an N, so it is destroyed as such without a virtual
+	// destructor. The pool created it unless the caller gave it to the tree
+	if (adopted.empty() || (adopted.erase(node) == 0))
+		pool.destroy(static_cast<N*>(node));
+	else
+		delete static_cast<N*>(node);
+}
+
+template<typename T, typename N>
+bool BinarySearchTree<T, N>::deleteNode(const T& key) {
 	return deleteNode(key, nullptr);
 }
 
-template<typename T>
-bool BinarySearchTree<T>::deleteNode(Node<T>* node) {
+template<typename T, typename N>
+bool BinarySearchTree<T, N>::deleteNode(Node<T>* node) {
 	if (node == nullptr)
 		return false;
 	return deleteNode(node->key);
 }
 
-template<typename T>
-Node<T>* BinarySearchTree<T>::search(const T& key) const {
-	return search(BinarySearchTree<T>::root, key, nullptr);
+template<typename T, typename N>
+N* BinarySearchTree<T, N>::search(const T& key) const {
+	return static_cast<N*>(search(BinarySearchTree<T, N>::root, key, nullptr));
 }
 
-template<typename T>
-Node<T>* BinarySearchTree<T>::search(Node<T>* rootNode, const T& keyValue,
+template<typename T, typename N>
+Node<T>* BinarySearchTree<T, N>::search(Node<T>* rootNode, const T& keyValue,
 		Node<T>** parent) const {
 	Node<T>* p = nullptr;
 	Node<T>* child = rootNode;
@@ -69,74 +404,324 @@ Node<T>* BinarySearchTree<T>::search(Node<T>* rootNode, const T& keyValue,
 	return nullptr;
 }
 
-template<typename T>
-void BinarySearchTree<T>::getInorder(std::list<Node<T>*>& orderedList) const {
-	getInorder(BinarySearchTree<T>::root, orderedList);
+template<typename T, typename N>
+bool BinarySearchTree<T, N>::setOrderStatistics(bool enabled) {
+	if (enabled && !N::HAS_SIZE)
+		return false;
+	if (enabled && !orderStatistics) {
+		// Sizes have not been kept => count them in a post-order order, with the
+		// path to the current node in an explicit stack
+		NodePath<T> path;
+		Node<T>* node = this->root;
+		Node<T>* last = nullptr;
+		while ((node != nullptr) || !path.empty()) {
+			if (node != nullptr) {
+				path.push(node);
+				node = node->left;
+				continue;
+			}
+			Node<T>* top = path.top();
+			if ((top->right != nullptr) && (top->right != last)) {
+				node = top->right;
+				continue;
+			}
+			setSize(top, 1 + subtreeSize(top->left) + subtreeSize(top->right));
+			last = top;
+			path.pop();
+		}
+	}
+	orderStatistics = enabled;
+	return true;
 }
 
-template<typename T>
-void BinarySearchTree<T>::getInorder(Node<T>* root,
-		std::list<Node<T>*>& orderedList) const {
-	if (root == nullptr)
-		return;
-	if (root->left != nullptr)
-		getInorder(root->left, orderedList);
-	orderedList.push_back(root);
-	if (root->right != nullptr)
-		getInorder(root->right, orderedList);
+template<typename T, typename N>
+bool BinarySearchTree<T, N>::hasOrderStatistics() const {
+	return orderStatistics;
 }
 
-template<typename T>
-void BinarySearchTree<T>::getPreorder(std::list<Node<T>*>& orderedList) const {
-	getPreorder(BinarySearchTree<T>::root, orderedList);
+template<typename T, typename N>
+size_t BinarySearchTree<T, N>::size() const {
+	if (orderStatistics)
+		return subtreeSize(this->root);
+	return std::distance(begin(), end());
 }
 
-template<typename T>
-void BinarySearchTree<T>::getPreorder(Node<T>* root,
+template<typename T, typename N>
+size_t BinarySearchTree<T, N>::rank(const T& key) const {
+	return countBelow(key, false);
+}
+
+template<typename T, typename N>
+N* BinarySearchTree<T, N>::select(size_t k) const {
+	if (!orderStatistics) {
+		const_iterator it = begin();
+		for (; (k > 0) && (it != end()); --k)
+			++it;
+		return static_cast<N*>(it.node());
+	}
+	// The size of the left subtree tells which side the k-th node is on
+	Node<T>* node = this->root;
+	while (node != nullptr) {
+		size_t leftSize = subtreeSize(node->left);
+		if (k == leftSize)
+			return static_cast<N*>(node);
+		if (k < leftSize)
+			node = node->left;
+		else {
+			k -= leftSize + 1;
+			node = node->right;
+		}
+	}
+	return nullptr;
+}
+
+template<typename T, typename N>
+size_t BinarySearchTree<T, N>::countInRange(const T& lo, const T& hi) const {
+	if (hi < lo)
+		return 0;
+	if (!orderStatistics)
+		return std::distance(lower_bound(lo), upper_bound(hi));
+	return countBelow(hi, true) - countBelow(lo, false);
+}
+
+template<typename T, typename N>
+size_t BinarySearchTree<T, N>::subtreeSize(Node<T>* node) {
+	if constexpr (N::HAS_SIZE)
+		return (node == nullptr) ? 0 : static_cast<N*>(node)->size;
+	else
+		return 0;
+}
+
+template<typename T, typename N>
+void BinarySearchTree<T, N>::setSize(Node<T>* node, size_t size) {
+	if constexpr (N::HAS_SIZE)
+		static_cast<N*>(node)->size = size;
+}
+
+template<typename T, typename N>
+size_t BinarySearchTree<T, N>::countBelow(const T& key, bool inclusive) const {
+	if (!orderStatistics)
+		return std::distance(begin(),
+				inclusive ? upper_bound(key) : lower_bound(key));
+	// Every time the path goes right, the node and its left subtree are below
+	size_t count = 0;
+	Node<T>* node = this->root;
+	while (node != nullptr) {
+		if ((node->key < key) || (inclusive && !(key < node->key))) {
+			count += subtreeSize(node->left) + 1;
+			node = node->right;
+		} else
+			node = node->left;
+	}
+	return count;
+}
+
+template<typename T, typename N>
+void BinarySearchTree<T, N>::getInorder(std::list<Node<T>*>& orderedList) const {
+	getInorder(BinarySearchTree<T, N>::root, orderedList);
+}
+
+template<typename T, typename N>
+void BinarySearchTree<T, N>::getInorder(Node<T>* root,
 		std::list<Node<T>*>& orderedList) const {
-	if (root == nullptr)
-		return;
-	orderedList.push_back(root);
+	walkNodes(root, false, false, [&orderedList](Node<T>* node, size_t) {
+		orderedList.push_back(node);
+	});
+}
 
-	if (root->left != nullptr)
-		getPreorder(root->left, orderedList);
-	if (root->right != nullptr)
-		getPreorder(root->right, orderedList);
+template<typename T, typename N>
+void BinarySearchTree<T, N>::getPreorder(std::list<Node<T>*>& orderedList) const {
+	getPreorder(BinarySearchTree<T, N>::root, orderedList);
 }
 
-template<typename T>
-void BinarySearchTree<T>::getPostorder(std::list<Node<T>*>& orderedList) const {
-	getPostorder(BinarySearchTree<T>::root, orderedList);
+template<typename T, typename N>
+void BinarySearchTree<T, N>::getPreorder(Node<T>* root,
+		std::list<Node<T>*>& orderedList) const {
+	walkNodes(root, true, false, [&orderedList](Node<T>* node, size_t) {
+		orderedList.push_back(node);
+	});
 }
 
-template<typename T>
-void BinarySearchTree<T>::getPostorder(Node<T>* root,
+template<typename T, typename N>
+void BinarySearchTree<T, N>::getPostorder(std::list<Node<T>*>& orderedList) const {
+	getPostorder(BinarySearchTree<T, N>::root, orderedList);
+}
+
+template<typename T, typename N>
+void BinarySearchTree<T, N>::getPostorder(Node<T>* root,
 		std::list<Node<T>*>& orderedList) const {
-	if (root == nullptr)
-		return;
-	if (root->left != nullptr)
-		getPostorder(root->left, orderedList);
-	if (root->right != nullptr)
-		getPostorder(root->right, orderedList);
-	orderedList.push_back(root);
+	// The post-order is the mirrored pre-order (node, right, left) backwards: each
+	// node goes before the one visited previously
+	typename std::list<Node<T>*>::iterator next = orderedList.end();
+	walkNodes(root, true, true, [&orderedList, &next](Node<T>* node, size_t) {
+		next = orderedList.insert(next, node);
+	});
 }
 
-template<typename T>
-unsigned int BinarySearchTree<T>::getHeight(Node<T>* root) const {
-	if (root == nullptr)
+template<typename T, typename N>
+void BinarySearchTree<T, N>::parallelExport(std::vector<T>& buffer,
+		WorkStealingPool& pool, int forkDepth) const {
+	int depth = forkLevels(forkDepth, pool);
+	SubtreeSizes sizes;
+	countTask(this->root, sizes, depth, pool);
+	buffer.resize(sizes.size);
+	exportTask(this->root, sizes, buffer.data(), depth, pool);
+}
+
+template<typename T, typename N>
+int BinarySearchTree<T, N>::forkLevels(int requested,
+		const WorkStealingPool& pool) {
+	if (requested >= 0)
+		return requested;
+	if (pool.size() <= 1)
 		return 0;
-	return 1 + std::max(getHeight(root->right), getHeight(root->left));
+	// About 8 subtrees per thread, so that stealing evens out uneven subtrees
+	int levels = 3;
+	for (unsigned int threads = pool.size() - 1; threads != 0; threads >>= 1)
+		++levels;
+	return levels;
 }
 
-template<typename T>
-unsigned int BinarySearchTree<T>::getHeight() const {
+template<typename T, typename N>
+void BinarySearchTree<T, N>::countTask(Node<T>* node, SubtreeSizes& sizes,
+		int depth, WorkStealingPool& pool) const {
+	if ((depth <= 0) || (node == nullptr)) {
+		size_t count = 0;
+		auto increment = [&count](const T&) {
+			++count;
+		};
+		forEachInorder(node, increment);
+		sizes.size = count;
+		return;
+	}
+	sizes.children.resize(2);
+	TaskGroup group;
+	pool.submit(group, [&]() {
+		countTask(node->left, sizes.children[0], depth - 1, pool);
+	});
+	countTask(node->right, sizes.children[1], depth - 1, pool);
+	pool.wait(group);
+	sizes.size = sizes.children[0].size + 1 + sizes.children[1].size;
+}
+
+template<typename T, typename N>
+void BinarySearchTree<T, N>::exportTask(Node<T>* node, const SubtreeSizes& sizes,
+		T* out, int depth, WorkStealingPool& pool) const {
+	if ((depth <= 0) || (node == nullptr)) {
+		auto copy = [&out](const T& key) {
+			*(out++) = key;
+		};
+		forEachInorder(node, copy);
+		return;
+	}
+	// The left subtree fills the beginning of the part, and the right one what
+	// is left after the key of the node
+	size_t leftSize = sizes.children[0].size;
+	TaskGroup group;
+	pool.submit(group, [&]() {
+		exportTask(node->left, sizes.children[0], out, depth - 1, pool);
+	});
+	out[leftSize] = node->key;
+	exportTask(node->right, sizes.children[1], out + leftSize + 1, depth - 1,
+			pool);
+	pool.wait(group);
+}
+
+template<typename T, typename N>
+typename BinarySearchTree<T, N>::const_iterator BinarySearchTree<T, N>::begin() const {
+	const_iterator it(this);
+	it.descendLeft(this->root);
+	return it;
+}
+
+template<typename T, typename N>
+typename BinarySearchTree<T, N>::const_iterator BinarySearchTree<T, N>::end() const {
+	return const_iterator(this);
+}
+
+template<typename T, typename N>
+typename BinarySearchTree<T, N>::const_iterator BinarySearchTree<T, N>::lower_bound(
+		const T& key) const {
+	// Go down keeping the path, and remember the deepest node whose key is >= key:
+	// the path up to it is the path of the result
+	const_iterator it(this);
+	size_t found = 0;
+	Node<T>* node = this->root;
+	while (node != nullptr) {
+		it.path.push(node);
+		if (node->key < key)
+			node = node->right;
+		else {
+			found = it.path.size();
+			node = node->left;
+		}
+	}
+	it.path.truncate(found);
+	return it;
+}
+
+template<typename T, typename N>
+typename BinarySearchTree<T, N>::const_iterator BinarySearchTree<T, N>::upper_bound(
+		const T& key) const {
+	// Same as lower_bound, but remembering the deepest node whose key is > key
+	const_iterator it(this);
+	size_t found = 0;
+	Node<T>* node = this->root;
+	while (node != nullptr) {
+		it.path.push(node);
+		if (key < node->key) {
+			found = it.path.size();
+			node = node->left;
+		} else
+			node = node->right;
+	}
+	it.path.truncate(found);
+	return it;
+}
+
+template<typename T, typename N>
+std::pair<typename BinarySearchTree<T, N>::const_iterator,
+		typename BinarySearchTree<T, N>::const_iterator> BinarySearchTree<T, N>::equal_range(
+		const T& key) const {
+	return std::make_pair(lower_bound(key), upper_bound(key));
+}
+
+template<typename T, typename N>
+StaticSearchTree<T> BinarySearchTree<T, N>::freeze() const {
+	std::vector<T> keys;
+	for (const_iterator it = begin(); it != end(); ++it)
+		keys.push_back(*it);
+	return StaticSearchTree<T>(std::move(keys));
+}
+
+template<typename T, typename N>
+unsigned int BinarySearchTree<T, N>::getHeight(Node<T>* root) const {
+	size_t height = 0;
+	walkNodes(root, false, false, [&height](Node<T>*, size_t depth) {
+		height = std::max(height, depth);
+	});
+	return static_cast<unsigned int>(height);
+}
+
+template<typename T, typename N>
+unsigned int BinarySearchTree<T, N>::getHeight() const {
 	return getHeight(this->root);
 }
 
-template<typename T>
-std::string BinarySearchTree<T>::toString() const {
+template<typename T, typename N>
+std::string BinarySearchTree<T, N>::toString() const {
 	std::string output = "";
 	unsigned int height = getHeight(this->root);
+	if (height > MAX_DRAWN_HEIGHT) {
+		// Every node in pre-order, followed by its children ("-" if empty)
+		walkNodes(this->root, true, false, [this, &output](Node<T>* node, size_t) {
+			output += t2str(node->key) + " -> "
+					+ ((node->left == nullptr) ? "-" : t2str(node->left->key)) + ", "
+					+ ((node->right == nullptr) ? "-" : t2str(node->right->key))
+					+ "\n";
+		});
+		return output;
+	}
 	std::vector<std::string> outStrs = std::vector<std::string>(height + 1, "");
 	getStrings(this->root, 0, height, outStrs);
 	for (std::string s : outStrs) {
@@ -145,76 +730,80 @@ std::string BinarySearchTree<T>::toString() const {
 	return output;
 }
 
-template<typename T>
-std::string BinarySearchTree<T>::t2str(T element) const {
+template<typename T, typename N>
+std::string BinarySearchTree<T, N>::t2str(T element) const {
 	std::ostringstream os;
 	os << element;
 	return os.str();
 }
 
-template<typename T>
-void BinarySearchTree<T>::getStrings(Node<T>* root, const unsigned int level,
+template<typename T, typename N>
+void BinarySearchTree<T, N>::getStrings(Node<T>* root, const unsigned int level,
 		const unsigned int height, std::vector<std::string>& strs) const {
-	// Number of nodes in level i: 2^n
-
-	static unsigned short NODESIZE = 2;
-	int spaces = std::pow(2, height - level) - 1;
-	std::string leftStr = std::string((NODESIZE * spaces), ' ');
-	std::string rightStr = std::string(NODESIZE * (spaces + 1), ' ');
-	std::string valStr = "  ";
-	if (root != nullptr) {
-		valStr = t2str(root->key);
-		if (valStr.size() < NODESIZE) {
-			int missing = (valStr.size() - NODESIZE) / 2;
-			std::string tmpLeftStr = "";
-			std::string tmpRightStr = "";
-			if (missing > 0) {
-				std::string tmpLeftStr = std::string(NODESIZE * missing, ' ');
-				std::string tmpRightStr = std::string(NODESIZE * (missing + 1),
-						' ');
+	// Number of nodes in level i: 2^n. The levels are built one after the other,
+	// from left to right, keeping the (possibly empty) nodes of the current one
+
+	static const size_t NODESIZE = 2;
+	// The widths grow as 2^(height - level) => too many levels do not fit
+	if ((level > height) || (height - level > MAX_DRAWN_HEIGHT))
+		return;
+	std::vector<Node<T>*> nodes(1, root);
+	for (unsigned int current = level; current <= height; ++current) {
+		size_t spaces = (size_t(1) << (height - current)) - 1;
+		std::string leftStr = std::string((NODESIZE * spaces), ' ');
+		std::string rightStr = std::string(NODESIZE * (spaces + 1), ' ');
+		std::vector<Node<T>*> children;
+		for (Node<T>* node : nodes) {
+			std::string valStr = "  ";
+			if (node != nullptr) {
+				valStr = t2str(node->key);
+				if (valStr.size() < NODESIZE) {
+					size_t missing = NODESIZE - valStr.size();
+					valStr = std::string(missing / 2, ' ') + valStr
+							+ std::string(missing - missing / 2, ' ');
+				}
+			}
+			strs[current] += leftStr + valStr + rightStr;
+			if (current < height) {
+				children.push_back((node == nullptr) ? nullptr : node->left);
+				children.push_back((node == nullptr) ? nullptr : node->right);
 			}
-			valStr = tmpLeftStr + valStr + tmpRightStr;
-		}
-	}
-	strs[level] += leftStr + valStr + rightStr;
-	if (level < height) {
-		if (root == nullptr) {
-			getStrings(root, level + 1, height, strs);
-			getStrings(root, level + 1, height, strs);
-		} else {
-			getStrings(root->left, level + 1, height, strs);
-			getStrings(root->right, level + 1, height, strs);
 		}
+		nodes.swap(children);
 	}
-
 }
 
-template<typename T>
-bool BinarySearchTree<T>::insertNode(Node<T>* node,
-		std::stack<Node<T>*>* stackTree) {
+template<typename T, typename N>
+bool BinarySearchTree<T, N>::insertNode(Node<T>* node, NodePath<T>* path) {
 
 	// This first part consists of inserting the node into the tree, without
-	// restrictions. We could have use the BinarySearchTree<T>::insert method except
+	// restrictions. We could have use the BinarySearchTree<T, N>::insert method except
 	// because we need to keep the nodes we go through in order to, later,
 	// go from the bottom to the top in case the tree is not balanced. Additionally,
 	// we need to keep the parent node
 
 	if (node == nullptr)
 		return false;
+	setSize(node, 1);
+	// The sizes of the subtrees are updated along the path once the node is in
+	NodePath<T> counted;
+	if ((path == nullptr) && orderStatistics)
+		path = &counted;
 
 	// The tree does not have a root element
-	if (BinarySearchTree<T>::root == nullptr) {
-		BinarySearchTree<T>::root = node;
+	if (BinarySearchTree<T, N>::root == nullptr) {
+		BinarySearchTree<T, N>::root = node;
+		adopted.insert(node);
 		return true;
 	} else {
 		// Get the root
-		Node<T>* child = BinarySearchTree<T>::root;
+		Node<T>* child = BinarySearchTree<T, N>::root;
 
 		// Go across the tree to search the corresponding gap for the element
 		while (true) {
-			// Insert the current node in the stack
-			if (stackTree != nullptr)
-				stackTree->push(child);
+			// Insert the current node in the path
+			if (path != nullptr)
+				path->push(child);
 
 			// Insert to the left
 			if (child->key > node->key) {
@@ -232,64 +821,191 @@ bool BinarySearchTree<T>::insertNode(Node<T>* node,
 				}
 				child = child->right;
 			} else { // The node already exists
-				// Clean the stack tree before exiting
-				while (!stackTree->empty())
-					stackTree->pop();
+				// Clean the path before exiting
+				if (path != nullptr)
+					path->clear();
 				return false;
 			}
 		}
+		if (orderStatistics)
+			for (size_t i = 0; i < path->size(); ++i)
+				setSize((*path)[i], subtreeSize((*path)[i]) + 1);
+		adopted.insert(node);
 		return true;
 	}
 }
 
-template<typename T>
-bool BinarySearchTree<T>::deleteNode(const T& key,
-		std::stack<Node<T>*>* stackTree) {
+template<typename T, typename N>
+size_t BinarySearchTree<T, N>::insertSorted(const std::vector<T>& keys) {
+	// Each pending entry is a place of the tree (a child pointer) and the part of
+	// the batch which goes below it. A node splits its part in two around its
+	// key, so the keys which share a path go down it only once. With order
+	// statistics, an entry without a place recounts the size of a node once both
+	// its children are done
+	struct Pending {
+		Node<T>** place;
+		size_t first;
+		size_t last;
+		Node<T>* counted;
+	};
+	std::vector<Pending> pending;
+	pending.push_back(Pending { &(this->root), 0, keys.size(), nullptr });
+	size_t inserted = 0;
+	while (!pending.empty()) {
+		Pending part = pending.back();
+		pending.pop_back();
+		if (part.place == nullptr) {
+			setSize(part.counted, 1 + subtreeSize(part.counted->left)
+					+ subtreeSize(part.counted->right));
+			continue;
+		}
+		if (part.first == part.last)
+			continue;
+		Node<T>* node = *(part.place);
+		// An empty place => the keys become a subtree of minimum height
+		if (node == nullptr) {
+			typename std::vector<T>::const_iterator it = keys.begin() + part.first;
+			*(part.place) = buildSubtree(it, keys.begin() + part.last,
+					part.last - part.first);
+			inserted += part.last - part.first;
+			continue;
+		}
+		size_t mid = std::lower_bound(keys.begin() + part.first,
+				keys.begin() + part.last, node->key) - keys.begin();
+		// The key of the node is not inserted again
+		size_t next = ((mid < part.last) && !(node->key < keys[mid])) ?
+				mid + 1 : mid;
+		if (orderStatistics)
+			pending.push_back(Pending { nullptr, 0, 0, node });
+		pending.push_back(Pending { &(node->right), next, part.last, nullptr });
+		pending.push_back(Pending { &(node->left), part.first, mid, nullptr });
+	}
+	return inserted;
+}
+
+template<typename T, typename N>
+void BinarySearchTree<T, N>::resetBalance() {
+}
+
+template<typename T, typename N>
+void BinarySearchTree<T, N>::rebuild() {
+	std::vector<Node<T>*> nodes;
+	NodePath<T> pending;
+	for (Node<T>* node = this->root; (node != nullptr) || !pending.empty();) {
+		for (; node != nullptr; node = node->left)
+			pending.push(node);
+		node = pending.top();
+		pending.pop();
+		nodes.push_back(node);
+		node = node->right;
+	}
+	typename std::vector<Node<T>*>::iterator it = nodes.begin();
+	this->root = buildSubtree(it, nodes.end(), nodes.size());
+}
+
+template<typename T, typename N>
+const T& BinarySearchTree<T, N>::keyOf(const T& element) {
+	return element;
+}
+
+template<typename T, typename N>
+const T& BinarySearchTree<T, N>::keyOf(Node<T>* element) {
+	return element->key;
+}
+
+template<typename T, typename N>
+Node<T>* BinarySearchTree<T, N>::createNode(const T& element) {
+	return pool.create(element);
+}
 
-	// Search the node to be removed
-	Node<T> *parent = nullptr;
-	Node<T>* currNode = this->search(this->root, key, &parent);
+template<typename T, typename N>
+Node<T>* BinarySearchTree<T, N>::createNode(Node<T>* element) {
+	return element;
+}
+
+template<typename T, typename N>
+bool BinarySearchTree<T, N>::deleteNode(const T& key, NodePath<T>* path) {
+
+	// Search the node to be removed, keeping the path followed (the sizes of the
+	// subtrees are updated along it once the node is out)
+	NodePath<T> counted;
+	if ((path == nullptr) && orderStatistics)
+		path = &counted;
+	Node<T>* parent = nullptr;
+	Node<T>* currNode = this->root;
+	while ((currNode != nullptr) && !(currNode->key == key)) {
+		if (path != nullptr)
+			path->push(currNode);
+		parent = currNode;
+		currNode = (key < currNode->key) ? currNode->left : currNode->right;
+	}
 	// Node has not found => cannot delete it
-	if (currNode == nullptr)
+	if (currNode == nullptr) {
+		if (path != nullptr)
+			path->clear();
 		return false;
+	}
 
 	// ALGORITHM:
-	// Current node has only 0 or 1 child
+	// 1. Current node has only 0 or 1 child => set the child in its place
 	if ((currNode->left == nullptr) || (currNode->right == nullptr)) {
 		Node<T>* childNode =
-				(currNode->left != nullptr) ?
-						currNode->left :
-						((currNode->right != nullptr) ?
-								currNode->right : nullptr);
-		// 1. This is a root node => set child as root node
-		if (parent == nullptr)
-			this->root = childNode;
-		// 2. Current node is not root => set current child as parent child
-		else {
-			if (currNode->key < parent->key)
-				parent->left = childNode;
-			else
-				parent->right = childNode;
-		}
-		delete currNode;
-		currNode = nullptr;
+				(currNode->left != nullptr) ? currNode->left : currNode->right;
+		replaceChild(parent, currNode, childNode);
 	}
-	// 2. The node has both right and left children => update the tree
+	// 2. The node has both right and left children => the minimum node in the
+	//    right subtree (its in-order successor) is unlinked and takes its place
 	else {
-		// 2.1 Find the minimum value in the right subtree
-		Node<T>* min = minNode(currNode->right);
-		// 2.2 Get minimum value
-		T minKey = min->key;
-		// 2.3 Remove node with such value
-		deleteNode(minKey);
-		// 2.4 Update current node value
-		currNode->key = minKey;
+		// 2.1 Find the minimum node in the right subtree, going on with the path.
+		//     The current node is in the path as well, but it is replaced below
+		size_t currPos = 0;
+		if (path != nullptr) {
+			currPos = path->size();
+			path->push(currNode);
+		}
+		Node<T>* minParent = currNode;
+		Node<T>* min = currNode->right;
+		while (min->left != nullptr) {
+			if (path != nullptr)
+				path->push(min);
+			minParent = min;
+			min = min->left;
+		}
+		// 2.2 Unlink the minimum node (it has no left child)
+		if (minParent == currNode)
+			minParent->right = min->right;
+		else
+			minParent->left = min->right;
+		// 2.3 Set the minimum node in the place of the current node
+		min->left = currNode->left;
+		min->right = currNode->right;
+		if constexpr (N::HAS_HEIGHT)
+			static_cast<N*>(min)->height = static_cast<N*>(currNode)->height;
+		setSize(min, subtreeSize(currNode));
+		replaceChild(parent, currNode, min);
+		if (path != nullptr)
+			(*path)[currPos] = min;
 	}
+	if (orderStatistics)
+		for (size_t i = 0; i < path->size(); ++i)
+			setSize((*path)[i], subtreeSize((*path)[i]) - 1);
+	destroyNode(currNode);
 	return true;
 }
 
-template<typename T>
-Node<T>* BinarySearchTree<T>::minNode(Node<T>* rootNode) const {
+template<typename T, typename N>
+void BinarySearchTree<T, N>::replaceChild(Node<T>* parent, Node<T>* oldChild,
+		Node<T>* newChild) {
+	if (parent == nullptr)
+		this->root = newChild;
+	else if (parent->left == oldChild)
+		parent->left = newChild;
+	else
+		parent->right = newChild;
+}
+
+template<typename T, typename N>
+Node<T>* BinarySearchTree<T, N>::minNode(Node<T>* rootNode) const {
 	if (rootNode == nullptr)
 		return nullptr;
 	Node<T>* min = rootNode;
@@ -302,5 +1018,20 @@ template class BinarySearchTree<int> ;
 template class BinarySearchTree<float> ;
 template class BinarySearchTree<double> ;
 template class BinarySearchTree<std::string> ;
+template class BinarySearchTree<int, ExtendedNode<int, int>> ;
+template class BinarySearchTree<int, SizedNode<Node<int>>> ;
+// Bases of the balanced trees (see AVLTree and RedBlackTree)
+template class BinarySearchTree<int, AVLNode<Node<int>>> ;
+template class BinarySearchTree<float, AVLNode<Node<float>>> ;
+template class BinarySearchTree<double, AVLNode<Node<double>>> ;
+template class BinarySearchTree<std::string, AVLNode<Node<std::string>>> ;
+template class BinarySearchTree<int, AVLNode<ExtendedNode<int, int>>> ;
+template class BinarySearchTree<int, AVLNode<SizedNode<Node<int>>>> ;
+template class BinarySearchTree<int, RedBlackNode<Node<int>>> ;
+template class BinarySearchTree<float, RedBlackNode<Node<float>>> ;
+template class BinarySearchTree<double, RedBlackNode<Node<double>>> ;
+template class BinarySearchTree<std::string, RedBlackNode<Node<std::string>>> ;
+template class BinarySearchTree<int, RedBlackNode<ExtendedNode<int, int>>> ;
+template class BinarySearchTree<int, RedBlackNode<SizedNode<Node<int>>>> ;
 
 } /* namespace tree */
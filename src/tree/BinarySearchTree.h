@@ -8,9 +8,23 @@
 #define SRC_TREE_BINARYSEARCHTREE_H_
 
 #include "Node.h"
+#include "NodePath.h"
+#include "NodePool.h"
+#include "ParallelSort.h"
+#include "StaticSearchTree.h"
+#include "WorkStealingPool.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <istream>
+#include <iterator>
 #include <list>
-#include <stack>
+#include <memory_resource>
+#include <ostream>
+#include <thread>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace tree {
@@ -26,23 +40,259 @@ namespace tree {
  * - The access to an element of an array is 1 if we know the index. The access to
  *   the structure implemented here is log(N). However, we rarely know the index
  *   of the array by default.
+ * Trees which are not going to change any more can be turned into that array
+ * layout with freeze() (see StaticSearchTree).
+ * Nothing in the tree recurses on its height, so trees which have degenerated into
+ * a chain (e.g. a BinarySearchTree fed sorted keys) do not overflow the stack: the
+ * ordered lists and the height are got walking the tree with an explicit stack
+ * (see NodePath), which does not change the tree.
+ * The type of the nodes is chosen at compile time: Node<T> keeps only the key,
+ * and ExtendedNode<T, U> keeps a value beside it. Nodes have no virtual methods,
+ * so every node of a tree has the same type N, which is the one the tree creates,
+ * returns and deletes. The bookkeeping of every tree is a layer over them, so
+ * nodes only pay for what their tree uses: SizedNode for order statistics (e.g.
+ * BinarySearchTree<int, SizedNode<Node<int>>>), AVLNode and RedBlackNode for the
+ * balanced trees.
  */
-template<typename T>
+template<typename T, typename N = Node<T>>
 class BinarySearchTree {
 public:
+	/**
+	 * Bidirectional iterator which goes along the tree in an in-order order. Nodes
+	 * do not point to their parent, so the iterator keeps the path from the root to
+	 * the current node: it needs O(height) space and it does not allocate memory
+	 * for balanced trees. Iterators are invalidated by any change in the tree.
+	 */
+	class const_iterator {
+	public:
+		typedef std::bidirectional_iterator_tag iterator_category;
+		typedef T value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const T* pointer;
+		typedef const T& reference;
+
+		const_iterator() :
+				tree(nullptr), path() {
+		}
+		reference operator*() const {
+			return path.top()->key;
+		}
+		pointer operator->() const {
+			return &(path.top()->key);
+		}
+		/**
+		 * Get the current node
+		 * @return Returns the current node, or nullptr for the end of the tree
+		 */
+		Node<T>* node() const {
+			return path.empty() ? nullptr : path.top();
+		}
+		const_iterator& operator++() {
+			Node<T>* current = path.top();
+			if (current->right != nullptr) {
+				descendLeft(current->right);
+				return *this;
+			}
+			// Go up until we come from a left child
+			path.pop();
+			while (!path.empty() && (path.top()->right == current)) {
+				current = path.top();
+				path.pop();
+			}
+			return *this;
+		}
+		const_iterator operator++(int) {
+			const_iterator previous = *this;
+			++(*this);
+			return previous;
+		}
+		const_iterator& operator--() {
+			if (path.empty()) {
+				descendRight(tree->root);
+				return *this;
+			}
+			Node<T>* current = path.top();
+			if (current->left != nullptr) {
+				descendRight(current->left);
+				return *this;
+			}
+			// Go up until we come from a right child
+			path.pop();
+			while (!path.empty() && (path.top()->left == current)) {
+				current = path.top();
+				path.pop();
+			}
+			return *this;
+		}
+		const_iterator operator--(int) {
+			const_iterator previous = *this;
+			--(*this);
+			return previous;
+		}
+		bool operator==(const const_iterator& other) const {
+			return node() == other.node();
+		}
+		bool operator!=(const const_iterator& other) const {
+			return node() != other.node();
+		}
+	private:
+		friend class BinarySearchTree<T, N>;
+		explicit const_iterator(const BinarySearchTree<T, N>* tree) :
+				tree(tree), path() {
+		}
+		/**
+		 * Go down from a node to the minimum node of its subtree
+		 * @param[in] node Root of the subtree
+		 */
+		void descendLeft(Node<T>* node) {
+			for (; node != nullptr; node = node->left)
+				path.push(node);
+		}
+		/**
+		 * Go down from a node to the maximum node of its subtree
+		 * @param[in] node Root of the subtree
+		 */
+		void descendRight(Node<T>* node) {
+			for (; node != nullptr; node = node->right)
+				path.push(node);
+		}
+		const BinarySearchTree<T, N>* tree;
+		NodePath<T> path;
+	};
+	typedef const_iterator iterator;
+	/**
+	 * Type of the nodes which the tree creates, takes (see insertNode) and returns
+	 */
+	typedef N node_type;
+
 	/**
 	 * Class constructor
+	 * @param[in] resource Memory resource backing the nodes created by the tree
 	 */
-	BinarySearchTree();
+	explicit BinarySearchTree(std::pmr::memory_resource* resource =
+			std::pmr::get_default_resource());
 	/**
 	 * Class destructor
 	 */
 	virtual ~BinarySearchTree();
+	BinarySearchTree(const BinarySearchTree&) = delete;
+	BinarySearchTree& operator=(const BinarySearchTree&) = delete;
 	/**
-	 * Insert a new node with a given value in the tree
+	 * Insert a new node with a given value in the tree. The tree takes the
+	 * ownership of the node, which must have been allocated with new as an N (it
+	 * is deleted as such). If the key
+	 * already exists, the node still belongs to the caller (see emplace, which
+	 * does not allocate anything in that case)
 	 * @param[in] key Node to insert in the tree
 	 */
-	virtual bool insertNode(Node<T>* node);
+	virtual bool insertNode(N* node);
+	/**
+	 * Nodes of any other type are not taken, since they would be deleted as an N
+	 */
+	template<typename M>
+	bool insertNode(M* node) = delete;
+	/**
+	 * Insert a new key in the tree. The tree is searched first, and the node is
+	 * only created (in the node pool of the tree) if the key is missing
+	 * @param[in] key Key to insert in the tree
+	 * @return Returns true if the key has been inserted, false if it already
+	 * existed
+	 */
+	bool insert(const T& key);
+	/**
+	 * Insert a new key in the tree, moving it into its node if it is missing
+	 * @param[in] key Key to insert in the tree
+	 * @return Returns true if the key has been inserted, false if it already
+	 * existed
+	 */
+	bool insert(T&& key);
+	/**
+	 * Insert a key and its value, in the trees whose nodes keep a value (see
+	 * ExtendedNode; the other insertions value-initialize it). Arguments which are
+	 * rvalues are moved into the node, which is only created if the key is missing
+	 * @param[in] key Key to insert in the tree
+	 * @param[in] value Value associated to the key
+	 * @return Returns true if the key has been inserted, false if it already
+	 * existed (its value is not changed)
+	 */
+	template<typename KeyArg, typename ValueArg>
+	bool insert(KeyArg&& key, ValueArg&& value);
+	/**
+	 * Insert a key built from some arguments. A key given as such is only
+	 * compared while looking for it, and it is copied or moved into a new node of
+	 * the node pool once it is known to be missing; any other arguments build a
+	 * key first, which is moved into the node
+	 * @param[in] args Key, or arguments for the constructor of the key
+	 * @return Returns an iterator to the key in the tree and whether it has been
+	 * inserted (false if it already existed)
+	 */
+	template<typename ... Args>
+	std::pair<const_iterator, bool> emplace(Args&&... args);
+	/**
+	 * Replace the contents of the tree by the keys in a sorted range, building a
+	 * tree of minimum height (which is a valid AVL tree) in O(n). All the nodes are
+	 * created in a single contiguous slab, in an in-order order. Repeated keys are
+	 * inserted only once. Trees whose nodes keep a value take a range of (key,
+	 * value) pairs as well, sorted by key.
+	 * @param[in] first Beginning of the range (sorted in ascending order)
+	 * @param[in] last End of the range
+	 */
+	template<typename ForwardIt>
+	void buildFromSorted(ForwardIt first, ForwardIt last);
+	/**
+	 * Replace the contents of the tree by the keys in a range which is not sorted.
+	 * Keys are copied and sorted in parallel before building the tree.
+	 * @param[in] first Beginning of the range
+	 * @param[in] last End of the range
+	 * @param[in] threads Number of threads used to sort the keys
+	 * @see buildFromSorted
+	 */
+	template<typename InputIt>
+	void buildFromUnsorted(InputIt first, InputIt last, unsigned int threads =
+			std::thread::hardware_concurrency());
+	/**
+	 * Insert a batch of keys in the tree. The batch is sorted (in parallel) and
+	 * merged into the tree in a single walk: the keys which go down the same path
+	 * share the descent, and the keys which fall in the same empty place are
+	 * linked there as a subtree of minimum height. As with insertNode, keys which
+	 * already exist (or are repeated in the batch) are inserted only once.
+	 * @param[in] first Beginning of the range
+	 * @param[in] last End of the range
+	 * @param[in] threads Number of threads used to sort the keys
+	 * @return Number of keys which have been inserted
+	 */
+	template<typename InputIt>
+	size_t insertBatch(InputIt first, InputIt last, unsigned int threads =
+			std::thread::hardware_concurrency());
+	/**
+	 * Write the tree to a stream in a compact binary format: the number of keys,
+	 * the shape of the tree (two bits per node in a pre-order order, for whether it
+	 * has a left and a right child) and then the keys in the same order. Keys are
+	 * written as they are in memory (strings as their length and characters), so
+	 * the stream can only be read on machines with the same byte order and type
+	 * sizes. Trees whose nodes keep a value write it after its key, and their
+	 * streams are only read by trees with the same type of nodes. For a read-only
+	 * copy of the keys which can be mapped from a file without loading it, see
+	 * freeze() and StaticSearchTree::write
+	 * @param[out] out Stream to write to
+	 * @return Returns whether the tree has been written
+	 */
+	bool serialize(std::ostream& out) const;
+	/**
+	 * Replace the contents of the tree by a tree written by serialize, with the same
+	 * shape, in O(n): no key is compared and no node is rotated, and all the nodes
+	 * are created in a single contiguous slab
+	 * @param[in] in Stream to read from
+	 * @return Returns whether a valid tree has been read (otherwise the tree is
+	 * left empty)
+	 */
+	bool deserialize(std::istream& in);
+	/**
+	 * Remove all the nodes from the tree. When all the nodes have been created by
+	 * the tree and their keys do not need to be destroyed, the memory is released
+	 * slab by slab, without going through the nodes
+	 */
+	void clear();
 	/**
 	 * Removes a node with a given value
 	 * @param[in] key Key to remove from the tree
@@ -58,7 +308,51 @@ public:
 	 * @param[in] key Key to search in the tree
 	 * @return Returns the node with the given value, or nullptr in case it was not found
 	 */
-	Node<T>* search(const T& key) const;
+	N* search(const T& key) const;
+	/**
+	 * Keep (or stop keeping) the number of nodes of every subtree in its root, so
+	 * that size, rank, select and countInRange go down a single path instead of
+	 * walking the keys. Sizes are updated along the path of every insertion and
+	 * deletion; when they are enabled, the whole tree is counted once in O(n)
+	 * @param[in] enabled Whether the sizes of the subtrees are kept
+	 * @return Returns false if they were enabled but the nodes do not keep a size
+	 * (N is not a SizedNode), true otherwise
+	 */
+	bool setOrderStatistics(bool enabled);
+	/**
+	 * Verifies whether the tree keeps the sizes of its subtrees
+	 * @return Returns true if order statistics are enabled
+	 */
+	bool hasOrderStatistics() const;
+	/**
+	 * Get the number of keys in the tree. O(1) with order statistics, O(n)
+	 * otherwise
+	 * @return Number of keys
+	 */
+	size_t size() const;
+	/**
+	 * Get the position a key has (or would have) in the tree. O(height) with order
+	 * statistics, O(rank) otherwise
+	 * @param[in] key Key to compare with
+	 * @return Number of keys lower than the given one
+	 */
+	size_t rank(const T& key) const;
+	/**
+	 * Get the node at a given position of the in-order order. O(height) with
+	 * order statistics, O(k) otherwise
+	 * @param[in] k Position of the node (0 for the minimum key)
+	 * @return Returns the node with the k-th lowest key, or nullptr if the tree has
+	 * k keys or less
+	 */
+	N* select(size_t k) const;
+	/**
+	 * Count the keys in a closed range. O(height) with order statistics, O(height
+	 * + result) otherwise
+	 * @param[in] lo Lowest key of the range
+	 * @param[in] hi Highest key of the range
+	 * @return Number of keys k with lo <= k <= hi (0 if hi < lo)
+	 */
+	size_t countInRange(const T& lo, const T& hi) const;
 	/**
 	 * Go along the tree in an in-order order.
 	 * @param[out] orderedList List in n pre-order order
@@ -74,13 +368,89 @@ public:
 	 * @param[out] orderedList List in n pre-order order
 	 */
 	void getPostorder(std::list<Node<T>*>& orderedList) const;
+	/**
+	 * Call a function for every key of the tree, using several threads: subtrees
+	 * are forked as tasks of a work-stealing pool down to a given depth, and they
+	 * are walked sequentially below it. The function is called from several
+	 * threads at once, in no particular order. If it throws, the exception is
+	 * thrown again here once every task has finished
+	 * @param[in] function Function called with each key
+	 * @param[in] pool Pool which runs the tasks
+	 * @param[in] forkDepth Levels of the tree whose subtrees are forked (0 for a
+	 * sequential walk, negative for about 8 subtrees per thread)
+	 */
+	template<typename F>
+	void parallelForEach(F function, WorkStealingPool& pool =
+			WorkStealingPool::instance(), int forkDepth = -1) const;
+	/**
+	 * Aggregate the keys of the tree using several threads (see parallelForEach).
+	 * Partial results are combined in the in-order order, so the combination only
+	 * needs to be associative
+	 * @param[in] identity Result for an empty subtree
+	 * @param[in] map Function which gets the result for a key
+	 * @param[in] combine Function which combines two results
+	 * @param[in] pool Pool which runs the tasks
+	 * @param[in] forkDepth Levels of the tree whose subtrees are forked
+	 * @return Combination of the results of all the keys
+	 */
+	template<typename R, typename Map, typename Combine>
+	R parallelReduce(R identity, Map map, Combine combine,
+			WorkStealingPool& pool = WorkStealingPool::instance(),
+			int forkDepth = -1) const;
+	/**
+	 * Copy the keys of the tree in an in-order order to a contiguous buffer, using
+	 * several threads: the sizes of the forked subtrees are counted first, so that
+	 * each one is copied to its own part of the buffer
+	 * @param[out] buffer Keys of the tree in an in-order order
+	 * @param[in] pool Pool which runs the tasks
+	 * @param[in] forkDepth Levels of the tree whose subtrees are forked
+	 */
+	void parallelExport(std::vector<T>& buffer, WorkStealingPool& pool =
+			WorkStealingPool::instance(), int forkDepth = -1) const;
+	/**
+	 * Get an iterator to the minimum key of the tree
+	 * @return Iterator to the first key in an in-order order
+	 */
+	const_iterator begin() const;
+	/**
+	 * Get an iterator past the maximum key of the tree
+	 * @return Iterator to the end of the tree
+	 */
+	const_iterator end() const;
+	/**
+	 * Get an iterator to the first key which is not lower than a given one
+	 * @param[in] key Key to compare with
+	 * @return Iterator to the first key >= key, or end() if there is none
+	 */
+	const_iterator lower_bound(const T& key) const;
+	/**
+	 * Get an iterator to the first key which is higher than a given one
+	 * @param[in] key Key to compare with
+	 * @return Iterator to the first key > key, or end() if there is none
+	 */
+	const_iterator upper_bound(const T& key) const;
+	/**
+	 * Get the range of keys which are equal to a given one
+	 * @param[in] key Key to compare with
+	 * @return Pair of iterators with lower_bound(key) and upper_bound(key)
+	 */
+	std::pair<const_iterator, const_iterator> equal_range(const T& key) const;
+	/**
+	 * Take a read-only snapshot of the keys of the tree, kept in a single array in
+	 * the Eytzinger order (values are not kept). Later changes in the tree do not
+	 * affect the snapshot
+	 * @return Static search tree with the same keys
+	 */
+	StaticSearchTree<T> freeze() const;
 	/**
 	 * Get the height of the tree
 	 * @return Height of the tree
 	 */
 	unsigned int getHeight() const;
 	/**
-	 * Converts the tree into a printable format
+	 * Converts the tree into a printable format: the levels are drawn one under the
+	 * other, unless the tree is too high to draw (more than 10 levels), in which
+	 * case every node is listed with its children
 	 * @return Returns the string with the tree structure
 	 */
 	std::string toString() const;
@@ -126,9 +496,10 @@ protected:
 	std::string t2str(T element) const;
 
 	/**
-	 * This method obtain the strings corresponding to each tree level
+	 * This method obtain the strings corresponding to each tree level. Nothing is
+	 * obtained for trees too high to draw (see toString)
 	 * @param[in] root Root node for the tree
-	 * @param[in] level Current level to process
+	 * @param[in] level Level of the root node
 	 * @param[in] height Tree height
 	 * @param[out] strs List of strings corresponding to each level
 	 */
@@ -144,23 +515,215 @@ protected:
 	/**
 	 * This method inserts the not in the tree
 	 * @param[in] node Node to be inserted
-	 * @param[in|out] stackTree List of nodes indicating the path followed to insert
-	 * the new node. Note: if the stackTree is originally null, the insertion on the
-	 * stack will be ignored
+	 * @param[in|out] path Nodes followed from the root to insert the new node (the
+	 * new node is not included). Note: if the path is originally null, it will be
+	 * ignored
 	 * @return Returns true if the node has been inserted, false otherwise
 	 */
-	bool insertNode(Node<T>* node, std::stack<Node<T>*>* stackTree);
+	bool insertNode(Node<T>* node, NodePath<T>* path);
+	/**
+	 * Restore the balance of a derived tree once a new node has been linked to it
+	 * (by insertNode, insert or emplace). Sizes are already updated along the
+	 * path, so nothing else is done by default
+	 * @param[in] node Node which has been linked
+	 * @param[in|out] path Nodes from the root to the parent of the node (it is
+	 * cleared)
+	 */
+	virtual void rebalanceInsert(Node<T>* node, NodePath<T>& path);
+	/**
+	 * Merge a batch of keys into the tree (see insertBatch)
+	 * @param[in] keys Keys to insert, sorted in ascending order and without
+	 * repeated ones
+	 * @return Number of keys which have been inserted
+	 */
+	virtual size_t insertSorted(const std::vector<T>& keys);
+	/**
+	 * Set the balance data of a derived tree once the whole tree has been replaced
+	 * by buildFromSorted or deserialize. Heights and sizes are already set, so
+	 * nothing is done by default
+	 */
+	virtual void resetBalance();
+	/**
+	 * Link the nodes of the tree again as a tree of minimum height (see
+	 * buildFromSorted) in O(n). No node is created or destroyed, so their values
+	 * are kept
+	 */
+	void rebuild();
 
 	/**
-	 * Removes a node in the tree with a given value
+	 * Removes a node in the tree with a given value. The tree is walked down only
+	 * once: when the node has two children, its in-order successor is unlinked and
+	 * set in its place
 	 * @param[in] key Value to remove in the node
-	 * @param[in|out] stackTree Stack which indicates the path from the beginning to the deleted tree.
-	 * In case it is null, this parameter will be ignored.
+	 * @param[in|out] path Path from the root to the parent of the node which has been
+	 * unlinked from its place (i.e. every node whose subtree has changed). In case
+	 * it is null, this parameter will be ignored.
 	 * @return Returns whether it has been possible to remove the element from the tree (e.g. it will
 	 * return false if the value does not exist)
 	 */
-	bool deleteNode(const T& key, std::stack<Node<T>*>* stackTree);
+	bool deleteNode(const T& key, NodePath<T>* path);
+
+	/**
+	 * Get the cached size of a subtree
+	 * @param[in] node Root of the subtree
+	 * @return Number of nodes of the subtree (0 for an empty one)
+	 */
+	static size_t subtreeSize(Node<T>* node);
+	/**
+	 * Set the cached size of a subtree. Ignored if the nodes do not keep a size
+	 * @param[in] node Root of the subtree
+	 * @param[in] size Number of nodes of the subtree
+	 */
+	static void setSize(Node<T>* node, size_t size);
+	/**
+	 * Count the keys below (or up to) a given one, going down a single path
+	 * @param[in] key Key to compare with
+	 * @param[in] inclusive Whether keys equal to the given one are counted
+	 * @return Number of keys lower than (or not higher than) the key
+	 */
+	size_t countBelow(const T& key, bool inclusive) const;
+
+	/**
+	 * Set a new child in the place of an existing one
+	 * @param[in|out] parent Parent node of the existing child (nullptr if the child
+	 * is the root node)
+	 * @param[in] oldChild Existing child
+	 * @param[in] newChild Node to set in the place of the existing child
+	 */
+	void replaceChild(Node<T>* parent, Node<T>* oldChild, Node<T>* newChild);
+
+	/**
+	 * Destroy a node which has been unlinked from the tree. It is returned to the
+	 * node pool, or deleted if it was allocated by the caller
+	 * @param[in] node Node to destroy (its children are not destroyed)
+	 */
+	void destroyNode(Node<T>* node);
+
+	/**
+	 * Build a subtree of minimum height with the next keys of a sorted range
+	 * @param[in|out] it Next key of the range (it is advanced past the keys used,
+	 * skipping repeated ones)
+	 * @param[in] last End of the range
+	 * @param[in] n Number of (different) keys to take from the range
+	 * @return Returns the root of the subtree
+	 */
+	template<typename ForwardIt>
+	Node<T>* buildSubtree(ForwardIt& it, ForwardIt last, size_t n);
+	/**
+	 * Get the key of an element of a range given to buildSubtree
+	 * @param[in] element Key, (key, value) pair or node of the tree (see rebuild)
+	 * @return Key of the element
+	 */
+	static const T& keyOf(const T& element);
+	template<typename K, typename U>
+	static const K& keyOf(const std::pair<K, U>& element);
+	static const T& keyOf(Node<T>* element);
+	/**
+	 * Get the node for an element of a range given to buildSubtree: keys and
+	 * (key, value) pairs are copied into a new node of the node pool, and nodes of
+	 * the tree are taken as they are
+	 * @param[in] element Key, (key, value) pair or node of the tree
+	 * @return Node for the element
+	 */
+	Node<T>* createNode(const T& element);
+	template<typename K, typename U>
+	Node<T>* createNode(const std::pair<K, U>& element);
+	static Node<T>* createNode(Node<T>* element);
+	/**
+	 * Sizes of the subtrees forked by a parallel walk, as a tree with the same
+	 * shape as the forked part
+	 */
+	struct SubtreeSizes {
+		size_t size;
+		std::vector<SubtreeSizes> children;
+	};
+	/**
+	 * Get the number of levels to fork for a parallel walk
+	 * @param[in] requested Levels requested by the caller (negative for the
+	 * default)
+	 * @param[in] pool Pool which runs the tasks
+	 * @return Levels to fork
+	 */
+	static int forkLevels(int requested, const WorkStealingPool& pool);
+	/**
+	 * Call a function for the keys of a subtree in an in-order order, walking it
+	 * with an explicit stack
+	 * @param[in] node Root of the subtree
+	 * @param[in] function Function called with each key
+	 */
+	template<typename F>
+	static void forEachInorder(Node<T>* node, F& function);
+	/**
+	 * Walk a subtree keeping the path from its root to the current node in an
+	 * explicit stack, so that the subtree is only read and the depth of each node
+	 * is the size of the path
+	 * @param[in] node Root of the subtree
+	 * @param[in] preorder Whether nodes are visited before their first subtree
+	 * (pre-order) or after it (in-order)
+	 * @param[in] mirrored Whether the right subtree goes first
+	 * @param[in] visit Function called with each node and its depth (1 for the
+	 * root of the subtree)
+	 */
+	template<typename F>
+	static void walkNodes(Node<T>* node, bool preorder, bool mirrored, F visit);
+	/**
+	 * Call a function for the keys of a subtree, forking the subtrees of the
+	 * first levels
+	 * @param[in] node Root of the subtree
+	 * @param[in] function Function called with each key
+	 * @param[in] depth Levels left to fork
+	 * @param[in] pool Pool which runs the tasks
+	 */
+	template<typename F>
+	void forEachTask(Node<T>* node, F& function, int depth,
+			WorkStealingPool& pool) const;
+	/**
+	 * Aggregate the keys of a subtree, forking the subtrees of the first levels
+	 * @param[in] node Root of the subtree
+	 * @param[in] identity Result for an empty subtree
+	 * @param[in] map Function which gets the result for a key
+	 * @param[in] combine Function which combines two results
+	 * @param[in] depth Levels left to fork
+	 * @param[in] pool Pool which runs the tasks
+	 * @return Combination of the results of the keys of the subtree
+	 */
+	template<typename R, typename Map, typename Combine>
+	R reduceTask(Node<T>* node, const R& identity, Map& map, Combine& combine,
+			int depth, WorkStealingPool& pool) const;
+	/**
+	 * Count the keys of a subtree, forking the subtrees of the first levels
+	 * @param[in] node Root of the subtree
+	 * @param[out] sizes Sizes of the subtree and of its forked subtrees
+	 * @param[in] depth Levels left to fork
+	 * @param[in] pool Pool which runs the tasks
+	 */
+	void countTask(Node<T>* node, SubtreeSizes& sizes, int depth,
+			WorkStealingPool& pool) const;
+	/**
+	 * Copy the keys of a subtree in an in-order order, forking the subtrees of the
+	 * first levels
+	 * @param[in] node Root of the subtree
+	 * @param[in] sizes Sizes counted by countTask
+	 * @param[out] out Part of the buffer for the subtree
+	 * @param[in] depth Levels left to fork
+	 * @param[in] pool Pool which runs the tasks
+	 */
+	void exportTask(Node<T>* node, const SubtreeSizes& sizes, T* out, int depth,
+			WorkStealingPool& pool) const;
 private:
+	/**
+	 * Pool where the nodes created by the tree are allocated
+	 */
+	NodePool<N> pool;
+	/**
+	 * Nodes in the tree allocated by the caller instead of the pool
+	 */
+	std::unordered_set<Node<T>*> adopted;
+	/**
+	 * Whether the size of every subtree is kept in its root
+	 */
+	bool orderStatistics;
+
 	/**
 	 * Search the node with the minimum value
 	 * @param[in] rootNode Node where to start the search from
@@ -168,9 +731,282 @@ private:
 	 * nullptr in case the rootnode is nullptr)
 	 */
 	Node<T>* minNode(Node<T>* rootNode) const;
+	/**
+	 * Insert a key in a new node of the node pool, unless it already exists
+	 * @param[out] found Nodes from the root to the node with the key (included),
+	 * or empty if the tree has been rotated after linking a new node. In case it
+	 * is null, this parameter will be ignored
+	 * @param[in] key Key to copy (or move) into the node
+	 * @param[in] args Value of the node, if any
+	 * @return Returns the node with the key, and whether it has been inserted
+	 */
+	template<typename Key, typename ... Args>
+	std::pair<Node<T>*, bool> insertKey(NodePath<T>* found, Key&& key,
+			Args&&... args);
+	/**
+	 * Look for the place of a key, keeping the path followed
+	 * @param[in] key Key to find
+	 * @param[out] path Nodes from the root to the parent of the place of the key
+	 * (or of the node with the key, if it is found)
+	 * @return Returns the node with the key, or nullptr if the key is missing
+	 */
+	Node<T>* findPlace(const T& key, NodePath<T>& path) const;
+	/**
+	 * Link a new node in the empty place found by findPlace, updating the sizes
+	 * along the path and balancing the tree
+	 * @param[in] node Node to link
+	 * @param[in|out] path Path returned by findPlace (it is cleared)
+	 */
+	void linkNode(Node<T>* node, NodePath<T>& path);
+	/**
+	 * Verifies whether a path still goes from the root down to its last node, i.e.
+	 * whether no rotation has changed it
+	 * @param[in] path Path to check
+	 * @return Returns true if every node of the path is a child of the previous one
+	 */
+	bool isPath(const NodePath<T>& path) const;
 
 };
 
+template<typename T, typename N>
+template<typename KeyArg, typename ValueArg>
+bool BinarySearchTree<T, N>::insert(KeyArg&& key, ValueArg&& value) {
+	static_assert(N::HAS_VALUE, "Only the nodes of type ExtendedNode keep a value");
+	if constexpr (std::is_same<typename std::decay<KeyArg>::type, T>::value)
+		return insertKey(nullptr, std::forward<KeyArg>(key),
+				std::forward<ValueArg>(value)).second;
+	else
+		return insertKey(nullptr, T(std::forward<KeyArg>(key)),
+				std::forward<ValueArg>(value)).second;
+}
+
+template<typename T, typename N>
+template<typename ... Args>
+std::pair<typename BinarySearchTree<T, N>::const_iterator, bool> BinarySearchTree<T, N>::emplace(
+		Args&&... args) {
+	// The iterator takes the path followed by the insertion, so the tree is only
+	// searched again if a new node has been rotated
+	const_iterator it(this);
+	std::pair<Node<T>*, bool> result;
+	if constexpr ((sizeof...(Args) == 1)
+			&& (std::is_same<typename std::decay<Args>::type, T>::value && ...))
+		result = insertKey(&(it.path), std::forward<Args>(args)...);
+	else
+		result = insertKey(&(it.path), T(std::forward<Args>(args)...));
+	if (it.path.empty())
+		it = lower_bound(result.first->key);
+	return std::make_pair(it, result.second);
+}
+
+template<typename T, typename N>
+template<typename ForwardIt>
+void BinarySearchTree<T, N>::buildFromSorted(ForwardIt first, ForwardIt last) {
+	clear();
+	// Count different keys, so that the shape of the tree is known beforehand
+	size_t n = 0;
+	for (ForwardIt it = first; it != last; ++n) {
+		ForwardIt previous = it;
+		while ((++it != last) && !(keyOf(*previous) < keyOf(*it)))
+			;
+	}
+	if (n == 0)
+		return;
+	pool.reserve(n);
+	this->root = buildSubtree(first, last, n);
+	resetBalance();
+}
+
+template<typename T, typename N>
+template<typename InputIt>
+void BinarySearchTree<T, N>::buildFromUnsorted(InputIt first, InputIt last,
+		unsigned int threads) {
+	std::vector<T> keys(first, last);
+	parallelSort(keys.begin(), keys.end(), threads);
+	buildFromSorted(keys.begin(), keys.end());
+}
+
+template<typename T, typename N>
+template<typename InputIt>
+size_t BinarySearchTree<T, N>::insertBatch(InputIt first, InputIt last,
+		unsigned int threads) {
+	std::vector<T> keys(first, last);
+	parallelSort(keys.begin(), keys.end(), threads);
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	return insertSorted(keys);
+}
+
+template<typename T, typename N>
+template<typename ForwardIt>
+Node<T>* BinarySearchTree<T, N>::buildSubtree(ForwardIt& it, ForwardIt last,
+		size_t n) {
+	if (n == 0)
+		return nullptr;
+	// Nodes are created in an in-order order: left subtree, node, right subtree.
+	// Both subtrees differ at most in one node, so their heights differ at most
+	// in one level
+	size_t nLeft = (n - 1) / 2;
+	Node<T>* left = buildSubtree(it, last, nLeft);
+	Node<T>* node = createNode(*it);
+	ForwardIt previous = it;
+	while ((++it != last) && !(keyOf(*previous) < keyOf(*it)))
+		;
+	Node<T>* right = buildSubtree(it, last, n - 1 - nLeft);
+	node->left = left;
+	node->right = right;
+	setSize(node, n);
+	if constexpr (N::HAS_HEIGHT)
+		static_cast<N*>(node)->height = 1 + std::max(
+				left == nullptr ? 0 : static_cast<N*>(left)->height,
+				right == nullptr ? 0 : static_cast<N*>(right)->height);
+	return node;
+}
+
+template<typename T, typename N>
+template<typename K, typename U>
+const K& BinarySearchTree<T, N>::keyOf(const std::pair<K, U>& element) {
+	return element.first;
+}
+
+template<typename T, typename N>
+template<typename K, typename U>
+Node<T>* BinarySearchTree<T, N>::createNode(const std::pair<K, U>& element) {
+	static_assert(N::HAS_VALUE, "Only the nodes of type ExtendedNode keep a value");
+	return pool.create(element.first, element.second);
+}
+
+template<typename T, typename N>
+template<typename Key, typename ... Args>
+std::pair<Node<T>*, bool> BinarySearchTree<T, N>::insertKey(NodePath<T>* found,
+		Key&& key, Args&&... args) {
+	NodePath<T> place;
+	NodePath<T>& path = (found != nullptr) ? *found : place;
+	Node<T>* existing = findPlace(key, path);
+	if (existing != nullptr) {
+		path.push(existing);
+		return std::make_pair(existing, false);
+	}
+	Node<T>* node = pool.create(std::forward<Key>(key),
+			std::forward<Args>(args)...);
+	if (found == nullptr) {
+		linkNode(node, path);
+		return std::make_pair(node, true);
+	}
+	// Linking the node clears the path (and balancing may rotate it)
+	place = path;
+	linkNode(node, place);
+	path.push(node);
+	if (!isPath(path))
+		path.clear();
+	return std::make_pair(node, true);
+}
+
+template<typename T, typename N>
+template<typename F>
+void BinarySearchTree<T, N>::parallelForEach(F function, WorkStealingPool& pool,
+		int forkDepth) const {
+	forEachTask(this->root, function, forkLevels(forkDepth, pool), pool);
+}
+
+template<typename T, typename N>
+template<typename R, typename Map, typename Combine>
+R BinarySearchTree<T, N>::parallelReduce(R identity, Map map, Combine combine,
+		WorkStealingPool& pool, int forkDepth) const {
+	return reduceTask(this->root, identity, map, combine,
+			forkLevels(forkDepth, pool), pool);
+}
+
+template<typename T, typename N>
+template<typename F>
+void BinarySearchTree<T, N>::forEachInorder(Node<T>* node, F& function) {
+	NodePath<T> pending;
+	while ((node != nullptr) || !pending.empty()) {
+		for (; node != nullptr; node = node->left)
+			pending.push(node);
+		node = pending.top();
+		pending.pop();
+		function(node->key);
+		node = node->right;
+	}
+}
+
+template<typename T, typename N>
+template<typename F>
+void BinarySearchTree<T, N>::walkNodes(Node<T>* node, bool preorder,
+		bool mirrored, F visit) {
+	Node<T>* Node<T>::*first = mirrored ? &Node<T>::right : &Node<T>::left;
+	Node<T>* Node<T>::*second = mirrored ? &Node<T>::left : &Node<T>::right;
+	// The node visited before the current one tells where the walk comes from: its
+	// parent (going down), its first child or its second child
+	NodePath<T> path;
+	if (node != nullptr)
+		path.push(node);
+	Node<T>* previous = nullptr;
+	while (!path.empty()) {
+		Node<T>* current = path.top();
+		bool down = (previous == nullptr) || (previous->*first == current)
+				|| (previous->*second == current);
+		if (down && preorder)
+			visit(current, path.size());
+		if (down && (current->*first != nullptr))
+			path.push(current->*first);
+		else if (down || (previous == current->*first)) {
+			if (!preorder)
+				visit(current, path.size());
+			if (current->*second != nullptr)
+				path.push(current->*second);
+			else
+				path.pop();
+		} else
+			path.pop();
+		previous = current;
+	}
+}
+
+template<typename T, typename N>
+template<typename F>
+void BinarySearchTree<T, N>::forEachTask(Node<T>* node, F& function, int depth,
+		WorkStealingPool& pool) const {
+	if ((depth <= 0) || (node == nullptr)) {
+		forEachInorder(node, function);
+		return;
+	}
+	// The left subtree is forked and the right one is walked by this thread
+	TaskGroup group;
+	pool.submit(group, [&]() {
+		forEachTask(node->left, function, depth - 1, pool);
+	});
+	pool.runAndWait(group, [&]() {
+		function(node->key);
+		forEachTask(node->right, function, depth - 1, pool);
+	});
+}
+
+template<typename T, typename N>
+template<typename R, typename Map, typename Combine>
+R BinarySearchTree<T, N>::reduceTask(Node<T>* node, const R& identity, Map& map,
+		Combine& combine, int depth, WorkStealingPool& pool) const {
+	if ((depth <= 0) || (node == nullptr)) {
+		R result = identity;
+		auto accumulate = [&](const T& key) {
+			result = combine(result, map(key));
+		};
+		forEachInorder(node, accumulate);
+		return result;
+	}
+	TaskGroup group;
+	R left = identity;
+	pool.submit(group, [&]() {
+		left = reduceTask(node->left, identity, map, combine, depth - 1, pool);
+	});
+	R middle = identity;
+	R right = identity;
+	pool.runAndWait(group, [&]() {
+		middle = map(node->key);
+		right = reduceTask(node->right, identity, map, combine, depth - 1, pool);
+	});
+	return combine(combine(left, middle), right);
+}
+
 } /* namespace tree */
 
 #endif /* SRC_TREE_BINARYSEARCHTREE_H_ */
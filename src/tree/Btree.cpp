@@ -7,393 +7,596 @@
 #include "Btree.h"
 
 #include <algorithm>
+#include <type_traits>
+#include <vector>
 
 namespace tree {
 
-template<typename T>
-Btree<T>::Btree(unsigned short d) :
-		d(d), root(nullptr) {
+template<typename K, typename V, typename Compare, unsigned short Degree>
+Btree<K, V, Compare, Degree>::Btree(std::pmr::memory_resource* resource,
+		const Compare& compare) :
+		root(nullptr), pool(resource), compare(compare) {
 
 }
 
-template<typename T>
-Btree<T>::~Btree() {
+template<typename K, typename V, typename Compare, unsigned short Degree>
+Btree<K, V, Compare, Degree>::~Btree() {
+	clear();
 }
 
-template<typename T>
-BNode<T>* Btree<T>::search(const T& key) {
-	BNode<T>* parent = nullptr;
-	return search(key, &parent);
+template<typename K, typename V, typename Compare, unsigned short Degree>
+void Btree<K, V, Compare, Degree>::clear() {
+	// Nodes only need to be destroyed one by one if their keys or values do. In
+	// any case, node memory goes back to the memory resource slab by slab
+	if (!std::is_trivially_destructible<K>::value
+			|| !std::is_trivially_destructible<V>::value) {
+		std::vector<NodeType*> pending;
+		if (this->root != nullptr)
+			pending.push_back(this->root);
+		while (!pending.empty()) {
+			NodeType* node = pending.back();
+			pending.pop_back();
+			if (!node->leaf)
+				pending.insert(pending.end(), node->children,
+						node->children + node->count + 1);
+			destroyNode(node);
+		}
+	}
+	this->root = nullptr;
+	pool.release();
 }
 
-template<typename T>
-BNode<T>* Btree<T>::search(const T& key, BNode<T>** parent) {
+template<typename K, typename V, typename Compare, unsigned short Degree>
+typename Btree<K, V, Compare, Degree>::NodeType* Btree<K, V, Compare, Degree>::createNode(bool leaf) {
+	return pool.create(leaf);
+}
 
-	// Start in the root node
-	BNode<T>* node = this->root;
-	unsigned short nkeys;
+template<typename K, typename V, typename Compare, unsigned short Degree>
+void Btree<K, V, Compare, Degree>::destroyNode(NodeType* node) {
+	pool.destroy(node);
+}
 
-	while (true) {
-		if (node == nullptr) {
-			*parent = nullptr;
-			return nullptr;
-		}
-		nkeys = node->keys.size();
-		unsigned short nkey = 0;
-		// Look until the key in the current node is higher or equal than the
-		// existing key or the last key was reached
-		while ((nkey < nkeys) && (node->keys.at(nkey) < key))
-			++nkey;
-
-		// The key was found
-		if ((nkey < nkeys) && (node->keys.at(nkey) == nkeys))
-			return node;
-
-		// The key was not found:
-		// 1. The key at nkey is higher than the searched key => take left child
-		// 2. The key is higher than any key in the current node => take the right
-		//     child (nkey is already nkeys + 1 => it points to the right child)
-		*parent = node;
-		node = node->children.at(nkey);
-	}
+template<typename K, typename V, typename Compare, unsigned short Degree>
+typename Btree<K, V, Compare, Degree>::NodeType* Btree<K, V, Compare, Degree>::search(
+		const K& key) {
+	return findNode(key);
 }
 
-template<typename T>
-void Btree<T>::getInorder(std::list<T>& orderedList) const {
+template<typename K, typename V, typename Compare, unsigned short Degree>
+bool Btree<K, V, Compare, Degree>::contains(const K& key) const {
+	return findNode(key) != nullptr;
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+void Btree<K, V, Compare, Degree>::getInorder(std::list<K>& orderedList) const {
 	return getInorder(this->root, orderedList);
 }
 
-template<typename T>
-void Btree<T>::getInorder(BNode<T>* root, std::list<T>& orderedList) const {
+template<typename K, typename V, typename Compare, unsigned short Degree>
+void Btree<K, V, Compare, Degree>::getInorder(NodeType* root,
+		std::list<K>& orderedList) const {
 	if (root == nullptr)
 		return;
-	unsigned int i = 0;
-	for (; i < root->keys.size(); ++i) {
-		getInorder(root->children.at(i), orderedList);
-		orderedList.push_back(root->keys.at(i));
+	size_t i = 0;
+	for (; i < root->count; ++i) {
+		if (!root->leaf)
+			getInorder(root->children[i], orderedList);
+		orderedList.push_back(root->keys[i]);
 	}
-	getInOrder(root->keys.at(i), orderedList);
+	if (!root->leaf)
+		getInorder(root->children[i], orderedList);
 }
 
-template<typename T>
-void Btree<T>::getPreorder(std::list<T>& orderedList) const {
+template<typename K, typename V, typename Compare, unsigned short Degree>
+void Btree<K, V, Compare, Degree>::getPreorder(std::list<K>& orderedList) const {
 	return getPreorder(this->root, orderedList);
 }
 
-template<typename T>
-void Btree<T>::getPreorder(BNode<T>* root, std::list<T>& orderedList) const {
+template<typename K, typename V, typename Compare, unsigned short Degree>
+void Btree<K, V, Compare, Degree>::getPreorder(NodeType* root,
+		std::list<K>& orderedList) const {
 	if (root == nullptr)
 		return;
-	for (T key : root->keys)
-		orderedList.push_back(key);
-	for (BNode<T>* child : root->children)
-		getPreorder(child, orderedList);
+	orderedList.insert(orderedList.end(), root->keys, root->keys + root->count);
+	if (!root->leaf)
+		for (size_t i = 0; i <= root->count; ++i)
+			getPreorder(root->children[i], orderedList);
 }
 
-template<typename T>
-void Btree<T>::getPostorder(std::list<T>& orderedList) const {
+template<typename K, typename V, typename Compare, unsigned short Degree>
+void Btree<K, V, Compare, Degree>::getPostorder(std::list<K>& orderedList) const {
 	return getPostorder(this->root, orderedList);
 }
 
-template<typename T>
-void Btree<T>::getPostorder(BNode<T>* root, std::list<T>& orderedList) const {
+template<typename K, typename V, typename Compare, unsigned short Degree>
+void Btree<K, V, Compare, Degree>::getPostorder(NodeType* root,
+		std::list<K>& orderedList) const {
 	if (root == nullptr)
 		return;
-	for (BNode<T>* child : root->children)
-		getPostorder(child, orderedList);
-	for (T key : root->keys)
-		orderedList.push_back(key);
+	if (!root->leaf)
+		for (size_t i = 0; i <= root->count; ++i)
+			getPostorder(root->children[i], orderedList);
+	orderedList.insert(orderedList.end(), root->keys, root->keys + root->count);
 }
 
-template<typename T>
-bool Btree<T>::isLeaf(BNode<T>* node) {
-	if (node == nullptr)
-		return true;
-	// Theoretically, if the first child is null the rest should be
-	// null as well => the check of first child should be enough
-	for (BNode<T>* child : node->children) {
-		if (child != nullptr)
-			return false;
+template<typename K, typename V, typename Compare, unsigned short Degree>
+void Btree<K, V, Compare, Degree>::parallelExport(std::vector<K>& buffer,
+		WorkStealingPool& pool, int forkDepth) const {
+	int depth = forkLevels(forkDepth, pool);
+	SubtreeSizes sizes;
+	countTask(this->root, sizes, depth, pool);
+	buffer.resize(sizes.size);
+	exportTask(this->root, sizes, buffer.data(), depth, pool);
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+int Btree<K, V, Compare, Degree>::forkLevels(int requested, const WorkStealingPool& pool) {
+	if (requested >= 0)
+		return requested;
+	// Two levels give from dozens to thousands of subtrees (depending on the
+	// degree and on how full nodes are), so that stealing evens them out
+	return (pool.size() <= 1) ? 0 : 2;
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+void Btree<K, V, Compare, Degree>::countTask(NodeType* node, SubtreeSizes& sizes,
+		int depth, WorkStealingPool& pool) const {
+	if ((depth <= 0) || (node == nullptr) || node->leaf) {
+		size_t count = 0;
+		auto increment = [&count](const K&) {
+			++count;
+		};
+		forEachInorder(node, increment);
+		sizes.size = count;
+		return;
 	}
-	return true;
+	sizes.children.resize(node->count + 1);
+	TaskGroup group;
+	for (size_t i = 0; i < node->count; ++i) {
+		NodeType* child = node->children[i];
+		SubtreeSizes* childSizes = &(sizes.children[i]);
+		pool.submit(group, [&, child, childSizes]() {
+			countTask(child, *childSizes, depth - 1, pool);
+		});
+	}
+	countTask(node->children[node->count], sizes.children[node->count],
+			depth - 1, pool);
+	pool.wait(group);
+	sizes.size = node->count;
+	for (const SubtreeSizes& child : sizes.children)
+		sizes.size += child.size;
 }
 
-template<typename T>
-bool Btree<T>::insert(T& key, T& value) {
-	if (search(key))
-		return false;
+template<typename K, typename V, typename Compare, unsigned short Degree>
+void Btree<K, V, Compare, Degree>::exportTask(NodeType* node, const SubtreeSizes& sizes,
+		K* out, int depth, WorkStealingPool& pool) const {
+	if ((depth <= 0) || (node == nullptr) || node->leaf) {
+		auto copy = [&out](const K& key) {
+			*(out++) = key;
+		};
+		forEachInorder(node, copy);
+		return;
+	}
+	// Each child fills its own part of the buffer, followed by the key after it
+	TaskGroup group;
+	for (size_t i = 0; i < node->count; ++i) {
+		NodeType* child = node->children[i];
+		const SubtreeSizes* childSizes = &(sizes.children[i]);
+		pool.submit(group, [&, child, childSizes, out]() {
+			exportTask(child, *childSizes, out, depth - 1, pool);
+		});
+		out += childSizes->size;
+		*(out++) = node->keys[i];
+	}
+	exportTask(node->children[node->count], sizes.children[node->count], out,
+			depth - 1, pool);
+	pool.wait(group);
+}
 
-	return insertElement(key, value, this->root, nullptr);
+template<typename K, typename V, typename Compare, unsigned short Degree>
+typename Btree<K, V, Compare, Degree>::const_iterator Btree<K, V, Compare, Degree>::begin() const {
+	const_iterator it(this);
+	it.descendLeft(this->root);
+	return it;
 }
 
-template<typename T>
-void Btree<T>::initNode(BNode<T>** node, T& key, T& value) {
-	*node = new BNode<T>();
-	(*node)->keys.push_back(key);
-	(*node)->values.push_back(value);
-	(*node)->children = std::vector<T>();
-	(*node)->children.insert(2 * d - 1, nullptr);
+template<typename K, typename V, typename Compare, unsigned short Degree>
+typename Btree<K, V, Compare, Degree>::const_iterator Btree<K, V, Compare, Degree>::end() const {
+	return const_iterator(this);
 }
 
-template<typename T>
-void Btree<T>::insertInNoFullNode(T key, T value, BNode<T>** node) {
-	(*node)->keys.insert(
-			std::upper_bound((*node)->keys.begin(), (*node)->keys.end(), key),
-			key);
-	(*node)->values.insert(
-			std::upper_bound((*node)->values.begin(), (*node)->values.end(),
-					value), value);
+template<typename K, typename V, typename Compare, unsigned short Degree>
+typename Btree<K, V, Compare, Degree>::const_iterator Btree<K, V, Compare, Degree>::lower_bound(
+		const K& key) const {
+	return lowerBound(key);
 }
 
-template<typename T>
-size_t Btree<T>::getPositionInNode(BNode<T>* node, T& key) const {
-	size_t i = 0;
-	for (; i < node->keys.size() && node->keys.at(i) != key; ++i)
-		;
-	return i;
+template<typename K, typename V, typename Compare, unsigned short Degree>
+typename Btree<K, V, Compare, Degree>::const_iterator Btree<K, V, Compare, Degree>::upper_bound(
+		const K& key) const {
+	return upperBound(key);
 }
 
-template<typename T>
-void Btree<T>::splitNode(BNode<T>** originalAndLeftNode, BNode<T>** right, T& midKey, T& midValue) {
-	// Get the mid value
-	midKey = (*originalAndLeftNode)->keys.at(d);
-	midValue = (*originalAndLeftNode)->values.at(d);
-	// Get the right side
-	(*right) = new BNode<T>();
-	(*right)->keys.insert((*right)->keys.begin(),
-			(*originalAndLeftNode)->keys.begin() + d - 1, (*originalAndLeftNode)->keys.end());
-	(*right)->values.insert((*right)->values.begin(),
-			(*originalAndLeftNode)->values.begin() + d - 1, (*originalAndLeftNode)->values.end());
-	(*right)->children.insert((*right)->values.begin(),
-			(*originalAndLeftNode)->children.begin() + d - 1, (*originalAndLeftNode)->children.end());
-	// Consider the left side as the original node minus the right side
-	(*originalAndLeftNode)->keys.erase((*originalAndLeftNode)->keys.begin() + d);
-	(*originalAndLeftNode)->values.erase((*originalAndLeftNode)->values.begin() + d);
-	(*originalAndLeftNode)->children.erase((*originalAndLeftNode)->children.begin() + d);
+template<typename K, typename V, typename Compare, unsigned short Degree>
+std::pair<typename Btree<K, V, Compare, Degree>::const_iterator,
+		typename Btree<K, V, Compare, Degree>::const_iterator> Btree<K, V,
+		Compare, Degree>::equal_range(const K& key) const {
+	return std::make_pair(lowerBound(key), upperBound(key));
 }
 
-template<typename T>
-bool Btree<T>::insertElement(T& key, T& value, BNode<T>** node,
-		BNode<T>** parent) {
+template<typename K, typename V, typename Compare, unsigned short Degree>
+bool Btree<K, V, Compare, Degree>::isLeaf(NodeType* node) const {
+	return (node == nullptr) || node->leaf;
+}
 
+template<typename K, typename V, typename Compare, unsigned short Degree>
+void Btree<K, V, Compare, Degree>::insertNew(K&& key, V&& value) {
 	// 1. The root node is null => create the root node
-	if (*node == nullptr) {
-		initNode(&node, key, value);
-		return true;
+	if (this->root == nullptr) {
+		initNode(&(this->root), std::move(key), std::move(value));
+		return;
 	}
 
-	// 2. The root node has enough space
-	if ((*node)->keys.size() < 2 * d - 1) {
-		if (isLeaf(*node)) { // 2.1 The node is a leaf node => add the key in a sorted way
-			insertInNoFullNode(key, value, node);
-			return true;
-		} else { // 2.2 The node is not a leaf node => insert it in the right child
-			size_t child_pos = getPositionInNode(*node, key);
-			return insertElement(key, value, (*node)->children.at(child_pos),
-					node);
-		}
+	// 2. The root node is full => split it before going down, so that the tree
+	//    grows from the top and every node we go through has room for one more key
+	if (this->root->count == NodeType::MAX_KEYS) {
+		NodeType* newRoot = createNode(false);
+		NodeType* right = nullptr;
+		newRoot->children[0] = this->root;
+		splitNode(&(this->root), &right, newRoot->keys[0], newRoot->values[0]);
+		newRoot->children[1] = right;
+		newRoot->count = 1;
+		this->root = newRoot;
 	}
 
-	// 3. There is not space in the current node
-	BNode<T>** right;
-	T midKey;
-	T midValue;
-
-	BNode<T>** tmpParent = parent;
-
-	while (true) {
-		// Split the node in 2 parts
-		splitNode(node, right, midKey, midValue);
-		// Insert the mid key in the parent
-		insertInNoFullNode(midKey, midValue, tmpParent);
-		// Renew children for parent node
-		size_t parentPos = getPositionInNode(*tmpParent, key);
-		(*tmpParent)->children.emplace((*tmpParent)->children.begin() + parentPos+1, key);
-		if ((*tmpParent)->keys.size() <= 2*d -1)
-			return true;
-		else {
-			node = tmpParent;
-			search(midKey, tmpParent);
-			if (*tmpParent == nullptr) {
-				this->root = *tmpParent;
-				return true;
-			}
-			// else continue
-		}
-	}
+	insertElement(std::move(key), std::move(value), &(this->root));
 }
 
-template<typename T>
-void Btree<T>::rotateAndKeepSibling(BNode<T>** sibling, BNode<T>** parent,
-		BNode<T>** target, size_t parentI, size_t posSibling) {
-	// Replace parent key/value with right/left key/value of sibling...
-	T& parentKey = (*parent)->keys.at(parentI);
-	T& parentValue = (*parent)->values.at(parentI);
-	std::replace((*parent)->keys.begin() + parentI,
-			(*parent)->keys.begin() + parentI + 1, parentKey,
-			(*sibling)->keys.at(posSibling));
-	std::replace((*parent)->values.begin() + parentI,
-			(*parent)->values.begin() + parentI + 1, parentValue,
-			(*sibling)->values.at(posSibling));
-
-	// ... and append original parent (to keep it in a sorted way, we have to check whether we have to set
-	//     it at the beginning or at the end of the vector)
-	size_t tmpPos = (posSibling == 0) ? (*target)->keys.size() : 0;
-	(*target)->keys.insert((*target)->keys.begin() + tmpPos,
-			(*target)->keys.begin() + tmpPos + 1, parentKey);
-	(*target)->value.insert((*target)->values.begin() + tmpPos,
-			(*target)->values.begin() + tmpPos + 1, parentValue);
-}
-
-template<typename T>
-bool Btree<T>::remove(T& key) {
-	BNode<T>* parent = nullptr;
-	BNode<T>* node = search(key, &parent);
-	if (node == nullptr)
-		return false;
-	return remove(key, &node, &parent);
+template<typename K, typename V, typename Compare, unsigned short Degree>
+void Btree<K, V, Compare, Degree>::initNode(NodeType** node, K&& key,
+		V&& value) {
+	*node = createNode(true);
+	(*node)->keys[0] = std::move(key);
+	(*node)->values[0] = std::move(value);
+	(*node)->count = 1;
 }
 
-template<typename T>
-void Btree<T>::mergeAndRemove(BNode<T>** sibling, BNode<T>** target,
-		BNode<T>** parent, size_t parentI) {
-	// Insert parent as an element of current node
-	(*target)->keys.insert((*target)->keys.end(), (*parent)->keys.at(parentI));
-	(*target)->values.insert((*target)->values.end(),
-			(*parent)->values.at(parentI));
-	// Insert sibling keys/values into current node
-	(*target)->keys.insert((*target)->keys.end(), (*sibling)->keys.begin(),
-			(*sibling)->keys.end());
-	(*target)->values.insert((*target)->values.end(),
-			(*sibling)->values.begin(), (*sibling)->values.end());
-	// Clear sibling keys/values
-	(*sibling)->keys.clear();
-	(*sibling)->values.clear();
-	// Remove parent node
-	(*parent)->keys.erase((*parent)->keys.begin() + parentI,
-			(*parent)->keys.begin() + parentI + 1);
-	(*parent)->values.erase((*parent)->values.begin() + parentI,
-			(*parent)->values.begin() + parentI + 1);
-	// Remove child for removed parent node
-	(*parent)->children.erase((*parent)->children.begin() + parentI,
-			(*parent)->children.end() + parentI + 1);
-}
-
-template<typename T>
-bool Btree<T>::remove(T& key, BNode<T>**node, BNode<T>**parent) {
-
-	// Look for key position of the parent node
-	size_t parentI = -1;
-	if (*parent != nullptr)
-		for (parentI = 0;
-				parentI < (*parent)->keys.size() - 1
-						&& (*parent)->keys.at(parentI) < key; ++parentI)
-			;
+template<typename K, typename V, typename Compare, unsigned short Degree>
+void Btree<K, V, Compare, Degree>::insertInNoFullNode(K&& key, V&& value,
+		NodeType** node) {
+	NodeType* n = *node;
+	size_t pos = getPositionInNode(n, key);
+	shiftRight(n->keys, pos, n->count);
+	shiftRight(n->values, pos, n->count);
+	n->keys[pos] = std::move(key);
+	n->values[pos] = std::move(value);
+	++n->count;
+}
 
-	// Get position of the key within the node
-	size_t posKey = 0;
-	for (; posKey < (*node)->keys.size() && (*node)->keys.at(posKey) != key;
-			++posKey)
-		;
-
-	// 1. The node is a leaf:
-	if (isLeaf(*node)) {
-		// 1.1 Number of keys in node >= d or it is the root node
-		if (((*node)->keys.size() >= d) || ((*parent) == nullptr)) {
-			// Simply remove the key from the node (it is a leaf node, therefore, there
-			// is no problem with children)
-			(*node)->keys.erase((*node)->keys.begin() + posKey,
-					(*node)->keys.begin() + posKey + 1);
-			(*node)->keys.erase((*node)->values.begin() + posKey,
-					(*node)->values.begin() + posKey + 1);
-			return true;
+template<typename K, typename V, typename Compare, unsigned short Degree>
+size_t Btree<K, V, Compare, Degree>::insertSorted(
+		std::vector<std::pair<K, V>>& items) {
+	size_t inserted = 0;
+	size_t next = 0;
+	while (next < items.size()) {
+		const K& key = items[next].first;
+		if (this->root->count == NodeType::MAX_KEYS) {
+			NodeType* newRoot = createNode(false);
+			NodeType* right = nullptr;
+			newRoot->children[0] = this->root;
+			splitNode(&(this->root), &right, newRoot->keys[0], newRoot->values[0]);
+			newRoot->children[1] = right;
+			newRoot->count = 1;
+			this->root = newRoot;
 		}
 
-		// 1.2 Number of keys in node == d-1
-		else {
-			// Find sibling nodes
-			BNode<T>* left = (*parent)->children(parentI);
-			BNode<T>* right = (*parent)->children.at(parentI + 1);
-
-			T& nodeKey = (*node)->keys.at(posKey); // == key
-			T& nodeValue = (*node)->values.at(posKey);
-			// Remove current key/value...
-			(*node)->keys.erase((*node)->keys.begin() + posKey,
-					(*node)->keys.begin() + posKey + 1);
-			(*node)->values.erase((*node)->values.begin() + posKey,
-					(*node)->values.begin() + posKey + 1);
-
-			//    1.2.1 Sibling nodes with >= d
-			if ((left->keys.size() >= d) || (right->keys.size() >= d)) {
-				size_t posSibling =
-						(left->keys.size() >= d) ? left->keys.size() - 1 : 0;
-				BNode<T>* sibling = (left->keys.size() >= d) ? left : right;
-
-				// Copy parent key/value to the node and sibling key/value to the parent
-				rotate(&sibling, parent, node, parentI, posSibling);
-				// ... remove sibling key/value
-				sibling->keys.erase(sibling->keys.begin() + posSibling,
-						sibling->keys.begin() + posSibling + 1);
-				sibling->values.erase(sibling->values.begin() + posSibling,
-						sibling->values.begin() + posSibling + 1);
-
-				return true;
+		// 1. Go down to the leaf of the key, splitting full children as in
+		//    insertElement, and keep the lowest key above the leaf which is higher
+		//    than it: the keys of the batch up to there go into the same leaf
+		NodeType* n = this->root;
+		const K* bound = nullptr;
+		bool found = false;
+		while (!n->leaf) {
+			size_t childPos = getPositionInNode(n, key);
+			if (isKeyAt(n, childPos, key)) {
+				found = true;
+				break;
+			}
+			NodeType* child = n->children[childPos];
+			if (child->count == NodeType::MAX_KEYS) {
+				shiftRight(n->keys, childPos, n->count);
+				shiftRight(n->values, childPos, n->count);
+				shiftRight(n->children, childPos + 1, n->count + 1);
+				NodeType* right = nullptr;
+				splitNode(&child, &right, n->keys[childPos], n->values[childPos]);
+				n->children[childPos + 1] = right;
+				++n->count;
+				// Look again at the node, as the mid key may be the key itself
+				continue;
 			}
-			//    1.2.2 Sibling nodes with <= d-1
+			if (childPos < n->count)
+				bound = &(n->keys[childPos]);
+			n = child;
+		}
+		if (found) {
+			++next;
+			continue;
+		}
+
+		// 2. Take the next keys of the batch which go into the leaf and fit in it
+		size_t room = NodeType::MAX_KEYS - n->count;
+		size_t last = next;
+		while ((last < items.size()) && (last - next < room)
+				&& ((bound == nullptr) || compare(items[last].first, *bound)))
+			++last;
+		// The keys which are already in the leaf are not inserted again
+		size_t repeated = 0;
+		for (size_t i = 0, j = next; (i < n->count) && (j < last);) {
+			if (compare(n->keys[i], items[j].first))
+				++i;
+			else if (compare(items[j].first, n->keys[i]))
+				++j;
 			else {
-				// Merge node with sibling:
-
-				// Verify whether current node is the top right child of the parent and get the sibling accordingly
-				bool isLastChild = ((*parent)->keys.at(parent) < key);
-				BNode<T>* sibling =
-						isLastChild ?
-								(*parent)->children.at(parentI) :
-								(*parent)->children.at(parentI + 1);
-				if (isLastChild)
-					std::swap(node, sibling);
-				mergeAndRemove(&sibling, node, parent, parentI);
-
-				return true;
+				++repeated;
+				++i;
+				++j;
+			}
+		}
+
+		// 3. Merge them from the back, so that every key of the leaf moves once
+		size_t i = n->count;
+		size_t j = last;
+		size_t out = n->count + (last - next) - repeated;
+		n->count = out;
+		while (j > next) {
+			const K& newKey = items[j - 1].first;
+			if ((i > 0) && compare(newKey, n->keys[i - 1])) {
+				--i;
+				--out;
+				n->keys[out] = std::move(n->keys[i]);
+				n->values[out] = std::move(n->values[i]);
+			} else if ((i > 0) && !compare(n->keys[i - 1], newKey)) {
+				--j;
+			} else {
+				--j;
+				--out;
+				n->keys[out] = std::move(items[j].first);
+				n->values[out] = std::move(items[j].second);
 			}
 		}
+		inserted += (last - next) - repeated;
+		next = last;
 	}
+	return inserted;
+}
 
-	// 2. The node is an internal node
-	//    2.1 Number of keys in left child node >= d
-	BNode<T>* left = (*node)->children(posKey);
-	BNode<T>* right = (*node)->children.at(posKey + 1);
-	if (left->keys.size() >= d) {
-		T lkey = left->keys.at(left->keys.size() - 1);
-		rotateAndKeepSibling(&left, node, &right, posKey,
-				left->keys.size() - 1);
-		return remove(lkey, &left, node);
+template<typename K, typename V, typename Compare, unsigned short Degree>
+void Btree<K, V, Compare, Degree>::splitNode(NodeType** originalAndLeftNode,
+		NodeType** right, K& midKey, V& midValue) {
+	NodeType* left = *originalAndLeftNode;
+	// Get the mid value (the node is full => it has 2*d-1 keys)
+	midKey = std::move(left->keys[Degree - 1]);
+	midValue = std::move(left->values[Degree - 1]);
+	// Get the right side
+	(*right) = createNode(left->leaf);
+	std::move(left->keys + Degree, left->keys + NodeType::MAX_KEYS,
+			(*right)->keys);
+	std::move(left->values + Degree, left->values + NodeType::MAX_KEYS,
+			(*right)->values);
+	if (!left->leaf)
+		std::copy(left->children + Degree,
+				left->children + NodeType::MAX_KEYS + 1, (*right)->children);
+	(*right)->count = Degree - 1;
+	// Consider the left side as the original node minus the right side
+	left->count = Degree - 1;
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+bool Btree<K, V, Compare, Degree>::insertElement(K&& key, V&& value,
+		NodeType** node) {
+
+	// The current node is never full here: every full child is split before
+	// going down into it
+	NodeType* n = *node;
+	while (!n->leaf) {
+		size_t childPos = getPositionInNode(n, key);
+		NodeType* child = n->children[childPos];
+		if (child->count == NodeType::MAX_KEYS) {
+			// Make room in the current node for the mid key and the new child
+			shiftRight(n->keys, childPos, n->count);
+			shiftRight(n->values, childPos, n->count);
+			shiftRight(n->children, childPos + 1, n->count + 1);
+			NodeType* right = nullptr;
+			splitNode(&child, &right, n->keys[childPos], n->values[childPos]);
+			n->children[childPos + 1] = right;
+			++n->count;
+			if (compare(n->keys[childPos], key))
+				child = right;
+		}
+		n = child;
 	}
-	//    2.2 Number of keys in right child node >= d
-	else if (right->keys.size() >= d) {
-		T rkey = left->keys.at(0);
-		rotateAndKeepSibling(&right, node, &left, posKey, 0);
-		return remove(rkey, &right, node);
+	insertInNoFullNode(std::move(key), std::move(value), &n);
+	return true;
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+void Btree<K, V, Compare, Degree>::rotateAndKeepSibling(NodeType** sibling,
+		NodeType** parent, NodeType** target, size_t parentI,
+		size_t posSibling) {
+	// The parent key/value goes down to the target and the sibling key/value
+	// at posSibling goes up to the parent. To keep the target sorted, the parent
+	// key goes at the beginning if the sibling is the left one or at the end if
+	// the sibling is the right one. The child next to the moved key changes its
+	// parent as well
+	NodeType* s = *sibling;
+	NodeType* p = *parent;
+	NodeType* t = *target;
+	if (posSibling != 0) { // Left sibling => posSibling is its last key
+		shiftRight(t->keys, 0, t->count);
+		shiftRight(t->values, 0, t->count);
+		t->keys[0] = std::move(p->keys[parentI]);
+		t->values[0] = std::move(p->values[parentI]);
+		if (!s->leaf) {
+			shiftRight(t->children, 0, t->count + 1);
+			t->children[0] = s->children[s->count];
+		}
+		p->keys[parentI] = std::move(s->keys[posSibling]);
+		p->values[parentI] = std::move(s->values[posSibling]);
+	} else { // Right sibling => posSibling is its first key
+		t->keys[t->count] = std::move(p->keys[parentI]);
+		t->values[t->count] = std::move(p->values[parentI]);
+		if (!s->leaf) {
+			t->children[t->count + 1] = s->children[0];
+			shiftLeft(s->children, 0, s->count + 1);
+		}
+		p->keys[parentI] = std::move(s->keys[0]);
+		p->values[parentI] = std::move(s->values[0]);
+		shiftLeft(s->keys, 0, s->count);
+		shiftLeft(s->values, 0, s->count);
 	}
-	//    2.3 Number of keys in left and right children == d-1
-	else {
-		if ((*node)->keys.size() == d - 1) {
-			BNode<T>* tmp = right;
-			BNode<T>* tmpParent = node;
-			// Look for the minimum value on the right
-			while (!isLeaf(tmp)) {
-				tmpParent = tmp;
-				tmp = tmp->children.at(0);
-			}
-			(*node)->keys.at(posKey) = tmp->keys.at(0);
-			(*node)->values.at(posKey) = tmp->values.at(0);
+	++t->count;
+	--s->count;
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+bool Btree<K, V, Compare, Degree>::remove(const K& key) {
+	if (this->root == nullptr)
+		return false;
+	bool removed = remove(key, &(this->root));
 
-			return remove(tmp->keys.at(0), tmp, tmpParent);
-		} else {
-			mergeAndRemove(left, right, node, posKey);
-			return true;
+	// The root may have been left empty after a merge => the tree shrinks
+	if (this->root->count == 0) {
+		NodeType* oldRoot = this->root;
+		this->root = oldRoot->leaf ? nullptr : oldRoot->children[0];
+		destroyNode(oldRoot);
+	}
+	return removed;
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+void Btree<K, V, Compare, Degree>::mergeAndRemove(NodeType** sibling, NodeType** target,
+		NodeType** parent, size_t parentI) {
+	NodeType* s = *sibling;
+	NodeType* p = *parent;
+	NodeType* t = *target;
+	// Insert parent as an element of current node
+	t->keys[t->count] = std::move(p->keys[parentI]);
+	t->values[t->count] = std::move(p->values[parentI]);
+	// Insert sibling keys/values/children into current node
+	std::move(s->keys, s->keys + s->count, t->keys + t->count + 1);
+	std::move(s->values, s->values + s->count, t->values + t->count + 1);
+	if (!t->leaf)
+		std::copy(s->children, s->children + s->count + 1,
+				t->children + t->count + 1);
+	t->count += 1 + s->count;
+	// Remove parent key/value and the (right) sibling from the parent children.
+	// Sibling children belong now to the target
+	shiftLeft(p->keys, parentI, p->count);
+	shiftLeft(p->values, parentI, p->count);
+	shiftLeft(p->children, parentI + 1, p->count + 1);
+	--p->count;
+	destroyNode(s);
+	*sibling = nullptr;
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+bool Btree<K, V, Compare, Degree>::remove(const K& key, NodeType** node) {
+
+	NodeType* n = *node;
+	// Get position of the key within the node
+	size_t posKey = getPositionInNode(n, key);
+	bool found = isKeyAt(n, posKey, key);
+
+	// 1. The node is a leaf: simply remove the key from it. Going down, we have
+	//    ensured that it has at least d keys (unless it is the root)
+	if (n->leaf) {
+		if (!found)
+			return false;
+		shiftLeft(n->keys, posKey, n->count);
+		shiftLeft(n->values, posKey, n->count);
+		--n->count;
+		return true;
+	}
+
+	// 2. The node is an internal node which contains the key
+	if (found) {
+		NodeType* left = n->children[posKey];
+		NodeType* right = n->children[posKey + 1];
+		//    2.1 Number of keys in left child node >= d => replace the key by
+		//        its predecessor and remove the predecessor (its value is moved,
+		//        as the entry left behind is removed anyway)
+		if (left->count >= Degree) {
+			NodeType* tmp = left;
+			while (!tmp->leaf)
+				tmp = tmp->children[tmp->count];
+			K lkey = tmp->keys[tmp->count - 1];
+			n->keys[posKey] = lkey;
+			n->values[posKey] = std::move(tmp->values[tmp->count - 1]);
+			return remove(lkey, &(n->children[posKey]));
+		}
+		//    2.2 Number of keys in right child node >= d => replace the key by
+		//        its successor and remove the successor
+		else if (right->count >= Degree) {
+			NodeType* tmp = right;
+			while (!tmp->leaf)
+				tmp = tmp->children[0];
+			K rkey = tmp->keys[0];
+			n->keys[posKey] = rkey;
+			n->values[posKey] = std::move(tmp->values[0]);
+			return remove(rkey, &(n->children[posKey + 1]));
+		}
+		//    2.3 Number of keys in left and right children == d-1 => merge both
+		//        children and the key, and remove it from the merged node
+		else {
+			mergeAndRemove(&right, &left, node, posKey);
+			return remove(key, &(n->children[posKey]));
+		}
+	}
+
+	// 3. The key is not in this internal node => make sure the child we go down
+	//    into has at least d keys before going down
+	NodeType* child = n->children[posKey];
+	if (child->count < Degree) {
+		NodeType* left = (posKey > 0) ? n->children[posKey - 1] : nullptr;
+		NodeType* right =
+				(posKey < n->count) ? n->children[posKey + 1] : nullptr;
+		//    3.1 A sibling node has >= d keys => borrow one key through the parent
+		if ((left != nullptr) && (left->count >= Degree))
+			rotateAndKeepSibling(&left, node, &child, posKey - 1,
+					left->count - 1);
+		else if ((right != nullptr) && (right->count >= Degree))
+			rotateAndKeepSibling(&right, node, &child, posKey, 0);
+		//    3.2 Both siblings have d-1 keys => merge with one of them
+		else if (right != nullptr)
+			mergeAndRemove(&right, &child, node, posKey);
+		else {
+			mergeAndRemove(&child, &left, node, posKey - 1);
+			--posKey;
 		}
 	}
+	return remove(key, &(n->children[posKey]));
+}
 
+template<typename K, typename V, typename Compare, unsigned short Degree>
+size_t Btree<K, V, Compare, Degree>::bulkLoadNodes(size_t items, size_t target) {
+	// As many nodes as needed to keep at most target keys per node, but few
+	// enough for every node to get d-1 keys at least (n + 1 = keys + nodes)
+	size_t nodes = (items + target + 1) / (target + 1);
+	nodes = std::min<size_t>(nodes, (items + 1) / Degree);
+	return std::max<size_t>(nodes, 1);
 }
 
+template class Btree<int> ;
+template class Btree<float> ;
+template class Btree<double> ;
+template class Btree<std::string> ;
+template class Btree<std::string, std::string, std::less<>> ;
+template class Btree<int, int, std::less<int>, bnodeDegree<int>(BNODE_PAGE_SIZE)> ;
+template class Btree<float, float, std::less<float>,
+		bnodeDegree<float>(BNODE_PAGE_SIZE)> ;
+template class Btree<double, double, std::less<double>,
+		bnodeDegree<double>(BNODE_PAGE_SIZE)> ;
+template class Btree<std::string, std::string, std::less<std::string>,
+		bnodeDegree<std::string>(BNODE_PAGE_SIZE)> ;
+
 } /* namespace tree */
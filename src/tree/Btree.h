@@ -8,124 +8,586 @@
 #define SRC_TREE_BTREE_H_
 
 #include "BNode.h"
+#include "NodePool.h"
+#include "NodeSearch.h"
+#include "WorkStealingPool.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <iterator>
 #include <list>
+#include <memory_resource>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace tree {
 
-template<typename T>
+/**
+ * This class implements a b-tree which maps keys of type K to values of type V,
+ * sorted by a comparator. The minimum degree d is set at compile time, so nodes
+ * keep their keys, values and children inline in fixed arrays: by default, d is
+ * chosen from sizeof(K) and sizeof(V) so that a node takes BNODE_DEFAULT_SIZE
+ * bytes. Lookups then touch a single contiguous block per level, which is
+ * searched with vector instructions for numeric keys (see rankInNode).
+ * Entries are moved into the tree and along its nodes, never copied, so values
+ * may be move-only (keys must be copyable). With a transparent comparator (such
+ * as std::less<>), keys can be looked up with any type comparable with them
+ * (e.g. std::string_view for std::string keys) without building a key.
+ * NOTE: the tree is instantiated in Btree.cpp for int, float, double and
+ * std::string (keys and values of the same type), with nodes of
+ * BNODE_DEFAULT_SIZE and BNODE_PAGE_SIZE bytes. Other types and degrees have to
+ * be instantiated there as well.
+ */
+template<typename K, typename V = K, typename Compare = std::less<K>,
+		unsigned short Degree = bnodeDegree<K, V>(BNODE_DEFAULT_SIZE)>
 class Btree {
+public:
+	typedef BNode<K, V, Degree> NodeType;
 private:
-	unsigned short d;
-	BNode<T>* root;
+	NodeType* root;
+	NodePool<NodeType> pool;
+	Compare compare;
 public:
 	/**
-	 * Class constructor.
-	 * @param[in] d: minimum degree term. This defines the number of
-	 *               minimum keys per node (d-1) - except for the root -
-	 *               and the maximum (2*d-1).
+	 * Bidirectional iterator which goes along the tree in an in-order order. It
+	 * keeps the path from the root to the current key (node and position for each
+	 * level) in a fixed buffer, so it does not allocate memory. Iterators are
+	 * invalidated by any change in the tree.
+	 */
+	class const_iterator {
+	public:
+		typedef std::bidirectional_iterator_tag iterator_category;
+		typedef K value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const K* pointer;
+		typedef const K& reference;
+
+		const_iterator() :
+				tree(nullptr), depth(0) {
+		}
+		const_iterator(const const_iterator& other) :
+				tree(other.tree), depth(other.depth) {
+			std::copy(other.levels, other.levels + depth, levels);
+		}
+		const_iterator& operator=(const const_iterator& other) {
+			tree = other.tree;
+			depth = other.depth;
+			std::copy(other.levels, other.levels + depth, levels);
+			return *this;
+		}
+		reference operator*() const {
+			return top().node->keys[top().pos];
+		}
+		pointer operator->() const {
+			return &(top().node->keys[top().pos]);
+		}
+		/**
+		 * Get the value associated to the current key
+		 * @return Value of the current element
+		 */
+		const V& value() const {
+			return top().node->values[top().pos];
+		}
+		const_iterator& operator++() {
+			Level& current = top();
+			if (!current.node->leaf) {
+				// Go down to the minimum key on the right of the current one
+				++current.pos;
+				descendLeft(current.node->children[current.pos]);
+				return *this;
+			}
+			if (current.pos + 1u < current.node->count) {
+				++current.pos;
+				return *this;
+			}
+			// Go up until we come from a child which is not the last one
+			--depth;
+			while ((depth > 0) && (top().pos == top().node->count))
+				--depth;
+			return *this;
+		}
+		const_iterator operator++(int) {
+			const_iterator previous = *this;
+			++(*this);
+			return previous;
+		}
+		const_iterator& operator--() {
+			if (depth == 0) {
+				descendRight(tree->root);
+				return *this;
+			}
+			Level& current = top();
+			if (!current.node->leaf) {
+				// Go down to the maximum key on the left of the current one
+				descendRight(current.node->children[current.pos]);
+				return *this;
+			}
+			if (current.pos > 0) {
+				--current.pos;
+				return *this;
+			}
+			// Go up until we come from a child which is not the first one
+			--depth;
+			while ((depth > 0) && (top().pos == 0))
+				--depth;
+			if (depth > 0)
+				--top().pos;
+			return *this;
+		}
+		const_iterator operator--(int) {
+			const_iterator previous = *this;
+			--(*this);
+			return previous;
+		}
+		bool operator==(const const_iterator& other) const {
+			if ((depth == 0) || (other.depth == 0))
+				return depth == other.depth;
+			return (top().node == other.top().node)
+					&& (top().pos == other.top().pos);
+		}
+		bool operator!=(const const_iterator& other) const {
+			return !(*this == other);
+		}
+	private:
+		friend class Btree<K, V, Compare, Degree>;
+		/**
+		 * Node and position at each level of the path. For the current level, the
+		 * position is the current key; for the upper ones, it is the child the path
+		 * goes down into (which is the position of the next key in that node)
+		 */
+		struct Level {
+			const NodeType* node;
+			size_t pos;
+		};
+		// A b-tree with 2^64 keys is at most 64 levels high (d >= 2)
+		static constexpr size_t MAX_DEPTH = 64;
+
+		explicit const_iterator(const Btree<K, V, Compare, Degree>* tree) :
+				tree(tree), depth(0) {
+		}
+		Level& top() {
+			return levels[depth - 1];
+		}
+		const Level& top() const {
+			return levels[depth - 1];
+		}
+		void push(const NodeType* node, size_t pos) {
+			levels[depth].node = node;
+			levels[depth].pos = pos;
+			++depth;
+		}
+		/**
+		 * Go down from a node to the minimum key of its subtree
+		 * @param[in] node Root of the subtree
+		 */
+		void descendLeft(const NodeType* node) {
+			while (node != nullptr) {
+				push(node, 0);
+				node = node->leaf ? nullptr : node->children[0];
+			}
+		}
+		/**
+		 * Go down from a node to the maximum key of its subtree
+		 * @param[in] node Root of the subtree
+		 */
+		void descendRight(const NodeType* node) {
+			while (node != nullptr) {
+				if (node->leaf) {
+					push(node, node->count - 1);
+					break;
+				}
+				push(node, node->count);
+				node = node->children[node->count];
+			}
+		}
+		const Btree<K, V, Compare, Degree>* tree;
+		size_t depth;
+		Level levels[MAX_DEPTH];
+	};
+	typedef const_iterator iterator;
+
+	/**
+	 * Class constructor. The minimum degree term d (Degree) defines the number
+	 * of minimum keys per node (d-1) - except for the root - and the maximum
+	 * (2*d-1).
+	 * @param[in] resource: memory resource backing the nodes
+	 * @param[in] compare: comparator which sorts the keys
 	 */
-	Btree(unsigned short d = 1);
+	explicit Btree(std::pmr::memory_resource* resource =
+			std::pmr::get_default_resource(), const Compare& compare = Compare());
 	/**
 	 * Class destructor
 	 */
 	virtual ~Btree();
+	Btree(const Btree&) = delete;
+	Btree& operator=(const Btree&) = delete;
+	/**
+	 * Remove all the elements from the tree. Node memory is returned to the
+	 * memory resource slab by slab (without going through the nodes when keys
+	 * and values do not need to be destroyed)
+	 */
+	void clear();
 	/**
 	 * Search a given key in the b-tree
 	 * @param[in] key Key to find
 	 * @return Returns the node which contains the key, or nullptr
 	 * if it is not found
 	 */
-	BNode<T>* search(const T& key);
+	NodeType* search(const K& key);
+	/**
+	 * Search a key in the b-tree with a value of another type (only with a
+	 * transparent comparator)
+	 * @param[in] key Value which compares equal to the key to find
+	 * @return Returns the node which contains the key, or nullptr
+	 * if it is not found
+	 */
+	template<typename Key, typename C = Compare, typename = typename C::is_transparent>
+	NodeType* search(const Key& key);
+	/**
+	 * Verifies whether a key is in the b-tree
+	 * @param[in] key Key to find
+	 * @return Returns true if the key is found
+	 */
+	bool contains(const K& key) const;
+	/**
+	 * Verifies whether a key is in the b-tree, with a value of another type (only
+	 * with a transparent comparator)
+	 * @param[in] key Value which compares equal to the key to find
+	 * @return Returns true if the key is found
+	 */
+	template<typename Key, typename C = Compare, typename = typename C::is_transparent>
+	bool contains(const Key& key) const;
 	/**
 	 * Go along the tree in an in-order order.
 	 * @param[out] orderedList List in an in-order order
 	 */
-	void getInorder(std::list<T>& orderedList) const;
+	void getInorder(std::list<K>& orderedList) const;
 	/**
 	 * Go along the tree in n pre-order order.
 	 * @param[out] orderedList List in a pre-order order
 	 */
-	void getPreorder(std::list<T>& orderedList) const;
+	void getPreorder(std::list<K>& orderedList) const;
 	/**
 	 * Go along the tree in a post-order order.
 	 * @param[out] orderedList List in a post-order order
 	 */
-	void getPostorder(std::list<T>& orderedList) const;
+	void getPostorder(std::list<K>& orderedList) const;
+	/**
+	 * Get an iterator to the minimum key of the tree
+	 * @return Iterator to the first key in an in-order order
+	 */
+	const_iterator begin() const;
+	/**
+	 * Get an iterator past the maximum key of the tree
+	 * @return Iterator to the end of the tree
+	 */
+	const_iterator end() const;
+	/**
+	 * Get an iterator to the first key which is not lower than a given one
+	 * @param[in] key Key to compare with
+	 * @return Iterator to the first key >= key, or end() if there is none
+	 */
+	const_iterator lower_bound(const K& key) const;
+	/**
+	 * Same as above, with a value of another type (only with a transparent
+	 * comparator)
+	 */
+	template<typename Key, typename C = Compare, typename = typename C::is_transparent>
+	const_iterator lower_bound(const Key& key) const;
+	/**
+	 * Get an iterator to the first key which is higher than a given one
+	 * @param[in] key Key to compare with
+	 * @return Iterator to the first key > key, or end() if there is none
+	 */
+	const_iterator upper_bound(const K& key) const;
+	/**
+	 * Same as above, with a value of another type (only with a transparent
+	 * comparator)
+	 */
+	template<typename Key, typename C = Compare, typename = typename C::is_transparent>
+	const_iterator upper_bound(const Key& key) const;
+	/**
+	 * Get the range of keys which are equal to a given one
+	 * @param[in] key Key to compare with
+	 * @return Pair of iterators with lower_bound(key) and upper_bound(key)
+	 */
+	std::pair<const_iterator, const_iterator> equal_range(const K& key) const;
+	/**
+	 * Same as above, with a value of another type (only with a transparent
+	 * comparator)
+	 */
+	template<typename Key, typename C = Compare, typename = typename C::is_transparent>
+	std::pair<const_iterator, const_iterator> equal_range(const Key& key) const;
 	/**
 	 * Determines whether a node is a leaf node or not
 	 * @param[in] node Node to be checked
 	 * @return Returns whether the node is a leaf node or not
 	 */
-	bool isLeaf(BNode<T>* node);
+	bool isLeaf(NodeType* node) const;
 	/**
-	 * Insert an element into the tree (if it does not exist yet)
+	 * Insert an element into the tree (if it does not exist yet). Arguments which
+	 * are rvalues are moved into the tree
 	 * @param[in] key	Key to add to the tree
 	 * @param[in] value	Value associated to the key
+	 * @return Returns whether the element has been inserted
+	 */
+	template<typename KeyArg, typename ValueArg>
+	bool insert(KeyArg&& key, ValueArg&& value);
+	/**
+	 * Insert an element into the tree (if it does not exist yet), building its
+	 * value from some arguments. The value is only built once the key is known to
+	 * be missing, and it is then moved into its place
+	 * @param[in] key	Key to add to the tree
+	 * @param[in] args	Arguments for the constructor of the value
+	 * @return Returns whether the element has been inserted
 	 */
-	bool insert(T& key, T& value);
+	template<typename ... Args>
+	bool emplace(const K& key, Args&&... args);
+	template<typename ... Args>
+	bool emplace(K&& key, Args&&... args);
 	/**
 	 * Removes an element from the tree (if exists)
 	 * @param[in] key 	Key to remove
 	 * @return 	Returns whether the node has been removed or not
 	 */
-	bool remove(T& key);
+	bool remove(const K& key);
+	/**
+	 * Replace the contents of the tree by the elements in a sorted range, building
+	 * it from the bottom up in O(n): leaves are filled from left to right, and the
+	 * entries between them go up as the keys of the next level, so no node is ever
+	 * split. All the nodes are created in a single contiguous slab. Repeated keys
+	 * are inserted only once. Elements are copied from the range, or moved from it
+	 * through move iterators.
+	 * @param[in] first Beginning of the range of (key, value) pairs, sorted by key
+	 * in ascending order
+	 * @param[in] last End of the range
+	 * @param[in] fillFactor Share of each node to fill, in (0, 1]. It is clamped so
+	 * that nodes keep at least d-1 keys. Lower values leave room for later inserts
+	 * without splitting nodes
+	 */
+	template<typename ForwardIt>
+	void bulkLoad(ForwardIt first, ForwardIt last, double fillFactor = 1.0);
+	/**
+	 * Insert a batch of elements in the tree. The batch is sorted by key and
+	 * merged into the tree leaf by leaf: each descent (which splits full nodes as
+	 * insert does) reaches the leaf of the next key, and every following key which
+	 * goes into that leaf is merged into it at once while it has room. As with
+	 * insert, keys which already exist are not inserted (nor their values
+	 * changed), and a key repeated in the batch keeps its first value. An empty
+	 * tree is bulk loaded. Elements are copied from the range, or moved from it
+	 * through move iterators
+	 * @param[in] first Beginning of the range of (key, value) pairs
+	 * @param[in] last End of the range
+	 * @return Number of elements which have been inserted
+	 */
+	template<typename InputIt>
+	size_t insertBatch(InputIt first, InputIt last);
+	/**
+	 * Call a function for every key of the tree, using several threads: the
+	 * children of the nodes are forked as tasks of a work-stealing pool down to a
+	 * given depth, and they are walked sequentially below it. The function is
+	 * called from several threads at once, in no particular order. If it throws,
+	 * the exception is thrown again here once every task has finished
+	 * @param[in] function Function called with each key
+	 * @param[in] pool Pool which runs the tasks
+	 * @param[in] forkDepth Levels of the tree whose children are forked (0 for a
+	 * sequential walk, negative for the default of 2 levels)
+	 */
+	template<typename F>
+	void parallelForEach(F function, WorkStealingPool& pool =
+			WorkStealingPool::instance(), int forkDepth = -1) const;
+	/**
+	 * Aggregate the keys of the tree using several threads (see parallelForEach).
+	 * Partial results are combined in the in-order order, so the combination only
+	 * needs to be associative
+	 * @param[in] identity Result for an empty subtree
+	 * @param[in] map Function which gets the result for a key
+	 * @param[in] combine Function which combines two results
+	 * @param[in] pool Pool which runs the tasks
+	 * @param[in] forkDepth Levels of the tree whose children are forked
+	 * @return Combination of the results of all the keys
+	 */
+	template<typename R, typename Map, typename Combine>
+	R parallelReduce(R identity, Map map, Combine combine,
+			WorkStealingPool& pool = WorkStealingPool::instance(),
+			int forkDepth = -1) const;
+	/**
+	 * Copy the keys of the tree in an in-order order to a contiguous buffer, using
+	 * several threads: the sizes of the forked subtrees are counted first, so that
+	 * each one is copied to its own part of the buffer
+	 * @param[out] buffer Keys of the tree in an in-order order
+	 * @param[in] pool Pool which runs the tasks
+	 * @param[in] forkDepth Levels of the tree whose children are forked
+	 */
+	void parallelExport(std::vector<K>& buffer, WorkStealingPool& pool =
+			WorkStealingPool::instance(), int forkDepth = -1) const;
 private:
+	/**
+	 * Sizes of the subtrees forked by a parallel walk, as a tree with the same
+	 * shape as the forked part
+	 */
+	struct SubtreeSizes {
+		size_t size;
+		std::vector<SubtreeSizes> children;
+	};
+	/**
+	 * Get the number of levels to fork for a parallel walk
+	 * @param[in] requested Levels requested by the caller (negative for the
+	 * default)
+	 * @param[in] pool Pool which runs the tasks
+	 * @return Levels to fork
+	 */
+	static int forkLevels(int requested, const WorkStealingPool& pool);
+	/**
+	 * Call a function for the keys of a subtree in an in-order order
+	 * @param[in] node Root of the subtree
+	 * @param[in] function Function called with each key
+	 */
+	template<typename F>
+	static void forEachInorder(NodeType* node, F& function);
+	/**
+	 * Call a function for the keys of a subtree, forking the children of the
+	 * first levels
+	 * @param[in] node Root of the subtree
+	 * @param[in] function Function called with each key
+	 * @param[in] depth Levels left to fork
+	 * @param[in] pool Pool which runs the tasks
+	 */
+	template<typename F>
+	void forEachTask(NodeType* node, F& function, int depth,
+			WorkStealingPool& pool) const;
+	/**
+	 * Aggregate the keys of a subtree, forking the children of the first levels
+	 * @param[in] node Root of the subtree
+	 * @param[in] identity Result for an empty subtree
+	 * @param[in] map Function which gets the result for a key
+	 * @param[in] combine Function which combines two results
+	 * @param[in] depth Levels left to fork
+	 * @param[in] pool Pool which runs the tasks
+	 * @return Combination of the results of the keys of the subtree
+	 */
+	template<typename R, typename Map, typename Combine>
+	R reduceTask(NodeType* node, const R& identity, Map& map, Combine& combine,
+			int depth, WorkStealingPool& pool) const;
+	/**
+	 * Count the keys of a subtree, forking the children of the first levels
+	 * @param[in] node Root of the subtree
+	 * @param[out] sizes Sizes of the subtree and of its forked children
+	 * @param[in] depth Levels left to fork
+	 * @param[in] pool Pool which runs the tasks
+	 */
+	void countTask(NodeType* node, SubtreeSizes& sizes, int depth,
+			WorkStealingPool& pool) const;
+	/**
+	 * Copy the keys of a subtree in an in-order order, forking the children of
+	 * the first levels
+	 * @param[in] node Root of the subtree
+	 * @param[in] sizes Sizes counted by countTask
+	 * @param[out] out Part of the buffer for the subtree
+	 * @param[in] depth Levels left to fork
+	 * @param[in] pool Pool which runs the tasks
+	 */
+	void exportTask(NodeType* node, const SubtreeSizes& sizes, K* out, int depth,
+			WorkStealingPool& pool) const;
 	/**
 	 * Go along the tree in an in-order order.
 	 * @param[in] root Root node
 	 * @param[out] orderedList List in an in-order order
 	 */
-	void getInorder(BNode<T>* root, std::list<T>& orderedList) const;
+	void getInorder(NodeType* root, std::list<K>& orderedList) const;
 	/**
 	 * Go along the tree in n pre-order order.
 	 * @param[in]  root        Root node
 	 * @param[out] orderedList List in a pre-order order
 	 */
-	void getPreorder(BNode<T>* root, std::list<T>& orderedList) const;
+	void getPreorder(NodeType* root, std::list<K>& orderedList) const;
 	/**
 	 * Go along the tree in a post-order order.
 	 * @param[in]  root        Root node
 	 * @param[out] orderedList List in a post-order order
 	 */
-	void getPostorder(BNode<T>* root, std::list<T>& orderedList) const;
+	void getPostorder(NodeType* root, std::list<K>& orderedList) const;
 	/**
 	 * Search a given key in the b-tree
-	 * @param[in] key 		Key to find
-	 * @param[out] parent	Parent node for the searched key
+	 * @param[in] key Key (or value which compares equal to it) to find
 	 * @return Returns the node which contains the key, or nullptr
 	 * if it is not found
 	 */
-	BNode<T>* search(const T& key, BNode<T>** parent);
+	template<typename Key>
+	NodeType* findNode(const Key& key) const;
+	/**
+	 * Get an iterator to the first key which is not lower than a given one
+	 * @param[in] key Key (or value comparable with keys) to compare with
+	 * @return Iterator to the first key >= key, or end() if there is none
+	 */
+	template<typename Key>
+	const_iterator lowerBound(const Key& key) const;
+	/**
+	 * Get an iterator to the first key which is higher than a given one
+	 * @param[in] key Key (or value comparable with keys) to compare with
+	 * @return Iterator to the first key > key, or end() if there is none
+	 */
+	template<typename Key>
+	const_iterator upperBound(const Key& key) const;
+	/**
+	 * Create an empty node in the node pool
+	 * @param[in] leaf Whether the node is a leaf node
+	 * @return Returns the new node
+	 */
+	NodeType* createNode(bool leaf);
+	/**
+	 * Destroy a node (its children are not destroyed)
+	 * @param[in] node Node to destroy
+	 */
+	void destroyNode(NodeType* node);
 	/**
 	 * Initialize a node and its children
 	 * @param[out] node	 Node to initialize
-	 * @param[in]  key	 Key to set to the node
-	 * @param[in]  value Value to set to the node
+	 * @param[in]  key	 Key to move to the node
+	 * @param[in]  value Value to move to the node
 	 */
-	void initNode(BNode<T>** node, T& key, T& value);
+	void initNode(NodeType** node, K&& key, V&& value);
 	/**
-	 * Insert an element into the tree
-	 * @param[in] key Key element to insert in the tree
-	 * @param[in] value Value element to insert in the tree
+	 * Insert an element whose key is not in the tree, splitting the root first if
+	 * it is full
+	 * @param[in] key Key to move into the tree
+	 * @param[in] value Value to move into the tree
+	 */
+	void insertNew(K&& key, V&& value);
+	/**
+	 * Insert an element into the tree. Full nodes are split on the way down,
+	 * so the node where the insertion starts must not be full
+	 * @param[in] key Key element to move into the tree
+	 * @param[in] value Value element to move into the tree
 	 * @param[in] node Reference to the node where to start the insertion
-	 * @param[in] parent Parent node for the current one
 	 */
-	bool insertElement(T& key, T&value, BNode<T>** node, BNode<T>** parent);
+	bool insertElement(K&& key, V&& value, NodeType** node);
 	/**
 	 * Insert an element in the sorted place of the node (ascending order)
-	 * @param[in]  key Key to add
-	 * @param[in]  value Value to add
+	 * @param[in]  key Key to move into the node
+	 * @param[in]  value Value to move into the node
 	 * @param[out] node Node to insert the values
 	 */
-	void insertInNoFullNode(T key, T value, BNode<T>** node);
+	void insertInNoFullNode(K&& key, V&& value, NodeType** node);
+	/**
+	 * Merge a batch of elements into a tree which is not empty (see insertBatch)
+	 * @param[in|out] items Elements to insert, sorted by key in ascending order and
+	 * without repeated keys. The inserted ones are moved into the tree
+	 * @return Number of elements which have been inserted
+	 */
+	size_t insertSorted(std::vector<std::pair<K, V>>& items);
 	/**
-	 * Removes an element from the tree starting from the node
+	 * Removes an element from the tree starting from the node. Each child is
+	 * refilled up to Degree keys before going down into it, so a single descent is
+	 * enough
 	 * @param[in] key Key to remove
 	 * @param[in] node Node to start searching
-	 * @param[in] parent Parent of the node
 	 */
-	bool remove(T& key, BNode<T>**node, BNode<T>**parent);
+	bool remove(const K& key, NodeType**node);
 	/**
 	 * Copies the sibling key/value at a given position into the parent
 	 * and the parent key/values to the target node
@@ -136,24 +598,37 @@ private:
 	 * @param[in] posSibling Position at the sibling whose key/value replace
 	 *                    current parent ones
 	 */
-	void rotateAndKeepSibling(BNode<T>** sibling, BNode<T>** parent,
-			BNode<T>** target, size_t parentI, size_t posSibling);
+	void rotateAndKeepSibling(NodeType** sibling, NodeType** parent,
+			NodeType** target, size_t parentI, size_t posSibling);
 	/**
 	 * Merge two siblings and remove the parent node
-	 * @param[in] sibling Sibling node of the target node
-	 * @param[in] target Target node
+	 * @param[in] sibling Sibling node of the target node (right one), which is
+	 *                    deleted after the merge
+	 * @param[in] target Target node (left one)
 	 * @param[in] parent Parent node of siblings
 	 * @param[in] parentI Position of the key parent for siblings
 	 */
-	void mergeAndRemove(BNode<T>** sibling, BNode<T>** target,
-			BNode<T>** parent, size_t parentI);
+	void mergeAndRemove(NodeType** sibling, NodeType** target,
+			NodeType** parent, size_t parentI);
 	/**
 	 * Get the position a key is found in the node, or the next one if not available
+	 * (i.e. the position of the child to go down into)
 	 * @param[in] node Node to search in
-	 * @param[in] key Key to search
+	 * @param[in] key Key (or value comparable with keys) to search
 	 * @return Position in the node
 	 */
-	size_t getPositionInNode(BNode<T>* node, T& key) const;
+	template<typename Key>
+	size_t getPositionInNode(const NodeType* node, const Key& key) const;
+	/**
+	 * Verifies whether the key at a position of a node is a given one, once the
+	 * position has been found by getPositionInNode
+	 * @param[in] node Node to check
+	 * @param[in] pos Position in the node
+	 * @param[in] key Key (or value comparable with keys) to compare with
+	 * @return Returns true if there is a key at the position and it is equal to key
+	 */
+	template<typename Key>
+	bool isKeyAt(const NodeType* node, size_t pos, const Key& key) const;
 
 	/**
 	 * Split the node in two parts
@@ -162,10 +637,370 @@ private:
 	 * @param[out] midKey Key in the middle
 	 * @param[out] midValue Value in the middle
 	 */
-	void splitNode(BNode<T>** originalAndLeftNode, BNode<T>** right, T& midKey,
-			T& midValue);
+	void splitNode(NodeType** originalAndLeftNode, NodeType** right, K& midKey,
+			V& midValue);
+	/**
+	 * Get the number of nodes a level of a bulk-loaded tree is split into. Nodes
+	 * get as close as possible to the target number of keys, without going under
+	 * d-1 keys, and there is an entry between every two nodes which goes up
+	 * @param[in] items Number of entries in the level
+	 * @param[in] target Target number of keys per node
+	 * @return Number of nodes
+	 */
+	static size_t bulkLoadNodes(size_t items, size_t target);
 };
 
+template<typename K, typename V, typename Compare, unsigned short Degree>
+template<typename Key, typename C, typename>
+typename Btree<K, V, Compare, Degree>::NodeType* Btree<K, V, Compare, Degree>::search(
+		const Key& key) {
+	return findNode(key);
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+template<typename Key, typename C, typename>
+bool Btree<K, V, Compare, Degree>::contains(const Key& key) const {
+	return findNode(key) != nullptr;
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+template<typename Key, typename C, typename>
+typename Btree<K, V, Compare, Degree>::const_iterator Btree<K, V, Compare, Degree>::lower_bound(
+		const Key& key) const {
+	return lowerBound(key);
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+template<typename Key, typename C, typename>
+typename Btree<K, V, Compare, Degree>::const_iterator Btree<K, V, Compare, Degree>::upper_bound(
+		const Key& key) const {
+	return upperBound(key);
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+template<typename Key, typename C, typename>
+std::pair<typename Btree<K, V, Compare, Degree>::const_iterator,
+		typename Btree<K, V, Compare, Degree>::const_iterator> Btree<K, V,
+		Compare, Degree>::equal_range(const Key& key) const {
+	return std::make_pair(lowerBound(key), upperBound(key));
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+template<typename KeyArg, typename ValueArg>
+bool Btree<K, V, Compare, Degree>::insert(KeyArg&& key, ValueArg&& value) {
+	return emplace(std::forward<KeyArg>(key), std::forward<ValueArg>(value));
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+template<typename ... Args>
+bool Btree<K, V, Compare, Degree>::emplace(const K& key, Args&&... args) {
+	if (findNode(key) != nullptr)
+		return false;
+	insertNew(K(key), V(std::forward<Args>(args)...));
+	return true;
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+template<typename ... Args>
+bool Btree<K, V, Compare, Degree>::emplace(K&& key, Args&&... args) {
+	if (findNode(key) != nullptr)
+		return false;
+	insertNew(std::move(key), V(std::forward<Args>(args)...));
+	return true;
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+template<typename ForwardIt>
+void Btree<K, V, Compare, Degree>::bulkLoad(ForwardIt first, ForwardIt last,
+		double fillFactor) {
+	clear();
+	// Count different keys, so that the shape of the tree is known beforehand
+	size_t n = 0;
+	for (ForwardIt it = first; it != last; ++n) {
+		ForwardIt previous = it;
+		while ((++it != last) && !compare(previous->first, it->first))
+			;
+	}
+	if (n == 0)
+		return;
+	size_t target = static_cast<size_t>(fillFactor * NodeType::MAX_KEYS + 0.5);
+	target = std::min<size_t>(std::max<size_t>(target, Degree - 1),
+			NodeType::MAX_KEYS);
+
+	// Make room for the nodes of every level
+	size_t total = 0;
+	for (size_t items = n, nodes = 0; nodes != 1; items = nodes - 1) {
+		nodes = bulkLoadNodes(items, target);
+		total += nodes;
+	}
+	pool.reserve(total);
+
+	// 1. Leaves, from left to right. The entry after each leaf (but the last one)
+	//    goes up as a separator
+	std::vector<NodeType*> level;
+	std::vector<std::pair<K, V>> separators;
+	size_t nodes = bulkLoadNodes(n, target);
+	size_t keys = n - (nodes - 1);
+	level.reserve(nodes);
+	separators.reserve(nodes - 1);
+	for (size_t i = 0; i < nodes; ++i) {
+		NodeType* leaf = createNode(true);
+		leaf->count = keys / nodes + ((i < keys % nodes) ? 1 : 0);
+		for (size_t j = 0; j <= leaf->count; ++j) {
+			// Repeated keys are skipped by comparing with the key just stored, as
+			// the one in the range may have been moved from
+			auto&& item = *first;
+			const K* stored;
+			if (j < leaf->count) {
+				leaf->keys[j] = std::forward<decltype(item)>(item).first;
+				leaf->values[j] = std::forward<decltype(item)>(item).second;
+				stored = &(leaf->keys[j]);
+			} else if (i + 1 < nodes) {
+				separators.emplace_back(std::forward<decltype(item)>(item).first,
+						std::forward<decltype(item)>(item).second);
+				stored = &(separators.back().first);
+			} else {
+				break;
+			}
+			while ((++first != last) && !compare(*stored, first->first))
+				;
+		}
+		level.push_back(leaf);
+	}
+
+	// 2. Internal levels, from the bottom up. Each node takes the next separators
+	//    as its keys, and the nodes around them as its children
+	while (level.size() > 1) {
+		nodes = bulkLoadNodes(separators.size(), target);
+		keys = separators.size() - (nodes - 1);
+		std::vector<NodeType*> parents;
+		std::vector<std::pair<K, V>> upper;
+		parents.reserve(nodes);
+		upper.reserve(nodes - 1);
+		size_t child = 0;
+		for (size_t i = 0; i < nodes; ++i) {
+			NodeType* node = createNode(false);
+			node->count = keys / nodes + ((i < keys % nodes) ? 1 : 0);
+			for (size_t j = 0; j < node->count; ++j) {
+				node->children[j] = level[child];
+				node->keys[j] = std::move(separators[child].first);
+				node->values[j] = std::move(separators[child].second);
+				++child;
+			}
+			node->children[node->count] = level[child];
+			if (i + 1 < nodes)
+				upper.push_back(std::move(separators[child]));
+			++child;
+			parents.push_back(node);
+		}
+		level.swap(parents);
+		separators.swap(upper);
+	}
+	this->root = level[0];
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+template<typename InputIt>
+size_t Btree<K, V, Compare, Degree>::insertBatch(InputIt first, InputIt last) {
+	std::vector<std::pair<K, V>> items(first, last);
+	// Stable, so that the first of the repeated keys is the one which is kept
+	std::stable_sort(items.begin(), items.end(),
+			[this](const std::pair<K, V>& a, const std::pair<K, V>& b) {
+				return compare(a.first, b.first);
+			});
+	items.erase(std::unique(items.begin(), items.end(),
+			[this](const std::pair<K, V>& a, const std::pair<K, V>& b) {
+				return !compare(a.first, b.first);
+			}), items.end());
+	if (this->root == nullptr) {
+		bulkLoad(std::make_move_iterator(items.begin()),
+				std::make_move_iterator(items.end()));
+		return items.size();
+	}
+	return insertSorted(items);
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+template<typename F>
+void Btree<K, V, Compare, Degree>::parallelForEach(F function, WorkStealingPool& pool,
+		int forkDepth) const {
+	forEachTask(this->root, function, forkLevels(forkDepth, pool), pool);
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+template<typename R, typename Map, typename Combine>
+R Btree<K, V, Compare, Degree>::parallelReduce(R identity, Map map, Combine combine,
+		WorkStealingPool& pool, int forkDepth) const {
+	return reduceTask(this->root, identity, map, combine,
+			forkLevels(forkDepth, pool), pool);
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+template<typename Key>
+typename Btree<K, V, Compare, Degree>::NodeType* Btree<K, V, Compare, Degree>::findNode(
+		const Key& key) const {
+
+	// Start in the root node
+	NodeType* node = this->root;
+
+	while (node != nullptr) {
+		// Look until the key in the current node is higher or equal than the
+		// existing key or the last key was reached
+		size_t nkey = getPositionInNode(node, key);
+
+		// The key was found
+		if (isKeyAt(node, nkey, key))
+			return node;
+
+		// The key was not found and this is a leaf => the key is not in the tree
+		if (node->leaf)
+			break;
+
+		// The key was not found:
+		// 1. The key at nkey is higher than the searched key => take left child
+		// 2. The key is higher than any key in the current node => take the right
+		//     child (nkey is already count => it points to the right child)
+		node = node->children[nkey];
+	}
+	return nullptr;
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+template<typename Key>
+typename Btree<K, V, Compare, Degree>::const_iterator Btree<K, V, Compare, Degree>::lowerBound(
+		const Key& key) const {
+	// Go down keeping the path, and remember the deepest level which has a key
+	// >= key: the path up to it is the path of the result
+	const_iterator it(this);
+	size_t found = 0;
+	const NodeType* node = this->root;
+	while (node != nullptr) {
+		size_t pos = getPositionInNode(node, key);
+		it.push(node, pos);
+		if (pos < node->count) {
+			found = it.depth;
+			if (isKeyAt(node, pos, key))
+				break;
+		}
+		node = node->leaf ? nullptr : node->children[pos];
+	}
+	it.depth = found;
+	return it;
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+template<typename Key>
+typename Btree<K, V, Compare, Degree>::const_iterator Btree<K, V, Compare, Degree>::upperBound(
+		const Key& key) const {
+	// Same as lowerBound, but remembering the deepest level with a key > key
+	const_iterator it(this);
+	size_t found = 0;
+	const NodeType* node = this->root;
+	while (node != nullptr) {
+		size_t pos = std::upper_bound(node->keys, node->keys + node->count, key,
+				compare) - node->keys;
+		it.push(node, pos);
+		if (pos < node->count)
+			found = it.depth;
+		node = node->leaf ? nullptr : node->children[pos];
+	}
+	it.depth = found;
+	return it;
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+template<typename Key>
+size_t Btree<K, V, Compare, Degree>::getPositionInNode(const NodeType* node,
+		const Key& key) const {
+	// Numeric keys sorted by their own operator< are searched with vector
+	// instructions; any other key goes through the comparator
+	if constexpr (std::is_same<Key, K>::value && std::is_arithmetic<K>::value
+			&& (std::is_same<Compare, std::less<K>>::value
+					|| std::is_same<Compare, std::less<>>::value))
+		return rankInNode(node->keys, node->count, key);
+	else
+		return std::lower_bound(node->keys, node->keys + node->count, key,
+				compare) - node->keys;
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+template<typename Key>
+bool Btree<K, V, Compare, Degree>::isKeyAt(const NodeType* node, size_t pos,
+		const Key& key) const {
+	// The key at pos is not lower than key => they are equal unless it is higher
+	return (pos < node->count) && !compare(key, node->keys[pos]);
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+template<typename F>
+void Btree<K, V, Compare, Degree>::forEachInorder(NodeType* node, F& function) {
+	if (node == nullptr)
+		return;
+	for (size_t i = 0; i < node->count; ++i) {
+		if (!node->leaf)
+			forEachInorder(node->children[i], function);
+		function(node->keys[i]);
+	}
+	if (!node->leaf)
+		forEachInorder(node->children[node->count], function);
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+template<typename F>
+void Btree<K, V, Compare, Degree>::forEachTask(NodeType* node, F& function, int depth,
+		WorkStealingPool& pool) const {
+	if ((depth <= 0) || (node == nullptr) || node->leaf) {
+		forEachInorder(node, function);
+		return;
+	}
+	// Every child but the last one is forked, and the last one is walked by this
+	// thread
+	TaskGroup group;
+	for (size_t i = 0; i < node->count; ++i) {
+		NodeType* child = node->children[i];
+		pool.submit(group, [&, child]() {
+			forEachTask(child, function, depth - 1, pool);
+		});
+	}
+	pool.runAndWait(group, [&]() {
+		for (size_t i = 0; i < node->count; ++i)
+			function(node->keys[i]);
+		forEachTask(node->children[node->count], function, depth - 1, pool);
+	});
+}
+
+template<typename K, typename V, typename Compare, unsigned short Degree>
+template<typename R, typename Map, typename Combine>
+R Btree<K, V, Compare, Degree>::reduceTask(NodeType* node, const R& identity, Map& map,
+		Combine& combine, int depth, WorkStealingPool& pool) const {
+	if ((depth <= 0) || (node == nullptr) || node->leaf) {
+		R result = identity;
+		auto accumulate = [&](const K& key) {
+			result = combine(result, map(key));
+		};
+		forEachInorder(node, accumulate);
+		return result;
+	}
+	// A deque, so that every part is a separate object (even for bool)
+	std::deque<R> parts(node->count + 1, identity);
+	TaskGroup group;
+	for (size_t i = 0; i < node->count; ++i) {
+		NodeType* child = node->children[i];
+		R* part = &(parts[i]);
+		pool.submit(group, [&, child, part]() {
+			*part = reduceTask(child, identity, map, combine, depth - 1, pool);
+		});
+	}
+	pool.runAndWait(group, [&]() {
+		parts[node->count] = reduceTask(node->children[node->count], identity,
+				map, combine, depth - 1, pool);
+	});
+	R result = parts[0];
+	for (size_t i = 0; i < node->count; ++i)
+		result = combine(combine(result, map(node->keys[i])), parts[i + 1]);
+	return result;
+}
+
 } /* namespace tree */
 
 #endif /* SRC_TREE_BTREE_H_ */
@@ -8,10 +8,11 @@
 #include <cassert>
 #include <iostream>
 #include <list>
+#include <sstream>
 #include <string>
 
-template <typename T>
-void logAndWait(int element, tree::BinarySearchTree<T> &tree, std::string action) {
+template <typename T, typename N>
+void logAndWait(int element, tree::BinarySearchTree<T, N> &tree, std::string action) {
 	std::cout << "=========> " << action << " element " << element << std::endl;
 	std::cout << tree.toString() << std::endl;
 	system("read");
@@ -25,7 +26,7 @@ int main() {
 	tree::BinarySearchTree<int> binaryTree = tree::BinarySearchTree<int>();
 
 	binaryTree.insertNode(new Node<int>(5));
-	binaryTree.insertNode(new ExtendedNode<int, int>(9, 9));
+	binaryTree.insertNode(new Node<int>(9));
 	binaryTree.insertNode(new Node<int>(3));
 	binaryTree.insertNode(new Node<int>(1));
 	binaryTree.insertNode(new Node<int>(6));
@@ -61,6 +62,13 @@ int main() {
 	}
 	std::cout << std::endl;
 
+	std::cout << std::endl << "RANGE [1, 6): ";
+	for (tree::BinarySearchTree<int>::const_iterator it = binaryTree.lower_bound(
+			1); it != binaryTree.lower_bound(6); ++it) {
+		std::cout << *it << " ";
+	}
+	std::cout << std::endl;
+
 	std::cout << "Remove element 5" << std::endl;
 	binaryTree.deleteNode(5);
 	std::cout << binaryTree.toString() << std::endl;
@@ -83,46 +91,65 @@ int main() {
 	Node<int>* three = binaryTree.search(3);
 	assert(three == nullptr);
 
-	tree::AVLTree<int> avlTree = tree::AVLTree<int>();
+	// The nodes of this tree keep a value beside the key
+	typedef AVLNode<ExtendedNode<int, int>> ValueNode;
+	tree::AVLTree<int, ValueNode> avlTree = tree::AVLTree<int, ValueNode>();
 
-	avlTree.insertNode(new Node<int>(1));
+	avlTree.insertNode(new ValueNode(1, 1));
 	logAndWait(1, avlTree, "insert");
 
-	avlTree.insertNode(new ExtendedNode<int, int>(2, 2));
+	avlTree.insertNode(new ValueNode(2, 2));
 	logAndWait(2, avlTree, "insert");
 
-	avlTree.insertNode(new Node<int>(3));
+	avlTree.insertNode(new ValueNode(3, 3));
 	logAndWait(3, avlTree, "insert");
 
-	// Try to insert again the 2 => no effect
+	// Try to insert again the 2 => no effect (the tree is searched before
+	// creating any node)
 
-	avlTree.insertNode(new Node<int>(2));
+	avlTree.insert(2);
 	logAndWait(2, avlTree, "insert");
 
-	avlTree.insertNode(new Node<int>(7));
+	avlTree.insertNode(new ValueNode(7, 7));
 	logAndWait(7, avlTree, "insert");
 
-	avlTree.insertNode(new Node<int>(6));
+	avlTree.insertNode(new ValueNode(6, 6));
 	logAndWait(6, avlTree, "insert");
 
-	avlTree.insertNode(new Node<int>(14));
+	avlTree.insertNode(new ValueNode(14, 14));
 	logAndWait(14, avlTree, "insert");
 
-	avlTree.insertNode(new Node<int>(4));
+	avlTree.insertNode(new ValueNode(4, 4));
 	logAndWait(4, avlTree, "insert");
 
-	avlTree.insertNode(new Node<int>(0));
+	avlTree.insertNode(new ValueNode(0, 0));
 	logAndWait(0, avlTree, "insert");
 
-	avlTree.insertNode(new Node<int>(15));
+	avlTree.insertNode(new ValueNode(15, 15));
 	logAndWait(15, avlTree, "insert");
 
-	avlTree.insertNode(new Node<int>(5));
+	avlTree.insertNode(new ValueNode(5, 5));
 	logAndWait(5, avlTree, "insert");
 
 	avlTree.deleteNode(6);
 	logAndWait(6, avlTree, "delete");
 
+	ValueNode* seven = avlTree.search(7);
+	assert((seven != nullptr) && (seven->value == 7));
+
+	// A chain written by a BinarySearchTree is balanced when an AVLTree reads it
+	tree::BinarySearchTree<int> chain;
+	for (int i = 0; i < 1000; ++i)
+		chain.insert(i);
+	std::stringstream stream;
+	assert(chain.serialize(stream));
+	tree::AVLTree<int> balanced;
+	assert(balanced.deserialize(stream));
+	assert((balanced.size() == 1000) && (balanced.getHeight() <= 10));
+	for (int i = 1000; i < 1100; ++i)
+		balanced.insert(i);
+	assert(balanced.getHeight() <= 11);
+
 	return 0;
 }
 
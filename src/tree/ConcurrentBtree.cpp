@@ -0,0 +1,440 @@
+/**
+ * @file ConcurrentBtree.cpp
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#include "ConcurrentBtree.h"
+
+#include <algorithm>
+
+namespace tree {
+
+template<typename T, unsigned short Degree>
+ConcurrentBtree<T, Degree>::ConcurrentBtree(
+		std::pmr::memory_resource* resource) :
+		root(nullptr), pool(resource), retired() {
+	// The root is never null, so that there is always a node to lock
+	this->root.store(createNode(true));
+}
+
+template<typename T, unsigned short Degree>
+ConcurrentBtree<T, Degree>::~ConcurrentBtree() {
+	pool.release();
+}
+
+template<typename T, unsigned short Degree>
+void ConcurrentBtree<T, Degree>::clear() {
+	// Keys are trivially copyable (and so trivially destructible): node memory
+	// goes back to the memory resource slab by slab, retired nodes included
+	this->retired.clear();
+	pool.release();
+	this->root.store(createNode(true));
+}
+
+template<typename T, unsigned short Degree>
+typename ConcurrentBtree<T, Degree>::NodeType* ConcurrentBtree<T, Degree>::createNode(
+		bool leaf) {
+	std::lock_guard<std::mutex> guard(poolMutex);
+	return pool.create(leaf);
+}
+
+template<typename T, unsigned short Degree>
+typename ConcurrentBtree<T, Degree>::NodeType* ConcurrentBtree<T, Degree>::readRoot(
+		uint64_t& version) const {
+	NodeType* node = this->root.load(std::memory_order_acquire);
+	if (!node->lock.readLock(version)
+			|| (node != this->root.load(std::memory_order_acquire)))
+		return nullptr;
+	return node;
+}
+
+template<typename T, unsigned short Degree>
+bool ConcurrentBtree<T, Degree>::search(const T& key, T& value) const {
+	EpochGuard guard;
+	for (;;) {
+		uint64_t version;
+		NodeType* node = readRoot(version);
+		while (node != nullptr) {
+			// The node may be changing while it is read: nothing read from it is
+			// used until its version has been checked
+			unsigned short count = node->count;
+			size_t pos = rankInNode(node->keys, count, key);
+			bool found = (pos < count) && (node->keys[pos] == key);
+			T result = found ? node->values[pos] : T();
+			NodeType* child = node->leaf ? nullptr : node->children[pos];
+			if (!node->lock.validate(version))
+				break;
+			if (found) {
+				value = result;
+				return true;
+			}
+			if (child == nullptr)
+				return false;
+			// Lock coupling: the child is valid if the parent has not changed
+			// after taking the version of the child
+			uint64_t childVersion;
+			if (!child->lock.readLock(childVersion)
+					|| !node->lock.validate(version))
+				break;
+			node = child;
+			version = childVersion;
+		}
+	}
+}
+
+template<typename T, unsigned short Degree>
+bool ConcurrentBtree<T, Degree>::contains(const T& key) const {
+	T value;
+	return search(key, value);
+}
+
+template<typename T, unsigned short Degree>
+bool ConcurrentBtree<T, Degree>::insert(const T& key, const T& value) {
+	EpochGuard guard;
+	for (;;) {
+		uint64_t version;
+		NodeType* node = readRoot(version);
+		NodeType* parent = nullptr;
+		uint64_t parentVersion = 0;
+		while (node != nullptr) {
+			unsigned short count = node->count;
+			bool leaf = node->leaf;
+			if (!node->lock.validate(version))
+				break;
+
+			// 1. The node is full => split it (locking it and its parent) and
+			//    start again. The parent is not full, as it was checked on the way
+			//    down and it has not changed if it can be locked
+			if (count == NodeType::MAX_KEYS) {
+				if ((parent != nullptr) && !parent->lock.upgrade(parentVersion))
+					break;
+				if (!node->lock.upgrade(version)) {
+					if (parent != nullptr)
+						parent->lock.unlock();
+					break;
+				}
+				splitNode(node, parent);
+				node->lock.unlock();
+				if (parent != nullptr)
+					parent->lock.unlock();
+				break;
+			}
+
+			size_t pos = rankInNode(node->keys, count, key);
+			bool found = (pos < count) && (node->keys[pos] == key);
+			NodeType* child = leaf ? nullptr : node->children[pos];
+			if (!node->lock.validate(version))
+				break;
+			// 2. The key already exists
+			if (found)
+				return false;
+			// 3. The node is a leaf => lock it and insert the key in its sorted
+			//    place (nothing read before has changed if it can be locked)
+			if (leaf) {
+				if (!node->lock.upgrade(version))
+					break;
+				shiftRight(node->keys, pos, count);
+				shiftRight(node->values, pos, count);
+				node->keys[pos] = key;
+				node->values[pos] = value;
+				++node->count;
+				node->lock.unlock();
+				return true;
+			}
+			// 4. Go down
+			uint64_t childVersion;
+			if (!child->lock.readLock(childVersion)
+					|| !node->lock.validate(version))
+				break;
+			parent = node;
+			parentVersion = version;
+			node = child;
+			version = childVersion;
+		}
+	}
+}
+
+template<typename T, unsigned short Degree>
+void ConcurrentBtree<T, Degree>::splitNode(NodeType* node, NodeType* parent) {
+	NodeType* right = createNode(node->leaf);
+	T midKey = node->keys[Degree - 1];
+	T midValue = node->values[Degree - 1];
+	std::copy(node->keys + Degree, node->keys + NodeType::MAX_KEYS, right->keys);
+	std::copy(node->values + Degree, node->values + NodeType::MAX_KEYS,
+			right->values);
+	if (!node->leaf)
+		std::copy(node->children + Degree,
+				node->children + NodeType::MAX_KEYS + 1, right->children);
+	right->count = Degree - 1;
+	node->count = Degree - 1;
+
+	if (parent == nullptr) {
+		// The node is the root (it cannot have changed, as it is locked) => the
+		// tree grows from the top
+		NodeType* newRoot = createNode(false);
+		newRoot->keys[0] = midKey;
+		newRoot->values[0] = midValue;
+		newRoot->children[0] = node;
+		newRoot->children[1] = right;
+		newRoot->count = 1;
+		this->root.store(newRoot, std::memory_order_release);
+		return;
+	}
+	size_t pos = rankInNode(parent->keys, parent->count, midKey);
+	shiftRight(parent->keys, pos, parent->count);
+	shiftRight(parent->values, pos, parent->count);
+	shiftRight(parent->children, pos + 1, parent->count + 1);
+	parent->keys[pos] = midKey;
+	parent->values[pos] = midValue;
+	parent->children[pos + 1] = right;
+	++parent->count;
+}
+
+template<typename T, unsigned short Degree>
+bool ConcurrentBtree<T, Degree>::remove(const T& key) {
+	EpochGuard guard;
+	for (;;) {
+		uint64_t version;
+		NodeType* node = readRoot(version);
+		// Internal node where the key has been found, if any. The key is then
+		// replaced by its predecessor, which is removed from its leaf
+		NodeType* holder = nullptr;
+		uint64_t holderVersion = 0;
+		size_t holderPos = 0;
+		while (node != nullptr) {
+			unsigned short count = node->count;
+			bool leaf = node->leaf;
+			size_t pos = count;
+			bool found = false;
+			if (holder == nullptr) {
+				pos = rankInNode(node->keys, count, key);
+				found = (pos < count) && (node->keys[pos] == key);
+			}
+			if (!node->lock.validate(version))
+				break;
+
+			// 1. The node is a leaf. Going down, we have ensured that it has at
+			//    least Degree keys (unless it is the root), so it can lose one
+			if (leaf) {
+				if (holder != nullptr) {
+					// Predecessor of the key (the maximum of the left subtree)
+					if (!holder->lock.upgrade(holderVersion))
+						break;
+					if (!node->lock.upgrade(version)) {
+						holder->lock.unlock();
+						break;
+					}
+					holder->keys[holderPos] = node->keys[count - 1];
+					holder->values[holderPos] = node->values[count - 1];
+					--node->count;
+					node->lock.unlock();
+					holder->lock.unlock();
+					return true;
+				}
+				if (!found)
+					return false;
+				if (!node->lock.upgrade(version))
+					break;
+				shiftLeft(node->keys, pos, count);
+				shiftLeft(node->values, pos, count);
+				--node->count;
+				node->lock.unlock();
+				return true;
+			}
+
+			// 2. The key is in this internal node => look for its predecessor:
+			//    go down the left child and then always to the rightmost child
+			if (found) {
+				holder = node;
+				holderVersion = version;
+				holderPos = pos;
+			}
+
+			// 3. Make sure the child we go down into has at least Degree keys
+			//    before going down. Otherwise, refill it and start again
+			NodeType* child = node->children[pos];
+			uint64_t childVersion;
+			if (!node->lock.validate(version)
+					|| !child->lock.readLock(childVersion)
+					|| !node->lock.validate(version))
+				break;
+			unsigned short childCount = child->count;
+			if (!child->lock.validate(childVersion))
+				break;
+			if (childCount < Degree) {
+				refillChild(node, version, pos, child, childVersion);
+				break;
+			}
+			node = child;
+			version = childVersion;
+		}
+	}
+}
+
+template<typename T, unsigned short Degree>
+void ConcurrentBtree<T, Degree>::refillChild(NodeType* node, uint64_t version,
+		size_t pos, NodeType* child, uint64_t childVersion) {
+	if (!node->lock.upgrade(version))
+		return;
+	if (!child->lock.upgrade(childVersion)) {
+		node->lock.unlock();
+		return;
+	}
+	NodeType* left = (pos > 0) ? node->children[pos - 1] : nullptr;
+	NodeType* right = (pos < node->count) ? node->children[pos + 1] : nullptr;
+	bool leftLocked = (left == nullptr) || left->lock.tryLock();
+	bool rightLocked = (right == nullptr) || right->lock.tryLock();
+	if (!leftLocked || !rightLocked) {
+		if ((left != nullptr) && leftLocked)
+			left->lock.unlock();
+		if ((right != nullptr) && rightLocked)
+			right->lock.unlock();
+		child->lock.unlock();
+		node->lock.unlock();
+		return;
+	}
+
+	// 1. A sibling node has >= Degree keys => borrow one key through the parent
+	NodeType* merged = nullptr;
+	if ((left != nullptr) && (left->count >= Degree)) {
+		rotateFromLeft(node, pos);
+	} else if ((right != nullptr) && (right->count >= Degree)) {
+		rotateFromRight(node, pos);
+	}
+	// 2. Both siblings have Degree-1 keys => merge with one of them. The node
+	//    on the right is unlinked, and readers which reach it start again
+	else if (right != nullptr) {
+		mergeChildren(node, pos);
+		right->lock.unlockObsolete();
+		merged = right;
+		right = nullptr;
+	} else {
+		mergeChildren(node, pos - 1);
+		child->lock.unlockObsolete();
+		merged = child;
+		child = nullptr;
+	}
+	if (left != nullptr)
+		left->lock.unlock();
+	if (right != nullptr)
+		right->lock.unlock();
+	if (child != nullptr)
+		child->lock.unlock();
+
+	// The node has at least Degree keys unless it is the root, so only the root
+	// may have been left empty after a merge => the tree shrinks
+	if (node->count == 0) {
+		this->root.store(node->children[0], std::memory_order_release);
+		node->lock.unlockObsolete();
+		retire(node);
+	} else {
+		node->lock.unlock();
+	}
+	if (merged != nullptr)
+		retire(merged);
+}
+
+template<typename T, unsigned short Degree>
+void ConcurrentBtree<T, Degree>::rotateFromLeft(NodeType* parent, size_t pos) {
+	NodeType* s = parent->children[pos - 1];
+	NodeType* t = parent->children[pos];
+	shiftRight(t->keys, 0, t->count);
+	shiftRight(t->values, 0, t->count);
+	t->keys[0] = parent->keys[pos - 1];
+	t->values[0] = parent->values[pos - 1];
+	if (!t->leaf) {
+		shiftRight(t->children, 0, t->count + 1);
+		t->children[0] = s->children[s->count];
+	}
+	parent->keys[pos - 1] = s->keys[s->count - 1];
+	parent->values[pos - 1] = s->values[s->count - 1];
+	++t->count;
+	--s->count;
+}
+
+template<typename T, unsigned short Degree>
+void ConcurrentBtree<T, Degree>::rotateFromRight(NodeType* parent,
+		size_t pos) {
+	NodeType* t = parent->children[pos];
+	NodeType* s = parent->children[pos + 1];
+	t->keys[t->count] = parent->keys[pos];
+	t->values[t->count] = parent->values[pos];
+	if (!t->leaf) {
+		t->children[t->count + 1] = s->children[0];
+		shiftLeft(s->children, 0, s->count + 1);
+	}
+	parent->keys[pos] = s->keys[0];
+	parent->values[pos] = s->values[0];
+	shiftLeft(s->keys, 0, s->count);
+	shiftLeft(s->values, 0, s->count);
+	++t->count;
+	--s->count;
+}
+
+template<typename T, unsigned short Degree>
+void ConcurrentBtree<T, Degree>::mergeChildren(NodeType* parent, size_t pos) {
+	NodeType* t = parent->children[pos];
+	NodeType* s = parent->children[pos + 1];
+	t->keys[t->count] = parent->keys[pos];
+	t->values[t->count] = parent->values[pos];
+	std::copy(s->keys, s->keys + s->count, t->keys + t->count + 1);
+	std::copy(s->values, s->values + s->count, t->values + t->count + 1);
+	if (!t->leaf)
+		std::copy(s->children, s->children + s->count + 1,
+				t->children + t->count + 1);
+	t->count += 1 + s->count;
+	shiftLeft(parent->keys, pos, parent->count);
+	shiftLeft(parent->values, pos, parent->count);
+	shiftLeft(parent->children, pos + 1, parent->count + 1);
+	--parent->count;
+}
+
+template<typename T, unsigned short Degree>
+void ConcurrentBtree<T, Degree>::retire(NodeType* node) {
+	// Operations which start from now on do not reach the node
+	uint64_t epoch = EpochDomain::instance().retire();
+	std::lock_guard<std::mutex> guard(poolMutex);
+	this->retired.emplace_back(epoch, node);
+	if (this->retired.size() >= RECLAIM_BATCH)
+		reclaim();
+}
+
+template<typename T, unsigned short Degree>
+void ConcurrentBtree<T, Degree>::reclaim() {
+	// Nodes are retired by many writers at once, so the epochs are not sorted:
+	// every node is checked
+	uint64_t safe = EpochDomain::instance().safeEpoch();
+	std::deque<std::pair<uint64_t, NodeType*>> waiting;
+	for (const std::pair<uint64_t, NodeType*>& entry : this->retired) {
+		if (entry.first < safe)
+			pool.destroy(entry.second);
+		else
+			waiting.push_back(entry);
+	}
+	this->retired.swap(waiting);
+}
+
+template<typename T, unsigned short Degree>
+void ConcurrentBtree<T, Degree>::getInorder(std::list<T>& orderedList) const {
+	getInorder(this->root.load(), orderedList);
+}
+
+template<typename T, unsigned short Degree>
+void ConcurrentBtree<T, Degree>::getInorder(NodeType* root,
+		std::list<T>& orderedList) const {
+	size_t i = 0;
+	for (; i < root->count; ++i) {
+		if (!root->leaf)
+			getInorder(root->children[i], orderedList);
+		orderedList.push_back(root->keys[i]);
+	}
+	if (!root->leaf)
+		getInorder(root->children[i], orderedList);
+}
+
+template class ConcurrentBtree<int> ;
+template class ConcurrentBtree<float> ;
+template class ConcurrentBtree<double> ;
+
+} /* namespace tree */
@@ -0,0 +1,192 @@
+/**
+ * @file ConcurrentBtree.h
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#ifndef SRC_TREE_CONCURRENTBTREE_H_
+#define SRC_TREE_CONCURRENTBTREE_H_
+
+#include "BNode.h"
+#include "EpochReclamation.h"
+#include "NodePool.h"
+#include "NodeSearch.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory_resource>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+namespace tree {
+
+/**
+ * This class implements a b-tree which can be used by many threads at once, with
+ * optimistic lock coupling. Every node has a version latch (see OptimisticLock):
+ * - Lookups take no locks. They check the version of each node after reading it,
+ *   and start again from the root if it has changed.
+ * - Writers go down the same way, and they only lock the nodes they change: the
+ *   node where a key is added or removed, the nodes which are split (and their
+ *   parent) and the nodes which are merged or lend a key (and their parent). As
+ *   in Btree, full nodes are split and thin nodes are refilled on the way down, so
+ *   a change never goes back up the tree.
+ * Readers may read a node while it is being changed (and then discard what they
+ * read), so keys and values must be trivially copyable. Nodes which are unlinked
+ * from the tree (merged siblings and old roots) may still be read by operations
+ * which reached them before, so they are retired and reused once those are done
+ * (see EpochReclamation.h): every operation goes along the tree within an
+ * EpochGuard.
+ * NOTE: the tree is instantiated in ConcurrentBtree.cpp for int, float and
+ * double, with nodes of BNODE_DEFAULT_SIZE bytes.
+ */
+template<typename T, unsigned short Degree = bnodeDegree<T>(BNODE_DEFAULT_SIZE)>
+class ConcurrentBtree {
+	static_assert(std::is_trivially_copyable<T>::value,
+			"Concurrent b-tree keys must be trivially copyable");
+public:
+	typedef ConcurrentBNode<T, Degree> NodeType;
+
+	/**
+	 * Class constructor
+	 * @param[in] resource: memory resource backing the nodes
+	 */
+	explicit ConcurrentBtree(std::pmr::memory_resource* resource =
+			std::pmr::get_default_resource());
+	/**
+	 * Class destructor
+	 */
+	virtual ~ConcurrentBtree();
+	ConcurrentBtree(const ConcurrentBtree&) = delete;
+	ConcurrentBtree& operator=(const ConcurrentBtree&) = delete;
+	/**
+	 * Remove all the elements from the tree. It must not run concurrently with
+	 * any other operation
+	 */
+	void clear();
+	/**
+	 * Search a given key in the tree
+	 * @param[in] key Key to find
+	 * @param[out] value Value associated to the key (if it is found)
+	 * @return Returns whether the key is in the tree
+	 */
+	bool search(const T& key, T& value) const;
+	/**
+	 * Verifies whether a key is in the tree
+	 * @param[in] key Key to find
+	 * @return Returns true if the key is in the tree
+	 */
+	bool contains(const T& key) const;
+	/**
+	 * Insert an element into the tree (if it does not exist yet)
+	 * @param[in] key	Key to add to the tree
+	 * @param[in] value	Value associated to the key
+	 * @return Returns whether the element has been inserted or not
+	 */
+	bool insert(const T& key, const T& value);
+	/**
+	 * Removes an element from the tree (if exists)
+	 * @param[in] key 	Key to remove
+	 * @return 	Returns whether the element has been removed or not
+	 */
+	bool remove(const T& key);
+	/**
+	 * Go along the tree in an in-order order. It must not run concurrently with
+	 * any change in the tree
+	 * @param[out] orderedList List in an in-order order
+	 */
+	void getInorder(std::list<T>& orderedList) const;
+private:
+	/**
+	 * Number of unlinked nodes which are waiting before trying to free them
+	 */
+	static const size_t RECLAIM_BATCH = 128;
+
+	/**
+	 * Go along the tree in an in-order order.
+	 * @param[in] root Root node
+	 * @param[out] orderedList List in an in-order order
+	 */
+	void getInorder(NodeType* root, std::list<T>& orderedList) const;
+	/**
+	 * Create an empty node in the node pool
+	 * @param[in] leaf Whether the node is a leaf node
+	 * @return Returns the new node
+	 */
+	NodeType* createNode(bool leaf);
+	/**
+	 * Get the root node and its version
+	 * @param[out] version Version of the root
+	 * @return Returns the root, or nullptr if it has changed while reading it
+	 */
+	NodeType* readRoot(uint64_t& version) const;
+	/**
+	 * Split a full node in two halves. The mid key goes up to the parent, or to a
+	 * new root if the node is the root. Both nodes must be locked
+	 * @param[in|out] node Node to split
+	 * @param[in|out] parent Parent of the node (which is not full), or nullptr
+	 */
+	void splitNode(NodeType* node, NodeType* parent);
+	/**
+	 * Make a child with the minimum number of keys have one more, by borrowing a
+	 * key from a sibling or by merging it with a sibling. The node, the child and
+	 * its siblings are locked while doing so; if any of them cannot be locked,
+	 * nothing is done (the caller starts again anyway)
+	 * @param[in|out] node Parent node
+	 * @param[in] version Version of the parent, as read by the caller
+	 * @param[in] pos Position of the child
+	 * @param[in|out] child Child to refill
+	 * @param[in] childVersion Version of the child, as read by the caller
+	 */
+	void refillChild(NodeType* node, uint64_t version, size_t pos,
+			NodeType* child, uint64_t childVersion);
+	/**
+	 * Move the last key of the left sibling of a child up to the parent, and
+	 * the parent key down to the child
+	 * @param[in|out] parent Parent node
+	 * @param[in] pos Position of the child
+	 */
+	void rotateFromLeft(NodeType* parent, size_t pos);
+	/**
+	 * Move the first key of the right sibling of a child up to the parent, and
+	 * the parent key down to the child
+	 * @param[in|out] parent Parent node
+	 * @param[in] pos Position of the child
+	 */
+	void rotateFromRight(NodeType* parent, size_t pos);
+	/**
+	 * Merge a child with its right sibling and the parent key between them. The
+	 * right sibling is unlinked from the tree
+	 * @param[in|out] parent Parent node
+	 * @param[in] pos Position of the (left) child
+	 */
+	void mergeChildren(NodeType* parent, size_t pos);
+	/**
+	 * Free a node unlinked from the tree once no operation can be reading it
+	 * @param[in] node Node which has been unlinked
+	 */
+	void retire(NodeType* node);
+	/**
+	 * Destroy the retired nodes which no operation can be reading any more. The
+	 * pool mutex must be held
+	 */
+	void reclaim();
+
+	std::atomic<NodeType*> root;
+	NodePool<NodeType> pool;
+	/**
+	 * Lock of the node pool and of the retired nodes
+	 */
+	std::mutex poolMutex;
+	/**
+	 * Nodes unlinked from the tree, with the epoch they were retired at
+	 */
+	std::deque<std::pair<uint64_t, NodeType*>> retired;
+};
+
+} /* namespace tree */
+
+#endif /* SRC_TREE_CONCURRENTBTREE_H_ */
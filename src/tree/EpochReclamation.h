@@ -0,0 +1,177 @@
+/**
+ * @file EpochReclamation.h
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#ifndef SRC_TREE_EPOCHRECLAMATION_H_
+#define SRC_TREE_EPOCHRECLAMATION_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <thread>
+
+namespace tree {
+
+/**
+ * This class implements epoch-based reclamation, so that memory which readers may
+ * still be reading without locks is freed only once they are done:
+ * - A reader announces the epoch it starts at in a slot of its own (see
+ *   EpochGuard), and clears it when it is done. That is all readers do, so they
+ *   never wait for anything.
+ * - A writer which unlinks some memory tags it with the current epoch (see
+ *   retire), and moves the epoch forward. The memory can be freed once every
+ *   reader which is still running started at a later epoch (see safeEpoch).
+ * There is a single domain for the whole process, shared by all the structures
+ * which use it. Every thread takes a slot at its first read and keeps it until it
+ * finishes; up to MAX_READERS threads can read at once (more threads wait for a
+ * slot at their first read).
+ */
+class EpochDomain {
+public:
+	/**
+	 * Maximum number of threads with a slot at once
+	 */
+	static constexpr size_t MAX_READERS = 256;
+	/**
+	 * Value of the slot of a thread which is not reading
+	 */
+	static constexpr uint64_t IDLE = std::numeric_limits<uint64_t>::max();
+
+	EpochDomain(const EpochDomain&) = delete;
+	EpochDomain& operator=(const EpochDomain&) = delete;
+	/**
+	 * Get the domain of the process
+	 * @return Epoch domain
+	 */
+	static EpochDomain& instance() {
+		static EpochDomain domain;
+		return domain;
+	}
+	/**
+	 * Move the epoch forward once some memory has been unlinked. Readers which
+	 * start after this do not reach that memory
+	 * @return Returns the epoch the unlinked memory must be tagged with
+	 */
+	uint64_t retire() {
+		return epoch.fetch_add(1, std::memory_order_seq_cst);
+	}
+	/**
+	 * Get the lowest epoch which may still be in use by a reader
+	 * @return Memory tagged with a lower epoch can be freed
+	 */
+	uint64_t safeEpoch() const {
+		uint64_t safe = epoch.load(std::memory_order_seq_cst);
+		size_t used = highWater.load(std::memory_order_seq_cst);
+		for (size_t i = 0; i < used; ++i)
+			safe = std::min(safe, slots[i].epoch.load(std::memory_order_seq_cst));
+		return safe;
+	}
+	/**
+	 * Announce that the calling thread starts reading. Read sections can be
+	 * nested: only the outer one is announced
+	 */
+	void enter() {
+		Slot& slot = threadSlot();
+		if (slot.depth++ == 0)
+			slot.epoch.store(epoch.load(std::memory_order_acquire),
+					std::memory_order_seq_cst);
+	}
+	/**
+	 * Announce that the calling thread is done reading
+	 */
+	void leave() {
+		Slot& slot = threadSlot();
+		if (--slot.depth == 0)
+			slot.epoch.store(IDLE, std::memory_order_release);
+	}
+private:
+	/**
+	 * Slot of a thread, in a cache line of its own
+	 */
+	struct alignas(64) Slot {
+		std::atomic<uint64_t> epoch;
+		std::atomic<bool> taken;
+		// Nesting of the read sections of the owner (only used by the owner)
+		size_t depth;
+	};
+	/**
+	 * Holder of the slot of a thread, which gives it back when the thread finishes
+	 */
+	struct SlotHolder {
+		Slot* slot;
+		SlotHolder() :
+				slot(instance().claim()) {
+		}
+		~SlotHolder() {
+			slot->taken.store(false, std::memory_order_release);
+		}
+	};
+
+	EpochDomain() :
+			epoch(0), highWater(0) {
+		for (Slot& slot : slots) {
+			slot.epoch.store(IDLE, std::memory_order_relaxed);
+			slot.taken.store(false, std::memory_order_relaxed);
+			slot.depth = 0;
+		}
+	}
+	/**
+	 * Get the slot of the calling thread
+	 * @return Slot of the thread
+	 */
+	Slot& threadSlot() {
+		thread_local SlotHolder holder;
+		return *(holder.slot);
+	}
+	/**
+	 * Take a free slot, waiting for one if all of them are taken
+	 * @return Slot taken
+	 */
+	Slot* claim() {
+		for (;;) {
+			for (size_t i = 0; i < MAX_READERS; ++i) {
+				bool taken = false;
+				if (!slots[i].taken.load(std::memory_order_relaxed)
+						&& slots[i].taken.compare_exchange_strong(taken, true,
+								std::memory_order_acquire)) {
+					size_t used = highWater.load(std::memory_order_relaxed);
+					while ((used < i + 1)
+							&& !highWater.compare_exchange_weak(used, i + 1,
+									std::memory_order_seq_cst))
+						;
+					return &(slots[i]);
+				}
+			}
+			std::this_thread::yield();
+		}
+	}
+
+	std::atomic<uint64_t> epoch;
+	// Number of slots which have ever been taken (writers only check those)
+	std::atomic<size_t> highWater;
+	Slot slots[MAX_READERS];
+};
+
+/**
+ * Read section of the calling thread: the memory it reaches while the guard is
+ * alive is not freed
+ */
+class EpochGuard {
+public:
+	EpochGuard() {
+		EpochDomain::instance().enter();
+	}
+	~EpochGuard() {
+		EpochDomain::instance().leave();
+	}
+	EpochGuard(const EpochGuard&) = delete;
+	EpochGuard& operator=(const EpochGuard&) = delete;
+};
+
+} /* namespace tree */
+
+#endif /* SRC_TREE_EPOCHRECLAMATION_H_ */
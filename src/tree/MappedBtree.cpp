@@ -0,0 +1,280 @@
+/**
+ * @file MappedBtree.cpp
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#include "MappedBtree.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tree {
+
+/**
+ * First bytes of every page file
+ */
+static const char PAGE_FILE_MAGIC[8] = { 'B', 'T', 'R', 'E', 'E', 'P', 'G', 'F' };
+
+/**
+ * Write a block to a file, followed by zeros up to the size of a page
+ * @param[in] file File to write to
+ * @param[in] data Block to write
+ * @param[in] size Size of the block
+ * @param[in] pageSize Size of a page
+ * @return Returns whether the page has been written
+ */
+static bool writePage(std::FILE* file, const void* data, size_t size,
+		size_t pageSize) {
+	static const unsigned char zeros[BNODE_PAGE_SIZE] = { };
+	if (std::fwrite(data, size, 1, file) != 1)
+		return false;
+	for (size_t padding = pageSize - size; padding > 0;) {
+		size_t chunk = std::min(padding, sizeof(zeros));
+		if (std::fwrite(zeros, chunk, 1, file) != 1)
+			return false;
+		padding -= chunk;
+	}
+	return true;
+}
+
+template<typename T, unsigned short Degree>
+MappedBtree<T, Degree>::MappedBtree() :
+		base(nullptr), length(0) {
+}
+
+template<typename T, unsigned short Degree>
+MappedBtree<T, Degree>::~MappedBtree() {
+	close();
+}
+
+template<typename T, unsigned short Degree>
+bool MappedBtree<T, Degree>::writeSorted(const std::vector<T>& keys,
+		const std::vector<T>& values, const std::string& path) {
+	std::FILE* file = std::fopen(path.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+	Header header;
+	std::memset(&header, 0, sizeof(header));
+	bool written = writePage(file, &header, sizeof(header), PAGE_SIZE);
+
+	// The tree is as high as the lowest one whose full pages can hold every key
+	std::vector<uint64_t> capacity(1, 0);
+	while (capacity.back() < keys.size())
+		capacity.push_back(capacity.back() * (PageType::MAX_KEYS + 1)
+				+ PageType::MAX_KEYS);
+	header.height = capacity.size() - 1;
+
+	// Pages are written level by level (breadth first): the children of a page
+	// take the next free page numbers, in the order their keys are queued
+	struct Block {
+		size_t first;
+		size_t count;
+		uint32_t height;
+	};
+	std::vector<Block> queue;
+	if (!keys.empty())
+		queue.push_back(Block { 0, keys.size(), header.height });
+	PageType page;
+	for (size_t i = 0; written && (i < queue.size()); ++i) {
+		Block block = queue[i];
+		std::memset(&page, 0, sizeof(page));
+		page.leaf = (block.height == 1);
+		if (page.leaf) {
+			page.count = block.count;
+			std::copy(keys.begin() + block.first,
+					keys.begin() + block.first + block.count, page.keys);
+			std::copy(values.begin() + block.first,
+					values.begin() + block.first + block.count, page.values);
+		} else {
+			// Children more than half full (d > 1) => none of them is empty, and
+			// the ones of the next level have at least two children as well
+			uint64_t below = capacity[block.height - 1];
+			size_t children = (block.count + below + 1) / (below + 1);
+			size_t inChildren = block.count - (children - 1);
+			size_t first = block.first;
+			page.count = children - 1;
+			for (size_t j = 0; j < children; ++j) {
+				size_t count = inChildren / children
+						+ ((j < inChildren % children) ? 1 : 0);
+				page.children[j] = queue.size() + 1;
+				queue.push_back(Block { first, count, block.height - 1 });
+				first += count;
+				if (j < page.count) {
+					page.keys[j] = keys[first];
+					page.values[j] = values[first];
+					++first;
+				}
+			}
+		}
+		written = writePage(file, &page, sizeof(page), PAGE_SIZE);
+	}
+
+	// The header goes last, once the nodes are on the disk
+	std::memcpy(header.magic, PAGE_FILE_MAGIC, sizeof(header.magic));
+	header.version = FORMAT_VERSION;
+	header.pageSize = PAGE_SIZE;
+	header.keySize = sizeof(T);
+	header.keyKind = KEY_KIND;
+	header.degree = Degree;
+	header.root = queue.empty() ? 0 : 1;
+	header.pages = queue.size() + 1;
+	header.count = keys.size();
+	written = written && (std::fflush(file) == 0) && (fsync(fileno(file)) == 0)
+			&& (std::fseek(file, 0, SEEK_SET) == 0)
+			&& writePage(file, &header, sizeof(header), PAGE_SIZE)
+			&& (std::fflush(file) == 0) && (fsync(fileno(file)) == 0);
+	return (std::fclose(file) == 0) && written;
+}
+
+template<typename T, unsigned short Degree>
+bool MappedBtree<T, Degree>::open(const std::string& path) {
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat status;
+	if ((fstat(fd, &status) != 0)
+			|| (static_cast<size_t>(status.st_size) < PAGE_SIZE)) {
+		::close(fd);
+		return false;
+	}
+	size_t size = status.st_size;
+	void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	// The mapping keeps the file open
+	::close(fd);
+	if (mapping == MAP_FAILED)
+		return false;
+
+	const Header* h = static_cast<const Header*>(mapping);
+	bool valid = (std::memcmp(h->magic, PAGE_FILE_MAGIC, sizeof(h->magic)) == 0)
+			&& (h->version == FORMAT_VERSION) && (h->pageSize == PAGE_SIZE)
+			&& (h->keySize == sizeof(T)) && (h->keyKind == KEY_KIND)
+			&& (h->degree == Degree)
+			&& (h->pages <= size / PAGE_SIZE) && (h->root < h->pages)
+			&& (h->height <= const_iterator::MAX_DEPTH);
+	if (!valid) {
+		munmap(mapping, size);
+		return false;
+	}
+	this->base = static_cast<const unsigned char*>(mapping);
+	this->length = size;
+	return true;
+}
+
+template<typename T, unsigned short Degree>
+void MappedBtree<T, Degree>::close() {
+	if (this->base == nullptr)
+		return;
+	munmap(const_cast<unsigned char*>(this->base), this->length);
+	this->base = nullptr;
+	this->length = 0;
+}
+
+template<typename T, unsigned short Degree>
+bool MappedBtree<T, Degree>::isOpen() const {
+	return this->base != nullptr;
+}
+
+template<typename T, unsigned short Degree>
+const T* MappedBtree<T, Degree>::search(const T& key) const {
+	if (!isOpen())
+		return nullptr;
+	// Children come from the file => going further down than the height of the
+	// tree means that they make a cycle
+	uint64_t id = header()->root;
+	for (uint32_t level = 0; id != 0; ++level) {
+		const PageType* node = page(id);
+		if ((node == nullptr) || (level == header()->height))
+			return nullptr;
+		size_t pos = rankInNode(node->keys, node->count, key);
+		if ((pos < node->count) && (node->keys[pos] == key))
+			return &(node->values[pos]);
+		id = node->leaf ? 0 : node->children[pos];
+	}
+	return nullptr;
+}
+
+template<typename T, unsigned short Degree>
+bool MappedBtree<T, Degree>::contains(const T& key) const {
+	return search(key) != nullptr;
+}
+
+template<typename T, unsigned short Degree>
+size_t MappedBtree<T, Degree>::size() const {
+	return isOpen() ? header()->count : 0;
+}
+
+template<typename T, unsigned short Degree>
+unsigned int MappedBtree<T, Degree>::getHeight() const {
+	return isOpen() ? header()->height : 0;
+}
+
+template<typename T, unsigned short Degree>
+typename MappedBtree<T, Degree>::const_iterator MappedBtree<T, Degree>::begin() const {
+	const_iterator it(this);
+	if (isOpen())
+		it.descendLeft(header()->root);
+	return it;
+}
+
+template<typename T, unsigned short Degree>
+typename MappedBtree<T, Degree>::const_iterator MappedBtree<T, Degree>::end() const {
+	return const_iterator(this);
+}
+
+template<typename T, unsigned short Degree>
+typename MappedBtree<T, Degree>::const_iterator MappedBtree<T, Degree>::lower_bound(
+		const T& key) const {
+	// Go down keeping the path, and remember the deepest level which has a key
+	// >= key: the path up to it is the path of the result (see Btree)
+	const_iterator it(this);
+	if (!isOpen())
+		return it;
+	size_t found = 0;
+	uint64_t id = header()->root;
+	while (id != 0) {
+		const PageType* node = page(id);
+		// A corrupted page or a cycle (see search)
+		if ((node == nullptr) || (it.depth == header()->height))
+			return end();
+		size_t pos = rankInNode(node->keys, node->count, key);
+		it.push(node, pos);
+		if (pos < node->count) {
+			found = it.depth;
+			if (node->keys[pos] == key)
+				break;
+		}
+		id = node->leaf ? 0 : node->children[pos];
+	}
+	it.depth = found;
+	return it;
+}
+
+template<typename T, unsigned short Degree>
+const typename MappedBtree<T, Degree>::PageType* MappedBtree<T, Degree>::page(
+		uint64_t id) const {
+	if ((id == 0) || (id >= header()->pages))
+		return nullptr;
+	const PageType* node = reinterpret_cast<const PageType*>(this->base
+			+ id * PAGE_SIZE);
+	return (node->count <= PageType::MAX_KEYS) ? node : nullptr;
+}
+
+template<typename T, unsigned short Degree>
+const typename MappedBtree<T, Degree>::Header* MappedBtree<T, Degree>::header() const {
+	return reinterpret_cast<const Header*>(this->base);
+}
+
+template class MappedBtree<int> ;
+template class MappedBtree<float> ;
+template class MappedBtree<double> ;
+
+} /* namespace tree */
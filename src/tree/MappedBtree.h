@@ -0,0 +1,327 @@
+/**
+ * @file MappedBtree.h
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#ifndef SRC_TREE_MAPPEDBTREE_H_
+#define SRC_TREE_MAPPEDBTREE_H_
+
+#include "BNode.h"
+#include "Btree.h"
+#include "NodeSearch.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace tree {
+
+/**
+ * This class reads a b-tree from a page file which is mapped in memory (mmap). The
+ * file is a sequence of pages of the same size: page 0 is a header, and every
+ * other page is a node (see BPage) whose children are page numbers. Lookups and
+ * iterators work straight on the mapping, so opening a file does not read it:
+ * pages are loaded by the operating system as they are touched, and they can be
+ * dropped again under memory pressure, so trees larger than the memory can be
+ * used. Nodes are written level by level, so the upper levels, which every lookup
+ * goes through, are packed together at the beginning of the file.
+ * Page files are written from a Btree of any degree (see write). They keep
+ * keys as they are in memory, so they can only be read on machines with the same
+ * byte order and type sizes. Only the header is checked when a file is opened:
+ * every other page is checked as it is visited, and a lookup or an iteration
+ * which reaches a page out of the file, a page with too many keys or a path
+ * longer than the height of the tree stops as if it found nothing.
+ * NOTE: the tree is instantiated in MappedBtree.cpp for int, float and double,
+ * with nodes of BNODE_PAGE_SIZE bytes.
+ */
+template<typename T, unsigned short Degree = bnodeDegree<T>(BNODE_PAGE_SIZE)>
+class MappedBtree {
+	static_assert(std::is_trivially_copyable<T>::value,
+			"Keys of a page file must be trivially copyable");
+public:
+	typedef BPage<T, Degree> PageType;
+	/**
+	 * Size of a page in the file: nodes take whole memory pages, so a node is
+	 * never split between two of them
+	 */
+	static constexpr size_t PAGE_SIZE = (sizeof(PageType) + BNODE_PAGE_SIZE - 1)
+			/ BNODE_PAGE_SIZE * BNODE_PAGE_SIZE;
+
+	/**
+	 * Forward iterator which goes along the tree in an in-order order, keeping the
+	 * path from the root to the current key (see Btree::const_iterator).
+	 * Iterators are invalidated when the file is closed.
+	 */
+	class const_iterator {
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef T value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const T* pointer;
+		typedef const T& reference;
+
+		const_iterator() :
+				tree(nullptr), depth(0) {
+		}
+		const_iterator(const const_iterator& other) :
+				tree(other.tree), depth(other.depth) {
+			std::copy(other.levels, other.levels + depth, levels);
+		}
+		const_iterator& operator=(const const_iterator& other) {
+			tree = other.tree;
+			depth = other.depth;
+			std::copy(other.levels, other.levels + depth, levels);
+			return *this;
+		}
+		reference operator*() const {
+			return top().node->keys[top().pos];
+		}
+		pointer operator->() const {
+			return &(top().node->keys[top().pos]);
+		}
+		/**
+		 * Get the value associated to the current key
+		 * @return Value of the current element
+		 */
+		const T& value() const {
+			return top().node->values[top().pos];
+		}
+		const_iterator& operator++() {
+			Level& current = top();
+			if (!current.node->leaf) {
+				// Go down to the minimum key on the right of the current one
+				++current.pos;
+				descendLeft(current.node->children[current.pos]);
+				return *this;
+			}
+			if (current.pos + 1u < current.node->count) {
+				++current.pos;
+				return *this;
+			}
+			// Go up until we come from a child which is not the last one
+			--depth;
+			while ((depth > 0) && (top().pos == top().node->count))
+				--depth;
+			return *this;
+		}
+		const_iterator operator++(int) {
+			const_iterator previous = *this;
+			++(*this);
+			return previous;
+		}
+		bool operator==(const const_iterator& other) const {
+			if ((depth == 0) || (other.depth == 0))
+				return depth == other.depth;
+			return (top().node == other.top().node)
+					&& (top().pos == other.top().pos);
+		}
+		bool operator!=(const const_iterator& other) const {
+			return !(*this == other);
+		}
+	private:
+		friend class MappedBtree<T, Degree>;
+		/**
+		 * Node and position at each level of the path (see Btree::const_iterator)
+		 */
+		struct Level {
+			const PageType* node;
+			size_t pos;
+		};
+		// A b-tree with 2^64 keys is at most 64 levels high (d >= 2)
+		static constexpr size_t MAX_DEPTH = 64;
+
+		explicit const_iterator(const MappedBtree<T, Degree>* tree) :
+				tree(tree), depth(0) {
+		}
+		Level& top() {
+			return levels[depth - 1];
+		}
+		const Level& top() const {
+			return levels[depth - 1];
+		}
+		void push(const PageType* node, size_t pos) {
+			levels[depth].node = node;
+			levels[depth].pos = pos;
+			++depth;
+		}
+		/**
+		 * Go down from a page to the minimum key of its subtree
+		 * @param[in] id Page of the root of the subtree
+		 */
+		void descendLeft(uint64_t id) {
+			while (id != 0) {
+				const PageType* node = tree->page(id);
+				// A corrupted page or a cycle ends the iteration
+				if ((node == nullptr) || (depth == tree->getHeight())) {
+					depth = 0;
+					return;
+				}
+				push(node, 0);
+				id = node->leaf ? 0 : node->children[0];
+			}
+		}
+		const MappedBtree<T, Degree>* tree;
+		size_t depth;
+		Level levels[MAX_DEPTH];
+	};
+	typedef const_iterator iterator;
+
+	/**
+	 * Class constructor. The tree is empty until a file is opened
+	 */
+	MappedBtree();
+	/**
+	 * Class destructor. It unmaps the file
+	 */
+	virtual ~MappedBtree();
+	MappedBtree(const MappedBtree&) = delete;
+	MappedBtree& operator=(const MappedBtree&) = delete;
+	/**
+	 * Write a b-tree to a page file. Its keys are blocked again into full pages of
+	 * the degree of this tree, so the degree of the b-tree does not matter (e.g.
+	 * MappedBtree<int>::write(Btree<int>(), path)). The header is written last, so
+	 * a file which has not been completely written is never opened
+	 * @param[in] tree Tree to write
+	 * @param[in] path Path of the file (it is replaced if it exists)
+	 * @return Returns whether the file has been written
+	 */
+	template<unsigned short SourceDegree>
+	static bool write(const Btree<T, T, std::less<T>, SourceDegree>& tree,
+			const std::string& path);
+	/**
+	 * Map a page file in memory (read-only), closing the current one. Nothing is
+	 * read but the header, which is checked against the type of the tree
+	 * @param[in] path Path of the file
+	 * @return Returns whether the file has been opened
+	 */
+	bool open(const std::string& path);
+	/**
+	 * Unmap the current file (if any)
+	 */
+	void close();
+	/**
+	 * Verifies whether a file is open
+	 * @return Returns true if a file is mapped
+	 */
+	bool isOpen() const;
+	/**
+	 * Look for the value associated to a key
+	 * @param[in] key Key to find
+	 * @return Returns the value in the mapping, or nullptr if the key is not found
+	 */
+	const T* search(const T& key) const;
+	/**
+	 * Verifies whether a key is in the tree
+	 * @param[in] key Key to find
+	 * @return Returns true if the key is in the tree
+	 */
+	bool contains(const T& key) const;
+	/**
+	 * Get the number of keys in the tree
+	 * @return Number of keys
+	 */
+	size_t size() const;
+	/**
+	 * Get the height of the tree
+	 * @return Height of the tree
+	 */
+	unsigned int getHeight() const;
+	/**
+	 * Get an iterator to the minimum key of the tree
+	 * @return Iterator to the first key in an in-order order
+	 */
+	const_iterator begin() const;
+	/**
+	 * Get an iterator past the maximum key of the tree
+	 * @return Iterator to the end of the tree
+	 */
+	const_iterator end() const;
+	/**
+	 * Get an iterator to the first key which is not lower than a given one
+	 * @param[in] key Key to compare with
+	 * @return Iterator to the first key >= key, or end() if there is none
+	 */
+	const_iterator lower_bound(const T& key) const;
+private:
+	/**
+	 * Page 0 of the file
+	 */
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t pageSize;
+		uint32_t keySize;
+		// Whether keys are floating-point (bit 0) and signed (bit 1)
+		uint32_t keyKind;
+		uint32_t degree;
+		uint32_t height;
+		uint64_t root;
+		uint64_t pages;
+		uint64_t count;
+	};
+	/**
+	 * Format of the files written by this version
+	 */
+	static const uint32_t FORMAT_VERSION = 1;
+	/**
+	 * Kind of the keys, so that keys of the same size are not taken for each other
+	 */
+	static constexpr uint32_t KEY_KIND = (std::is_floating_point<T>::value ? 1 : 0)
+			| (std::is_signed<T>::value ? 2 : 0);
+
+	/**
+	 * Write sorted entries to a page file (see write). Every level is built from
+	 * the top: a page has as few children as can hold its keys, and they share
+	 * them evenly, so every leaf is at the same depth
+	 * @param[in] keys Keys to write, in ascending order and without duplicates
+	 * @param[in] values Value of every key
+	 * @param[in] path Path of the file (it is replaced if it exists)
+	 * @return Returns whether the file has been written
+	 */
+	static bool writeSorted(const std::vector<T>& keys,
+			const std::vector<T>& values, const std::string& path);
+	/**
+	 * Get a node of the mapped file, checking the page number and the number of
+	 * keys which have been read from the file
+	 * @param[in] id Number of the page
+	 * @return Returns the node in the mapping, or nullptr if the page is not in the
+	 * file or it has more than MAX_KEYS keys
+	 */
+	const PageType* page(uint64_t id) const;
+	/**
+	 * Get the header of the mapped file
+	 * @return Returns the header in the mapping
+	 */
+	const Header* header() const;
+
+	/**
+	 * Beginning of the mapping (nullptr if no file is open)
+	 */
+	const unsigned char* base;
+	/**
+	 * Size of the mapping
+	 */
+	size_t length;
+};
+
+template<typename T, unsigned short Degree>
+template<unsigned short SourceDegree>
+bool MappedBtree<T, Degree>::write(
+		const Btree<T, T, std::less<T>, SourceDegree>& tree,
+		const std::string& path) {
+	std::vector<T> keys;
+	std::vector<T> values;
+	for (auto it = tree.begin(); it != tree.end(); ++it) {
+		keys.push_back(*it);
+		values.push_back(it.value());
+	}
+	return writeSorted(keys, values, path);
+}
+
+} /* namespace tree */
+
+#endif /* SRC_TREE_MAPPEDBTREE_H_ */
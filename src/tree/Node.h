@@ -7,36 +7,73 @@
 #ifndef SRC_TREE_NODE_H_
 #define SRC_TREE_NODE_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <type_traits>
+#include <utility>
 
 /**
- * This structure represents a node in the binary tree
+ * This structure represents a node in the binary tree. It has no virtual methods,
+ * so nodes carry no pointer to a virtual table: the type of the nodes of a tree is
+ * chosen at compile time (see BinarySearchTree) and they are always deleted as
+ * that type. A Node keeps only the children and the key, which go first so that
+ * a step down the tree reads a single cache line for small keys. The data which
+ * only some trees need is added by the layers below (SizedNode, AVLNode and
+ * RedBlackNode), which fill the padding after the key when there is room.
  */
 template<typename T>
 struct Node {
-	// Key of the node
-	T key;
 	// Children
 	Node* left;
 	Node* right;
-	// Constructor
-	Node(const T key) : key(key) {
-		this->left = nullptr;
-		this->right = nullptr;
+	// Key of the node
+	T key;
+	// Data kept by the node besides its key (see ExtendedNode and the layers)
+	static constexpr bool HAS_VALUE = false;
+	static constexpr bool HAS_SIZE = false;
+	static constexpr bool HAS_HEIGHT = false;
+	static constexpr bool HAS_COLOR = false;
+	// Constructors (the key is copied or moved into the node)
+	Node(const T& key) : left(nullptr), right(nullptr), key(key) {
 	}
-	virtual ~Node() {
-		delete left;
-		delete right;
+	Node(T&& key) : left(nullptr), right(nullptr), key(std::move(key)) {
 	}
-	;
 	/**
-	 * Verifies whether the node has a value
-	 * @return Returns true as the Node has only a key by default
+	 * Destructor. The descendants are deleted as well (as nodes of key only)
 	 */
-	virtual bool hasValue() const {
-		return false;
+	~Node() {
+		deleteDescendants(this);
 	}
 	;
+protected:
+	/**
+	 * Delete the descendants of a node without recursion: each subtree is rotated
+	 * to the right into a list, and every node is unlinked before deleting it, so
+	 * deleting a chain of any depth is safe
+	 * @param[in|out] node Node whose children are deleted (they are set to nullptr)
+	 */
+	template<typename D>
+	static void deleteDescendants(D* node) {
+		Node* subtrees[2] = { node->left, node->right };
+		node->left = nullptr;
+		node->right = nullptr;
+		for (Node* current : subtrees) {
+			while (current != nullptr) {
+				if (current->left != nullptr) {
+					Node* child = current->left;
+					current->left = child->right;
+					child->right = current;
+					current = child;
+				} else {
+					Node* next = current->right;
+					current->right = nullptr;
+					delete static_cast<D*>(current);
+					current = next;
+				}
+			}
+		}
+	}
 };
 
 /**
@@ -45,24 +82,117 @@ struct Node {
  */
 template<typename T, typename U>
 struct ExtendedNode: public Node<T> {
+	typedef U value_type;
 	U value;
+	// Whether the node has a value (the Extended node has always a key and a value)
+	static constexpr bool HAS_VALUE = true;
 	ExtendedNode(T key, U value) :
-			Node<T>(key), value(value) {
+			Node<T>(std::move(key)), value(std::move(value)) {
 	}
 	;
-	~ExtendedNode() {
+	// Constructors for the nodes created by a tree from a key (the value is
+	// value-initialized)
+	ExtendedNode(const T& key) :
+			Node<T>(key), value() {
+	}
+	;
+	ExtendedNode(T&& key) :
+			Node<T>(std::move(key)), value() {
 	}
 	;
 	/**
-	 * Verifies whether the node has a value
-	 * @return Returns true as the Extended node has always a key and a value
+	 * Destructor. The descendants are deleted as extended nodes
 	 */
-	bool hasValue() const {
-		return true;
+	~ExtendedNode() {
+		Node<T>::deleteDescendants(this);
 	}
 	;
 };
 
+/**
+ * Layer which adds the number of nodes of the subtree rooted at a node (1 for a
+ * leaf), for the trees which keep order statistics. Trees are then limited to
+ * 2^32 - 1 nodes
+ */
+template<typename B>
+struct SizedNode: public B {
+	uint32_t size;
+	static constexpr bool HAS_SIZE = true;
+	template<typename ... Args>
+	SizedNode(Args&&... args) :
+			B(std::forward<Args>(args)...), size(1) {
+	}
+	~SizedNode() {
+		B::deleteDescendants(this);
+	}
+};
+
+/**
+ * Layer which adds the height of the subtree rooted at a node (1 for a leaf), for
+ * the AVL trees
+ */
+template<typename B>
+struct AVLNode: public B {
+	unsigned char height;
+	static constexpr bool HAS_HEIGHT = true;
+	template<typename ... Args>
+	AVLNode(Args&&... args) :
+			B(std::forward<Args>(args)...), height(1) {
+	}
+	~AVLNode() {
+		B::deleteDescendants(this);
+	}
+};
+
+/**
+ * Layer which adds the color of a node, for the red-black trees
+ */
+template<typename B>
+struct RedBlackNode: public B {
+	bool red;
+	static constexpr bool HAS_COLOR = true;
+	template<typename ... Args>
+	RedBlackNode(Args&&... args) :
+			B(std::forward<Args>(args)...), red(false) {
+	}
+	~RedBlackNode() {
+		B::deleteDescendants(this);
+	}
+};
+
+/**
+ * Whether the nodes of a type only hold trivially destructible members once they
+ * have no children, so that a tree can release their memory without calling their
+ * destructors. Node, ExtendedNode and the layers have a destructor of their own
+ * (it deletes the descendants), so they depend on their key and value; any other
+ * node type has to be trivially destructible
+ */
+template<typename N>
+struct TrivialNodeMembers: std::is_trivially_destructible<N> {
+};
+
+template<typename T>
+struct TrivialNodeMembers<Node<T>> : std::is_trivially_destructible<T> {
+};
+
+template<typename T, typename U>
+struct TrivialNodeMembers<ExtendedNode<T, U>> : std::bool_constant<
+		std::is_trivially_destructible<T>::value
+				&& std::is_trivially_destructible<U>::value> {
+};
+
+template<typename B>
+struct TrivialNodeMembers<SizedNode<B>> : TrivialNodeMembers<B> {
+};
+
+template<typename B>
+struct TrivialNodeMembers<AVLNode<B>> : TrivialNodeMembers<B> {
+};
+
+template<typename B>
+struct TrivialNodeMembers<RedBlackNode<B>> : TrivialNodeMembers<B> {
+};
+
 template struct Node<int> ;
 template struct Node<float> ;
 template struct Node<double> ;
@@ -0,0 +1,125 @@
+/**
+ * @file NodePath.h
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#ifndef SRC_TREE_NODEPATH_H_
+#define SRC_TREE_NODEPATH_H_
+
+#include "Node.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace tree {
+
+/**
+ * This class keeps the nodes followed from the root down to a given node, so
+ * that the tree can be walked back from the bottom to the top (e.g. to balance
+ * it). Nodes are kept in an inline buffer, which is enough for any balanced
+ * tree (an AVL tree with 2^64 nodes is less than 93 levels high), so no memory
+ * is allocated. Deeper paths, only possible in unbalanced trees, spill into a
+ * vector.
+ */
+template<typename T>
+class NodePath {
+public:
+	/**
+	 * Class constructor
+	 */
+	NodePath() :
+			count(0), overflow() {
+	}
+	/**
+	 * Copy constructor. Only the nodes in use are copied
+	 * @param[in] other Path to copy
+	 */
+	NodePath(const NodePath& other) :
+			count(other.count), overflow(other.overflow) {
+		std::copy(other.nodes, other.nodes + std::min(count, CAPACITY), nodes);
+	}
+	NodePath& operator=(const NodePath& other) {
+		count = other.count;
+		overflow = other.overflow;
+		std::copy(other.nodes, other.nodes + std::min(count, CAPACITY), nodes);
+		return *this;
+	}
+	/**
+	 * Add a node at the bottom of the path
+	 * @param[in] node Node to add
+	 */
+	void push(Node<T>* node) {
+		if (count < CAPACITY)
+			nodes[count] = node;
+		else
+			overflow.push_back(node);
+		++count;
+	}
+	/**
+	 * Remove the node at the bottom of the path
+	 */
+	void pop() {
+		--count;
+		if (count >= CAPACITY)
+			overflow.pop_back();
+	}
+	/**
+	 * Get the node at the bottom of the path
+	 * @return Last node added to the path
+	 */
+	Node<T>* top() const {
+		return (*this)[count - 1];
+	}
+	/**
+	 * Access a node in the path, starting from the top (0 is the root)
+	 * @param[in] i Position in the path
+	 * @return Reference to the node at the given position
+	 */
+	Node<T>*& operator[](size_t i) {
+		return (i < CAPACITY) ? nodes[i] : overflow[i - CAPACITY];
+	}
+	Node<T>* operator[](size_t i) const {
+		return (i < CAPACITY) ? nodes[i] : overflow[i - CAPACITY];
+	}
+	/**
+	 * Verifies whether the path is empty
+	 * @return Returns true if there are no nodes in the path
+	 */
+	bool empty() const {
+		return count == 0;
+	}
+	/**
+	 * Get the number of nodes in the path
+	 * @return Length of the path
+	 */
+	size_t size() const {
+		return count;
+	}
+	/**
+	 * Remove the nodes at the bottom of the path, keeping the first ones
+	 * @param[in] size Number of nodes to keep
+	 */
+	void truncate(size_t size) {
+		count = size;
+		if (overflow.size() > 0)
+			overflow.resize((count > CAPACITY) ? count - CAPACITY : 0);
+	}
+	/**
+	 * Remove all the nodes from the path
+	 */
+	void clear() {
+		count = 0;
+		overflow.clear();
+	}
+private:
+	static constexpr size_t CAPACITY = 96;
+	Node<T>* nodes[CAPACITY];
+	size_t count;
+	std::vector<Node<T>*> overflow;
+};
+
+} /* namespace tree */
+
+#endif /* SRC_TREE_NODEPATH_H_ */
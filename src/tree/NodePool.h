@@ -0,0 +1,167 @@
+/**
+ * @file NodePool.h
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#ifndef SRC_TREE_NODEPOOL_H_
+#define SRC_TREE_NODEPOOL_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <utility>
+
+namespace tree {
+
+/**
+ * This class implements a slab allocator for the nodes of a tree. Memory is
+ * requested to a std::pmr::memory_resource in slabs which hold many nodes, so
+ * creating a node is a pointer bump. Destroyed nodes are kept in a free list and
+ * reused by the next creations. Releasing the pool returns every slab to the
+ * memory resource at once, without going through the nodes one by one.
+ * Slabs grow geometrically (up to MAX_SLAB_NODES nodes), so the number of slabs
+ * stays small even for very large trees.
+ */
+template<typename N>
+class NodePool {
+public:
+	/**
+	 * Class constructor
+	 * @param[in] resource Memory resource where slabs are requested to
+	 */
+	explicit NodePool(std::pmr::memory_resource* resource =
+			std::pmr::get_default_resource()) :
+			upstream(resource), slabs(nullptr), freeList(nullptr), cursor(
+					nullptr), end(nullptr), nextSlabNodes(FIRST_SLAB_NODES) {
+	}
+	/**
+	 * Class destructor. Slabs are released, but the nodes which are still
+	 * alive are not destroyed
+	 */
+	~NodePool() {
+		release();
+	}
+	NodePool(const NodePool&) = delete;
+	NodePool& operator=(const NodePool&) = delete;
+	/**
+	 * Create a node in the pool
+	 * @param[in] args Arguments for the node constructor
+	 * @return Returns the new node
+	 */
+	template<typename ... Args>
+	N* create(Args&&... args) {
+		void* slot;
+		if (freeList != nullptr) {
+			slot = freeList;
+			freeList = freeList->next;
+		} else {
+			if (cursor == end)
+				grow();
+			slot = cursor;
+			cursor += SLOT_SIZE;
+		}
+		return ::new (slot) N(std::forward<Args>(args)...);
+	}
+	/**
+	 * Destroy a node created by this pool. Its memory is reused by the next
+	 * creation
+	 * @param[in] node Node to destroy
+	 */
+	void destroy(N* node) {
+		node->~N();
+		FreeSlot* slot = reinterpret_cast<FreeSlot*>(node);
+		slot->next = freeList;
+		freeList = slot;
+	}
+	/**
+	 * Make room for a number of nodes in a single contiguous slab. The next count
+	 * creations are served from it, in order, as long as there are no destroyed
+	 * nodes waiting to be reused. If the current slab has not room enough, its
+	 * remaining space is left unused until the pool is released
+	 * @param[in] count Number of nodes
+	 */
+	void reserve(size_t count) {
+		if (static_cast<size_t>(end - cursor) >= count * SLOT_SIZE)
+			return;
+		size_t slabNodes = nextSlabNodes;
+		nextSlabNodes = std::max(count, nextSlabNodes);
+		grow();
+		nextSlabNodes = slabNodes;
+	}
+	/**
+	 * Return every slab to the memory resource. Nodes are not destroyed, so this
+	 * is only valid once they have been destroyed or when they do not need to
+	 * be (e.g. trivially destructible keys)
+	 */
+	void release() {
+		while (slabs != nullptr) {
+			Slab* next = slabs->next;
+			upstream->deallocate(slabs, slabs->bytes, SLAB_ALIGN);
+			slabs = next;
+		}
+		freeList = nullptr;
+		cursor = end = nullptr;
+		nextSlabNodes = FIRST_SLAB_NODES;
+	}
+	/**
+	 * Get the memory resource used by the pool
+	 * @return Memory resource where slabs are requested to
+	 */
+	std::pmr::memory_resource* resource() const {
+		return upstream;
+	}
+private:
+	/**
+	 * Header at the beginning of every slab
+	 */
+	struct Slab {
+		Slab* next;
+		size_t bytes;
+	};
+	/**
+	 * View of a destroyed node in the free list
+	 */
+	struct FreeSlot {
+		FreeSlot* next;
+	};
+
+	static constexpr size_t FIRST_SLAB_NODES = 64;
+	static constexpr size_t MAX_SLAB_NODES = 64 * 1024;
+	static constexpr size_t SLOT_ALIGN =
+			alignof(N) > alignof(FreeSlot) ? alignof(N) : alignof(FreeSlot);
+	static constexpr size_t SLOT_SIZE = ((
+			sizeof(N) > sizeof(FreeSlot) ? sizeof(N) : sizeof(FreeSlot))
+			+ SLOT_ALIGN - 1) / SLOT_ALIGN * SLOT_ALIGN;
+	static constexpr size_t SLAB_ALIGN =
+			SLOT_ALIGN > alignof(Slab) ? SLOT_ALIGN : alignof(Slab);
+	static constexpr size_t HEADER_SIZE = (sizeof(Slab) + SLOT_ALIGN - 1)
+			/ SLOT_ALIGN * SLOT_ALIGN;
+
+	/**
+	 * Request a new slab to the memory resource
+	 */
+	void grow() {
+		size_t bytes = HEADER_SIZE + nextSlabNodes * SLOT_SIZE;
+		Slab* slab = static_cast<Slab*>(upstream->allocate(bytes, SLAB_ALIGN));
+		slab->next = slabs;
+		slab->bytes = bytes;
+		slabs = slab;
+		cursor = reinterpret_cast<char*>(slab) + HEADER_SIZE;
+		end = reinterpret_cast<char*>(slab) + bytes;
+		if (nextSlabNodes < MAX_SLAB_NODES)
+			nextSlabNodes *= 2;
+	}
+
+	std::pmr::memory_resource* upstream;
+	Slab* slabs;
+	FreeSlot* freeList;
+	char* cursor;
+	char* end;
+	size_t nextSlabNodes;
+};
+
+} /* namespace tree */
+
+#endif /* SRC_TREE_NODEPOOL_H_ */
@@ -0,0 +1,235 @@
+/**
+ * @file NodeSearch.h
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#ifndef SRC_TREE_NODESEARCH_H_
+#define SRC_TREE_NODESEARCH_H_
+
+#include <algorithm>
+#include <cstddef>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define TREE_NODESEARCH_X86 1
+#include <immintrin.h>
+#endif
+
+namespace tree {
+
+/**
+ * Maximum number of keys scanned with vector instructions. Larger nodes are
+ * narrowed down to this size with a binary search first
+ */
+const size_t NODESEARCH_SCAN_KEYS = 64;
+
+/**
+ * Instruction sets available for the rank-in-node kernels
+ */
+enum class NodeSearchIsa {
+	SCALAR, SSE2, AVX2
+};
+
+/**
+ * Get the best instruction set supported by the running CPU (checked only once)
+ * @return Instruction set used by rankInNode
+ */
+inline NodeSearchIsa nodeSearchIsa() {
+#ifdef TREE_NODESEARCH_X86
+	static const NodeSearchIsa isa =
+			__builtin_cpu_supports("avx2") ?
+					NodeSearchIsa::AVX2 : NodeSearchIsa::SSE2;
+	return isa;
+#else
+	return NodeSearchIsa::SCALAR;
+#endif
+}
+
+namespace nodesearch {
+
+/**
+ * Count the keys lower than a given one in a sorted array, one key at a time
+ * @param[in] keys Sorted keys
+ * @param[in] count Number of keys
+ * @param[in] key Key to compare with
+ * @return Number of keys < key
+ */
+template<typename T>
+size_t scanScalar(const T* keys, size_t count, const T& key) {
+	size_t i = 0;
+	while ((i < count) && (keys[i] < key))
+		++i;
+	return i;
+}
+
+#ifdef TREE_NODESEARCH_X86
+// Every kernel compares a block of keys against the key at once and stops at the
+// first block which has a key >= key: as keys are sorted, the rank is the
+// position of the first comparison which fails. The remaining keys (less than a
+// block) are compared one by one
+
+inline size_t scanSse2(const int* keys, size_t count, int key) {
+	const __m128i probe = _mm_set1_epi32(key);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i lo = _mm_cmplt_epi32(
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)), probe);
+		__m128i hi = _mm_cmplt_epi32(
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i + 4)),
+				probe);
+		unsigned int mask = _mm_movemask_ps(_mm_castsi128_ps(lo))
+				| (_mm_movemask_ps(_mm_castsi128_ps(hi)) << 4);
+		if (mask != 0xFF)
+			return i + __builtin_ctz(~mask);
+	}
+	return i + scanScalar(keys + i, count - i, key);
+}
+
+inline size_t scanSse2(const float* keys, size_t count, float key) {
+	const __m128 probe = _mm_set1_ps(key);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		unsigned int mask = _mm_movemask_ps(
+				_mm_cmplt_ps(_mm_loadu_ps(keys + i), probe))
+				| (_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(keys + i + 4), probe))
+						<< 4);
+		if (mask != 0xFF)
+			return i + __builtin_ctz(~mask);
+	}
+	return i + scanScalar(keys + i, count - i, key);
+}
+
+inline size_t scanSse2(const double* keys, size_t count, double key) {
+	const __m128d probe = _mm_set1_pd(key);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		unsigned int mask = _mm_movemask_pd(
+				_mm_cmplt_pd(_mm_loadu_pd(keys + i), probe))
+				| (_mm_movemask_pd(_mm_cmplt_pd(_mm_loadu_pd(keys + i + 2), probe))
+						<< 2);
+		if (mask != 0xF)
+			return i + __builtin_ctz(~mask);
+	}
+	return i + scanScalar(keys + i, count - i, key);
+}
+
+__attribute__((target("avx2")))
+inline size_t scanAvx2(const int* keys, size_t count, int key) {
+	const __m256i probe = _mm256_set1_epi32(key);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m256i lo = _mm256_cmpgt_epi32(probe,
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)));
+		__m256i hi = _mm256_cmpgt_epi32(probe,
+				_mm256_loadu_si256(
+						reinterpret_cast<const __m256i*>(keys + i + 8)));
+		unsigned int mask = _mm256_movemask_ps(_mm256_castsi256_ps(lo))
+				| (_mm256_movemask_ps(_mm256_castsi256_ps(hi)) << 8);
+		if (mask != 0xFFFF)
+			return i + __builtin_ctz(~mask);
+	}
+	return i + scanSse2(keys + i, count - i, key);
+}
+
+__attribute__((target("avx2")))
+inline size_t scanAvx2(const float* keys, size_t count, float key) {
+	const __m256 probe = _mm256_set1_ps(key);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		unsigned int mask = _mm256_movemask_ps(
+				_mm256_cmp_ps(_mm256_loadu_ps(keys + i), probe, _CMP_LT_OQ))
+				| (_mm256_movemask_ps(
+						_mm256_cmp_ps(_mm256_loadu_ps(keys + i + 8), probe,
+								_CMP_LT_OQ)) << 8);
+		if (mask != 0xFFFF)
+			return i + __builtin_ctz(~mask);
+	}
+	return i + scanSse2(keys + i, count - i, key);
+}
+
+__attribute__((target("avx2")))
+inline size_t scanAvx2(const double* keys, size_t count, double key) {
+	const __m256d probe = _mm256_set1_pd(key);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		unsigned int mask = _mm256_movemask_pd(
+				_mm256_cmp_pd(_mm256_loadu_pd(keys + i), probe, _CMP_LT_OQ))
+				| (_mm256_movemask_pd(
+						_mm256_cmp_pd(_mm256_loadu_pd(keys + i + 4), probe,
+								_CMP_LT_OQ)) << 4);
+		if (mask != 0xFF)
+			return i + __builtin_ctz(~mask);
+	}
+	return i + scanSse2(keys + i, count - i, key);
+}
+#endif
+
+/**
+ * Count the keys lower than a given one in a sorted array with the best kernel
+ * for the running CPU. Wide arrays are narrowed with a binary search first
+ * @param[in] keys Sorted keys
+ * @param[in] count Number of keys
+ * @param[in] key Key to compare with
+ * @return Number of keys < key
+ */
+template<typename T>
+size_t rank(const T* keys, size_t count, T key) {
+	const T* first = keys;
+	while (count > NODESEARCH_SCAN_KEYS) {
+		size_t half = count / 2;
+		if (first[half] < key) {
+			first += half + 1;
+			count -= half + 1;
+		} else {
+			count = half;
+		}
+	}
+	size_t pos;
+	switch (nodeSearchIsa()) {
+#ifdef TREE_NODESEARCH_X86
+	case NodeSearchIsa::AVX2:
+		pos = scanAvx2(first, count, key);
+		break;
+	case NodeSearchIsa::SSE2:
+		pos = scanSse2(first, count, key);
+		break;
+#endif
+	default:
+		pos = scanScalar(first, count, key);
+		break;
+	}
+	return (first - keys) + pos;
+}
+
+} /* namespace nodesearch */
+
+/**
+ * Get the position of the first key which is not lower than a given one in the
+ * sorted keys of a node (i.e. std::lower_bound)
+ * @param[in] keys Sorted keys
+ * @param[in] count Number of keys
+ * @param[in] key Key to search
+ * @return Position of the first key >= key, or count if there is none
+ */
+template<typename T>
+size_t rankInNode(const T* keys, size_t count, const T& key) {
+	return std::lower_bound(keys, keys + count, key) - keys;
+}
+
+/**
+ * Numeric keys are compared against a whole block of keys per instruction
+ * (AVX2 or SSE2, chosen at runtime, or one by one on other platforms)
+ */
+inline size_t rankInNode(const int* keys, size_t count, const int& key) {
+	return nodesearch::rank(keys, count, key);
+}
+inline size_t rankInNode(const float* keys, size_t count, const float& key) {
+	return nodesearch::rank(keys, count, key);
+}
+inline size_t rankInNode(const double* keys, size_t count, const double& key) {
+	return nodesearch::rank(keys, count, key);
+}
+
+} /* namespace tree */
+
+#endif /* SRC_TREE_NODESEARCH_H_ */
@@ -0,0 +1,94 @@
+/**
+ * @file OptimisticLock.h
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#ifndef SRC_TREE_OPTIMISTICLOCK_H_
+#define SRC_TREE_OPTIMISTICLOCK_H_
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace tree {
+
+/**
+ * This class implements a version latch for optimistic lock coupling. Readers do
+ * not write to the latch: they take the version before reading a node and check
+ * that it has not changed afterwards (and go back otherwise). Writers lock the
+ * node by setting a bit of the version, and unlocking it moves the version
+ * forward. A node can also be marked as obsolete when it is unlinked from
+ * the tree, so that readers which still reach it start again.
+ * Writers never wait for a lock: locking fails if the node is locked or has
+ * changed, and callers release what they hold and start again, so there are no
+ * deadlocks.
+ */
+class OptimisticLock {
+public:
+	OptimisticLock() :
+			version(0) {
+	}
+	OptimisticLock(const OptimisticLock&) = delete;
+	OptimisticLock& operator=(const OptimisticLock&) = delete;
+	/**
+	 * Get the version of the node before reading it, waiting while it is locked
+	 * @param[out] current Version of the node
+	 * @return Returns false if the node is obsolete
+	 */
+	bool readLock(uint64_t& current) const {
+		current = version.load(std::memory_order_acquire);
+		while ((current & LOCKED) != 0) {
+			std::this_thread::yield();
+			current = version.load(std::memory_order_acquire);
+		}
+		return (current & OBSOLETE) == 0;
+	}
+	/**
+	 * Check that a node has not changed since its version was taken
+	 * @param[in] expected Version taken with readLock
+	 * @return Returns true if what was read from the node is consistent
+	 */
+	bool validate(uint64_t expected) const {
+		// Reads of the node must not be moved after the check
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return version.load(std::memory_order_relaxed) == expected;
+	}
+	/**
+	 * Lock a node which has been read, if it has not changed since then
+	 * @param[in] expected Version taken with readLock
+	 * @return Returns true if the node is now locked
+	 */
+	bool upgrade(uint64_t expected) {
+		return version.compare_exchange_strong(expected, expected + LOCKED,
+				std::memory_order_acquire);
+	}
+	/**
+	 * Lock a node if it is not locked nor obsolete
+	 * @return Returns true if the node is now locked
+	 */
+	bool tryLock() {
+		uint64_t current = version.load(std::memory_order_relaxed);
+		return ((current & (LOCKED | OBSOLETE)) == 0) && upgrade(current);
+	}
+	/**
+	 * Unlock a node, publishing its changes
+	 */
+	void unlock() {
+		version.fetch_add(LOCKED, std::memory_order_release);
+	}
+	/**
+	 * Unlock a node which is not in the tree any more
+	 */
+	void unlockObsolete() {
+		version.fetch_add(LOCKED | OBSOLETE, std::memory_order_release);
+	}
+private:
+	static constexpr uint64_t OBSOLETE = 1;
+	static constexpr uint64_t LOCKED = 2;
+	std::atomic<uint64_t> version;
+};
+
+} /* namespace tree */
+
+#endif /* SRC_TREE_OPTIMISTICLOCK_H_ */
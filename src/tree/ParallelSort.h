@@ -0,0 +1,51 @@
+/**
+ * @file ParallelSort.h
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#ifndef SRC_TREE_PARALLELSORT_H_
+#define SRC_TREE_PARALLELSORT_H_
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <thread>
+
+namespace tree {
+
+/**
+ * Minimum number of elements for a range to be split between threads
+ */
+const size_t PARALLEL_SORT_CUTOFF = 1 << 15;
+
+/**
+ * Sort a range using several threads. The range is split in two halves which are
+ * sorted concurrently (recursively, while there are threads left) and then merged.
+ * @param[in|out] first Beginning of the range
+ * @param[in|out] last End of the range
+ * @param[in] threads Number of threads to use
+ * @param[in] comp Comparison function
+ */
+template<typename RandomIt, typename Compare = std::less<>>
+void parallelSort(RandomIt first, RandomIt last,
+		unsigned int threads = std::thread::hardware_concurrency(),
+		Compare comp = Compare()) {
+	size_t size = std::distance(first, last);
+	if ((threads <= 1) || (size < PARALLEL_SORT_CUTOFF)) {
+		std::sort(first, last, comp);
+		return;
+	}
+	RandomIt middle = first + size / 2;
+	unsigned int leftThreads = threads / 2;
+	std::thread left([=]() {
+		parallelSort(first, middle, leftThreads, comp);
+	});
+	parallelSort(middle, last, threads - leftThreads, comp);
+	left.join();
+	std::inplace_merge(first, middle, last, comp);
+}
+
+} /* namespace tree */
+
+#endif /* SRC_TREE_PARALLELSORT_H_ */
@@ -0,0 +1,274 @@
+/**
+ * @file RedBlackTree.cpp
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#include "RedBlackTree.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+namespace tree {
+
+template<typename T, typename N>
+RedBlackTree<T, N>::RedBlackTree(std::pmr::memory_resource* resource) :
+		BinarySearchTree<T, N>(resource) {
+}
+
+template<typename T, typename N>
+void RedBlackTree<T, N>::rebalanceInsert(Node<T>* node, NodePath<T>& path) {
+	// New nodes are red, so the number of black nodes in the paths does not change
+	setRed(node, true);
+	insertFixup(path, node);
+}
+
+template<typename T, typename N>
+bool RedBlackTree<T, N>::deleteNode(const T& key) {
+	// Search the node to be removed, keeping the path followed
+	NodePath<T> path;
+	Node<T>* parent = nullptr;
+	Node<T>* currNode = this->root;
+	while ((currNode != nullptr) && !(currNode->key == key)) {
+		path.push(currNode);
+		parent = currNode;
+		currNode = (key < currNode->key) ? currNode->left : currNode->right;
+	}
+	if (currNode == nullptr) {
+		path.clear();
+		return false;
+	}
+
+	// The node which leaves its place is the node itself when it has 0 or 1
+	// child, or its in-order successor otherwise (as in BinarySearchTree). Only the
+	// color of that place matters, since the successor takes the color of the node
+	Node<T>* child;
+	bool fromLeft;
+	bool removedRed;
+	if ((currNode->left == nullptr) || (currNode->right == nullptr)) {
+		child = (currNode->left != nullptr) ? currNode->left : currNode->right;
+		fromLeft = (parent != nullptr) && (parent->left == currNode);
+		removedRed = isRed(currNode);
+		this->replaceChild(parent, currNode, child);
+	} else {
+		size_t currPos = path.size();
+		path.push(currNode);
+		Node<T>* minParent = currNode;
+		Node<T>* min = currNode->right;
+		while (min->left != nullptr) {
+			path.push(min);
+			minParent = min;
+			min = min->left;
+		}
+		child = min->right;
+		fromLeft = (minParent != currNode);
+		if (fromLeft)
+			minParent->left = child;
+		else
+			minParent->right = child;
+		removedRed = isRed(min);
+		min->left = currNode->left;
+		min->right = currNode->right;
+		setRed(min, isRed(currNode));
+		BinarySearchTree<T, N>::setSize(min,
+				BinarySearchTree<T, N>::subtreeSize(currNode));
+		this->replaceChild(parent, currNode, min);
+		path[currPos] = min;
+	}
+	if (this->hasOrderStatistics())
+		for (size_t i = 0; i < path.size(); ++i)
+			BinarySearchTree<T, N>::setSize(path[i],
+					BinarySearchTree<T, N>::subtreeSize(path[i]) - 1);
+	this->destroyNode(currNode);
+
+	// A red node can be removed without changing the black nodes of any path
+	if (removedRed)
+		path.clear();
+	else
+		deleteFixup(path, child, fromLeft);
+	return true;
+}
+
+template<typename T, typename N>
+size_t RedBlackTree<T, N>::insertSorted(const std::vector<T>& keys) {
+	size_t inserted = 0;
+	for (const T& key : keys)
+		if (this->insert(key))
+			++inserted;
+	return inserted;
+}
+
+template<typename T, typename N>
+void RedBlackTree<T, N>::resetBalance() {
+	if (this->root == nullptr)
+		return;
+	// The tree can be colored by levels if all the levels but the last one are
+	// complete, i.e. if every empty place is below the last level or the one
+	// before it. The depth of an empty place is the depth of its parent
+	size_t height = 0;
+	size_t minEmpty = SIZE_MAX;
+	this->walkNodes(this->root, true, false,
+			[&height, &minEmpty](Node<T>* node, size_t depth) {
+				height = std::max(height, depth);
+				if ((node->left == nullptr) || (node->right == nullptr))
+					minEmpty = std::min(minEmpty, depth);
+			});
+	if (minEmpty + 1 < height) {
+		// The same nodes (and their values) are linked as a tree of minimum height,
+		// which can be colored
+		this->rebuild();
+		resetBalance();
+		return;
+	}
+	// The paths down to an empty place go through height - 1 nodes which are not
+	// in the last level, so its nodes are the red ones
+	this->walkNodes(this->root, true, false,
+			[height](Node<T>* node, size_t depth) {
+				setRed(node, (depth > 1) && (depth == height));
+			});
+}
+
+template<typename T, typename N>
+void RedBlackTree<T, N>::insertFixup(NodePath<T>& path, Node<T>* node) {
+	// While the node and its parent are red: if the uncle is red as well, the
+	// grandparent takes the red from both of them and the problem goes up two
+	// levels; otherwise one or two rotations around the grandparent end it
+	while (!path.empty() && isRed(path.top())) {
+		Node<T>* parent = path.top();
+		path.pop();
+		// The root is black, so a red node has a parent
+		Node<T>* grandparent = path.top();
+		path.pop();
+		bool parentLeft = (grandparent->left == parent);
+		Node<T>* uncle = parentLeft ? grandparent->right : grandparent->left;
+		if (isRed(uncle)) {
+			setRed(parent, false);
+			setRed(uncle, false);
+			setRed(grandparent, true);
+			node = grandparent;
+			continue;
+		}
+		Node<T>* subtree;
+		if (parentLeft) {
+			if (parent->right == node) // => L+R
+				grandparent->left = rotateLeft(parent);
+			subtree = rotateRight(grandparent);
+		} else {
+			if (parent->left == node) // => R+L
+				grandparent->right = rotateRight(parent);
+			subtree = rotateLeft(grandparent);
+		}
+		setRed(subtree, false);
+		setRed(grandparent, true);
+		this->replaceChild(path.empty() ? nullptr : path.top(), grandparent,
+				subtree);
+		break;
+	}
+	setRed(this->root, false);
+	path.clear();
+}
+
+template<typename T, typename N>
+void RedBlackTree<T, N>::deleteFixup(NodePath<T>& path, Node<T>* node,
+		bool fromLeft) {
+	// The paths through the place of the node miss a black node. A red node is
+	// painted black; otherwise the sibling (which cannot be an empty place) gives
+	// a node to that side with a rotation, or it is painted red and the problem
+	// goes up a level
+	while (!path.empty() && !isRed(node)) {
+		Node<T>* parent = path.top();
+		Node<T>* sibling = fromLeft ? parent->right : parent->left;
+		if (isRed(sibling)) {
+			// Red sibling => rotate it over the parent, so the new sibling is black
+			setRed(sibling, false);
+			setRed(parent, true);
+			path.pop();
+			Node<T>* subtree = fromLeft ? rotateLeft(parent) : rotateRight(parent);
+			this->replaceChild(path.empty() ? nullptr : path.top(), parent,
+					subtree);
+			path.push(subtree);
+			path.push(parent);
+			sibling = fromLeft ? parent->right : parent->left;
+		}
+		Node<T>* near = fromLeft ? sibling->left : sibling->right;
+		Node<T>* far = fromLeft ? sibling->right : sibling->left;
+		if (!isRed(near) && !isRed(far)) {
+			setRed(sibling, true);
+			node = parent;
+			path.pop();
+			if (!path.empty())
+				fromLeft = (path.top()->left == node);
+			continue;
+		}
+		if (!isRed(far)) {
+			// Only the near nephew is red => turn it into the far one
+			setRed(near, false);
+			setRed(sibling, true);
+			sibling = fromLeft ? rotateRight(sibling) : rotateLeft(sibling);
+			if (fromLeft)
+				parent->right = sibling;
+			else
+				parent->left = sibling;
+			far = fromLeft ? sibling->right : sibling->left;
+		}
+		// The far nephew is red => the sibling takes the place of the parent
+		setRed(sibling, isRed(parent));
+		setRed(parent, false);
+		setRed(far, false);
+		path.pop();
+		Node<T>* subtree = fromLeft ? rotateLeft(parent) : rotateRight(parent);
+		this->replaceChild(path.empty() ? nullptr : path.top(), parent, subtree);
+		node = this->root;
+		break;
+	}
+	if (node != nullptr)
+		setRed(node, false);
+	path.clear();
+}
+
+template<typename T, typename N>
+bool RedBlackTree<T, N>::isRed(Node<T>* node) {
+	return (node != nullptr) && static_cast<N*>(node)->red;
+}
+
+template<typename T, typename N>
+void RedBlackTree<T, N>::setRed(Node<T>* node, bool red) {
+	static_cast<N*>(node)->red = red;
+}
+
+template<typename T, typename N>
+void RedBlackTree<T, N>::updateSize(Node<T>* node) {
+	BinarySearchTree<T, N>::setSize(node,
+			1 + BinarySearchTree<T, N>::subtreeSize(node->left)
+					+ BinarySearchTree<T, N>::subtreeSize(node->right));
+}
+
+template<typename T, typename N>
+Node<T>* RedBlackTree<T, N>::rotateLeft(Node<T>* z) {
+	Node<T>* y = z->right;
+	z->right = y->left;
+	y->left = z;
+	updateSize(z);
+	updateSize(y);
+	return y;
+}
+
+template<typename T, typename N>
+Node<T>* RedBlackTree<T, N>::rotateRight(Node<T>* z) {
+	Node<T>* y = z->left;
+	z->left = y->right;
+	y->right = z;
+	updateSize(z);
+	updateSize(y);
+	return y;
+}
+
+template class RedBlackTree<int> ;
+template class RedBlackTree<float> ;
+template class RedBlackTree<double> ;
+template class RedBlackTree<std::string> ;
+template class RedBlackTree<int, RedBlackNode<ExtendedNode<int, int>>> ;
+template class RedBlackTree<int, RedBlackNode<SizedNode<Node<int>>>> ;
+
+} /* namespace tree */
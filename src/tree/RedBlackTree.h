@@ -0,0 +1,121 @@
+/**
+ * @file RedBlackTree.h
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#ifndef SRC_TREE_REDBLACKTREE_H_
+#define SRC_TREE_REDBLACKTREE_H_
+
+#include "BinarySearchTree.h"
+#include "Node.h"
+#include "NodePath.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace tree {
+
+/**
+ * This class implements a red-black tree as a particular case of a BinaryTree.
+ * Every node is red or black: a red node has no red children, and every path from
+ * a node down to an empty place goes through the same number of black nodes. The
+ * longest path is then at most twice the shortest one, which is a looser balance
+ * than the one of an AVLTree (searches may go down a level or two more), but
+ * keeping it needs fewer changes: an insertion is fixed with at most 2 rotations
+ * and a deletion with at most 3, and the rest of the fix-up only recolors nodes.
+ * It suits workloads with many insertions and deletions.
+ * Nodes do not point to their parent, so fix-ups go up the path kept on the way
+ * down. The color is kept in RedBlackNode::red; heights are not kept.
+ */
+template<typename T, typename N = RedBlackNode<Node<T>>>
+class RedBlackTree: public BinarySearchTree<T, N> {
+	static_assert(N::HAS_COLOR, "The nodes of a red-black tree are RedBlackNode");
+public:
+	/**
+	 * Class constructor
+	 * @param[in] resource Memory resource backing the nodes created by the tree
+	 */
+	explicit RedBlackTree(std::pmr::memory_resource* resource =
+			std::pmr::get_default_resource());
+	/**
+	 * Removes a node with a given value
+	 * @param[in] key Key to remove from the tree
+	 * @see BinaryTree
+	 */
+	bool deleteNode(const T& key);
+protected:
+	/**
+	 * Color a new node red and fix the tree going up its path (see insertFixup)
+	 * @param[in] node Node which has been linked
+	 * @param[in|out] path Nodes from the root to the parent of the node (it is
+	 * cleared)
+	 */
+	void rebalanceInsert(Node<T>* node, NodePath<T>& path);
+	/**
+	 * Insert a batch of keys one after the other (see
+	 * BinarySearchTree::insertBatch): each fix-up is O(1) amortized, so the keys
+	 * of a sorted batch are cheap to insert as well
+	 * @param[in] keys Keys to insert, sorted in ascending order and without
+	 * repeated ones
+	 * @return Number of keys which have been inserted
+	 */
+	size_t insertSorted(const std::vector<T>& keys);
+	/**
+	 * Color a tree built by buildFromSorted or deserialize. A tree whose levels
+	 * are all complete but the last one is colored by levels (only an incomplete
+	 * last level is red); any other shape is linked again as a tree of minimum
+	 * height (see rebuild)
+	 */
+	void resetBalance();
+private:
+	/**
+	 * Remove the red node with a red parent left by an insertion, going up the path
+	 * @param[in|out] path Nodes from the root to the parent of the node (it is
+	 * cleared)
+	 * @param[in] node Red node which has been inserted
+	 */
+	void insertFixup(NodePath<T>& path, Node<T>* node);
+	/**
+	 * Add back the black node missing in the paths through a place of the tree,
+	 * after a black node has been unlinked from it
+	 * @param[in|out] path Nodes from the root to the parent of the place (it is
+	 * cleared)
+	 * @param[in] node Node in the place (it may be nullptr)
+	 * @param[in] fromLeft Whether the place is the left child of its parent
+	 */
+	void deleteFixup(NodePath<T>& path, Node<T>* node, bool fromLeft);
+	/**
+	 * Verifies whether a node is red (empty places are black)
+	 * @param[in] node Node to check
+	 * @return Returns true if the node is red
+	 */
+	static bool isRed(Node<T>* node);
+	/**
+	 * Color a node
+	 * @param[in|out] node Node to color
+	 * @param[in] red Whether the node is red (black otherwise)
+	 */
+	static void setRed(Node<T>* node, bool red);
+	/**
+	 * Recompute the cached size of a node from the size of its children
+	 * @param[in|out] node Node to update
+	 */
+	static void updateSize(Node<T>* node);
+	/**
+	 * Rotate a subtree to the left: the right child becomes the root of the subtree
+	 * @param[in] z Root of the subtree
+	 * @return New root of the subtree
+	 */
+	static Node<T>* rotateLeft(Node<T>* z);
+	/**
+	 * Rotate a subtree to the right: the left child becomes the root of the subtree
+	 * @param[in] z Root of the subtree
+	 * @return New root of the subtree
+	 */
+	static Node<T>* rotateRight(Node<T>* z);
+};
+
+} /* namespace tree */
+
+#endif /* SRC_TREE_REDBLACKTREE_H_ */
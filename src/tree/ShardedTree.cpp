@@ -0,0 +1,231 @@
+/**
+ * @file ShardedTree.cpp
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#include "ShardedTree.h"
+
+#include <string>
+
+namespace tree {
+
+template<typename T, typename Tree>
+ShardedTree<T, Tree>::ShardedTree(const std::vector<T>& bounds,
+		size_t maxShardSize) :
+		routing(nullptr), maxShardSize(maxShardSize), splitMutex(), allShards(),
+		retired() {
+	Routing* table = new Routing();
+	table->bounds = bounds;
+	table->bounds.erase(std::unique(table->bounds.begin(), table->bounds.end()),
+			table->bounds.end());
+	for (size_t i = 0; i <= table->bounds.size(); ++i) {
+		allShards.emplace_back(new Shard());
+		Shard* shard = allShards.back().get();
+		if (i > 0) {
+			shard->hasLow = true;
+			shard->low = table->bounds[i - 1];
+		}
+		if (i < table->bounds.size()) {
+			shard->hasHigh = true;
+			shard->high = table->bounds[i];
+		}
+		table->shards.push_back(shard);
+	}
+	this->routing.store(table, std::memory_order_release);
+}
+
+template<typename T, typename Tree>
+ShardedTree<T, Tree>::~ShardedTree() {
+	delete this->routing.load(std::memory_order_relaxed);
+	for (const std::pair<uint64_t, const Routing*>& entry : this->retired)
+		delete entry.second;
+}
+
+template<typename T, typename Tree>
+std::vector<T> ShardedTree<T, Tree>::boundsFromSample(std::vector<T> sample,
+		size_t shards) {
+	std::sort(sample.begin(), sample.end());
+	std::vector<T> bounds;
+	for (size_t i = 1; i < shards; ++i) {
+		size_t pos = sample.size() * i / shards;
+		if ((pos < sample.size())
+				&& (bounds.empty() || (bounds.back() < sample[pos])))
+			bounds.push_back(sample[pos]);
+	}
+	return bounds;
+}
+
+template<typename T, typename Tree>
+typename ShardedTree<T, Tree>::Shard* ShardedTree<T, Tree>::route(
+		const T& key) const {
+	// Shards are never freed before the tree, but routing tables are
+	EpochGuard guard;
+	const Routing* table = this->routing.load(std::memory_order_acquire);
+	return table->shards[table->find(key)];
+}
+
+template<typename T, typename Tree>
+typename ShardedTree<T, Tree>::Shard* ShardedTree<T, Tree>::lockShard(
+		const T& key, std::unique_lock<std::shared_mutex>& lock) {
+	for (;;) {
+		Shard* shard = route(key);
+		lock = std::unique_lock<std::shared_mutex>(shard->mutex);
+		// The shard may have been split after reading the routing table
+		if (shard->covers(key))
+			return shard;
+	}
+}
+
+template<typename T, typename Tree>
+typename ShardedTree<T, Tree>::Shard* ShardedTree<T, Tree>::lockShard(
+		const T& key, std::shared_lock<std::shared_mutex>& lock) const {
+	for (;;) {
+		Shard* shard = route(key);
+		lock = std::shared_lock<std::shared_mutex>(shard->mutex);
+		if (shard->covers(key))
+			return shard;
+	}
+}
+
+template<typename T, typename Tree>
+bool ShardedTree<T, Tree>::insert(const T& key) {
+	Shard* shard;
+	{
+		std::unique_lock<std::shared_mutex> lock;
+		shard = lockShard(key, lock);
+		if (!ShardOps<Tree>::insert(shard->tree, key))
+			return false;
+		++(shard->count);
+		if ((this->maxShardSize == 0) || (shard->count <= this->maxShardSize))
+			return true;
+	}
+	split(shard);
+	return true;
+}
+
+template<typename T, typename Tree>
+bool ShardedTree<T, Tree>::deleteNode(const T& key) {
+	std::unique_lock<std::shared_mutex> lock;
+	Shard* shard = lockShard(key, lock);
+	if (!ShardOps<Tree>::remove(shard->tree, key))
+		return false;
+	--(shard->count);
+	return true;
+}
+
+template<typename T, typename Tree>
+bool ShardedTree<T, Tree>::contains(const T& key) const {
+	std::shared_lock<std::shared_mutex> lock;
+	Shard* shard = lockShard(key, lock);
+	typename Tree::const_iterator it = shard->tree.lower_bound(key);
+	return (it != shard->tree.end()) && !(key < *it);
+}
+
+template<typename T, typename Tree>
+size_t ShardedTree<T, Tree>::size() const {
+	EpochGuard guard;
+	const Routing* table = this->routing.load(std::memory_order_acquire);
+	size_t total = 0;
+	for (Shard* shard : table->shards) {
+		std::shared_lock<std::shared_mutex> lock(shard->mutex);
+		total += shard->count;
+	}
+	return total;
+}
+
+template<typename T, typename Tree>
+size_t ShardedTree<T, Tree>::shards() const {
+	EpochGuard guard;
+	return this->routing.load(std::memory_order_acquire)->shards.size();
+}
+
+template<typename T, typename Tree>
+void ShardedTree<T, Tree>::getInorder(std::list<T>& orderedList) const {
+	// Shards are visited by range: after a shard, the walk goes on with the shard
+	// which holds its high bound, so the keys moved by a split are not missed. The
+	// first shard is always the same one (splits keep the lower half)
+	Shard* shard;
+	{
+		EpochGuard guard;
+		shard = this->routing.load(std::memory_order_acquire)->shards.front();
+	}
+	std::shared_lock<std::shared_mutex> lock(shard->mutex);
+	for (;;) {
+		orderedList.insert(orderedList.end(), shard->tree.begin(),
+				shard->tree.end());
+		if (!shard->hasHigh)
+			return;
+		T next = shard->high;
+		lock.unlock();
+		shard = lockShard(next, lock);
+	}
+}
+
+template<typename T, typename Tree>
+typename ShardedTree<T, Tree>::const_iterator ShardedTree<T, Tree>::begin() const {
+	const Routing* table = this->routing.load(std::memory_order_acquire);
+	return const_iterator(table, 0, table->shards.front()->tree.begin());
+}
+
+template<typename T, typename Tree>
+typename ShardedTree<T, Tree>::const_iterator ShardedTree<T, Tree>::end() const {
+	const Routing* table = this->routing.load(std::memory_order_acquire);
+	return const_iterator(table, table->shards.size(),
+			typename Tree::const_iterator());
+}
+
+template<typename T, typename Tree>
+void ShardedTree<T, Tree>::split(Shard* shard) {
+	std::lock_guard<std::mutex> splitLock(this->splitMutex);
+	std::unique_lock<std::shared_mutex> lock(shard->mutex);
+	if (shard->count <= this->maxShardSize)
+		return;
+	// Both halves are rebuilt from the sorted keys in O(n)
+	std::vector<T> keys(shard->tree.begin(), shard->tree.end());
+	size_t half = keys.size() / 2;
+	allShards.emplace_back(new Shard());
+	Shard* upper = allShards.back().get();
+	ShardOps<Tree>::build(upper->tree, keys.begin() + half, keys.end());
+	upper->count = keys.size() - half;
+	upper->hasLow = true;
+	upper->low = keys[half];
+	upper->hasHigh = shard->hasHigh;
+	upper->high = shard->high;
+	ShardOps<Tree>::build(shard->tree, keys.begin(), keys.begin() + half);
+	shard->count = half;
+	shard->hasHigh = true;
+	shard->high = keys[half];
+
+	// The new table is published while the shard is locked, so operations which
+	// are waiting for it find it shrunk and route again
+	const Routing* oldTable = this->routing.load(std::memory_order_relaxed);
+	Routing* table = new Routing(*oldTable);
+	size_t pos = std::find(table->shards.begin(), table->shards.end(), shard)
+			- table->shards.begin();
+	table->bounds.insert(table->bounds.begin() + pos, keys[half]);
+	table->shards.insert(table->shards.begin() + pos + 1, upper);
+	this->routing.store(table, std::memory_order_seq_cst);
+	this->retired.emplace_back(EpochDomain::instance().retire(), oldTable);
+	reclaim();
+}
+
+template<typename T, typename Tree>
+void ShardedTree<T, Tree>::reclaim() {
+	uint64_t safe = EpochDomain::instance().safeEpoch();
+	while (!this->retired.empty() && (this->retired.front().first < safe)) {
+		delete this->retired.front().second;
+		this->retired.pop_front();
+	}
+}
+
+template class ShardedTree<int> ;
+template class ShardedTree<float> ;
+template class ShardedTree<double> ;
+template class ShardedTree<std::string> ;
+template class ShardedTree<int, Btree<int>> ;
+template class ShardedTree<float, Btree<float>> ;
+template class ShardedTree<double, Btree<double>> ;
+template class ShardedTree<std::string, Btree<std::string>> ;
+
+} /* namespace tree */
@@ -0,0 +1,329 @@
+/**
+ * @file ShardedTree.h
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#ifndef SRC_TREE_SHARDEDTREE_H_
+#define SRC_TREE_SHARDEDTREE_H_
+
+#include "AVLTree.h"
+#include "Btree.h"
+#include "EpochReclamation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+namespace tree {
+
+/**
+ * Operations of ShardedTree on the tree of a shard, for each kind of tree
+ */
+template<typename Tree>
+struct ShardOps;
+
+/**
+ * Operations on an AVL tree
+ */
+template<typename T>
+struct ShardOps<AVLTree<T>> {
+	static bool insert(AVLTree<T>& tree, const T& key) {
+		return tree.insert(key);
+	}
+	static bool remove(AVLTree<T>& tree, const T& key) {
+		return tree.deleteNode(key);
+	}
+	/**
+	 * Replace the contents of the tree by a sorted range of different keys
+	 */
+	template<typename ForwardIt>
+	static void build(AVLTree<T>& tree, ForwardIt first, ForwardIt last) {
+		tree.buildFromSorted(first, last);
+	}
+};
+
+/**
+ * Operations on a b-tree (values are the keys themselves)
+ */
+template<typename T, typename Compare, unsigned short Degree>
+struct ShardOps<Btree<T, T, Compare, Degree>> {
+	static bool insert(Btree<T, T, Compare, Degree>& tree, const T& key) {
+		return tree.insert(key, key);
+	}
+	static bool remove(Btree<T, T, Compare, Degree>& tree, const T& key) {
+		return tree.remove(key);
+	}
+	/**
+	 * Replace the contents of the tree by a sorted range of different keys
+	 */
+	template<typename ForwardIt>
+	static void build(Btree<T, T, Compare, Degree>& tree, ForwardIt first,
+			ForwardIt last) {
+		std::vector<std::pair<T, T>> items;
+		items.reserve(std::distance(first, last));
+		for (; first != last; ++first)
+			items.emplace_back(*first, *first);
+		tree.bulkLoad(std::make_move_iterator(items.begin()),
+				std::make_move_iterator(items.end()));
+	}
+};
+
+/**
+ * This class splits the key space in ranges (shards), each one with a tree of its
+ * own (an AVLTree or a Btree) and a lock of its own, so that threads which work on
+ * different ranges do not wait for each other:
+ * - Every operation is routed to the shard of its key with a binary search in a
+ *   routing table. The table is read without locks (it is replaced as a whole
+ *   when it changes, and old tables are freed with epoch-based reclamation).
+ * - Lookups lock the shard in shared mode, and changes in exclusive mode.
+ * - A shard which grows past a given size is split in two halves online: only
+ *   that shard is locked while its keys are moved, and operations which were
+ *   routed to it with the old table route again.
+ * NOTE: the tree is instantiated in ShardedTree.cpp for int, float, double and
+ * std::string, with AVLTree and Btree shards.
+ */
+template<typename T, typename Tree = AVLTree<T>>
+class ShardedTree {
+	struct Shard;
+	struct Routing;
+public:
+	/**
+	 * Forward iterator which goes along the keys of all the shards in order.
+	 * Iterators must not be used while the tree is being changed (see getInorder
+	 * for an ordered walk which can)
+	 */
+	class const_iterator {
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef T value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const T* pointer;
+		typedef const T& reference;
+
+		const_iterator() :
+				routing(nullptr), shard(0), it() {
+		}
+		reference operator*() const {
+			return *it;
+		}
+		pointer operator->() const {
+			return &(*it);
+		}
+		const_iterator& operator++() {
+			++it;
+			skipEmpty();
+			return *this;
+		}
+		const_iterator operator++(int) {
+			const_iterator previous = *this;
+			++(*this);
+			return previous;
+		}
+		bool operator==(const const_iterator& other) const {
+			return (shard == other.shard)
+					&& ((routing == nullptr) || (shard == routing->shards.size())
+							|| (it == other.it));
+		}
+		bool operator!=(const const_iterator& other) const {
+			return !(*this == other);
+		}
+	private:
+		friend class ShardedTree<T, Tree>;
+		const_iterator(const Routing* routing, size_t shard,
+				typename Tree::const_iterator it) :
+				routing(routing), shard(shard), it(it) {
+			skipEmpty();
+		}
+		/**
+		 * Go to the next shard while the current one has no more keys
+		 */
+		void skipEmpty() {
+			while ((shard < routing->shards.size())
+					&& (it == routing->shards[shard]->tree.end())) {
+				if (++shard < routing->shards.size())
+					it = routing->shards[shard]->tree.begin();
+			}
+		}
+		const Routing* routing;
+		size_t shard;
+		typename Tree::const_iterator it;
+	};
+	typedef const_iterator iterator;
+
+	/**
+	 * Class constructor
+	 * @param[in] bounds Sorted keys where the shards start: there is a shard below
+	 * the first bound, and one more for each bound
+	 * @param[in] maxShardSize Number of keys a shard is split at (0 for never)
+	 */
+	explicit ShardedTree(const std::vector<T>& bounds = std::vector<T>(),
+			size_t maxShardSize = 0);
+	/**
+	 * Class destructor. It must not run concurrently with any other operation
+	 */
+	virtual ~ShardedTree();
+	ShardedTree(const ShardedTree&) = delete;
+	ShardedTree& operator=(const ShardedTree&) = delete;
+	/**
+	 * Get the bounds which split a sample of keys in shards of the same size
+	 * @param[in] sample Sample of the keys which are going to be inserted
+	 * @param[in] shards Number of shards
+	 * @return Sorted bounds for the constructor
+	 */
+	static std::vector<T> boundsFromSample(std::vector<T> sample, size_t shards);
+	/**
+	 * Insert a new key in the tree
+	 * @param[in] key Key to insert in the tree
+	 * @return Returns true if the key has been inserted, false if it already
+	 * existed
+	 */
+	bool insert(const T& key);
+	/**
+	 * Removes a key from the tree
+	 * @param[in] key Key to remove from the tree
+	 * @return Returns whether the key has been removed
+	 */
+	bool deleteNode(const T& key);
+	/**
+	 * Verifies whether a key is in the tree
+	 * @param[in] key Key to find
+	 * @return Returns true if the key is in the tree
+	 */
+	bool contains(const T& key) const;
+	/**
+	 * Get the number of keys in the tree
+	 * @return Number of keys
+	 */
+	size_t size() const;
+	/**
+	 * Get the number of shards
+	 * @return Number of shards
+	 */
+	size_t shards() const;
+	/**
+	 * Go along the tree in an in-order order, one shard after the other. It can run
+	 * while the tree is being changed: each shard is seen as it is when it is
+	 * reached
+	 * @param[out] orderedList List in an in-order order
+	 */
+	void getInorder(std::list<T>& orderedList) const;
+	/**
+	 * Get an iterator to the minimum key of the tree
+	 * @return Iterator to the first key in an in-order order
+	 */
+	const_iterator begin() const;
+	/**
+	 * Get an iterator past the maximum key of the tree
+	 * @return Iterator to the end of the tree
+	 */
+	const_iterator end() const;
+private:
+	/**
+	 * Range of keys with a tree and a lock of its own. The range of a shard only
+	 * shrinks (when it is split), and it is changed with the shard locked
+	 */
+	struct alignas(64) Shard {
+		mutable std::shared_mutex mutex;
+		Tree tree;
+		size_t count;
+		// Range of keys [low, high) (unbounded when there is no low or high)
+		bool hasLow;
+		bool hasHigh;
+		T low;
+		T high;
+		Shard() :
+				mutex(), tree(), count(0), hasLow(false), hasHigh(false), low(),
+				high() {
+		}
+		/**
+		 * Verifies whether a key is in the range of the shard
+		 * @param[in] key Key to check
+		 * @return Returns true if the shard holds the key
+		 */
+		bool covers(const T& key) const {
+			return (!hasLow || !(key < low)) && (!hasHigh || (key < high));
+		}
+	};
+	/**
+	 * Routing table: shard i holds the keys in [bounds[i-1], bounds[i])
+	 */
+	struct Routing {
+		std::vector<T> bounds;
+		std::vector<Shard*> shards;
+		/**
+		 * Get the position of the shard of a key
+		 * @param[in] key Key to route
+		 * @return Position of the shard
+		 */
+		size_t find(const T& key) const {
+			return std::upper_bound(bounds.begin(), bounds.end(), key)
+					- bounds.begin();
+		}
+	};
+
+	/**
+	 * Get the shard of a key, locked in exclusive mode
+	 * @param[in] key Key to route
+	 * @param[out] lock Lock of the shard
+	 * @return Shard which holds the key
+	 */
+	Shard* lockShard(const T& key, std::unique_lock<std::shared_mutex>& lock);
+	/**
+	 * Get the shard of a key, locked in shared mode
+	 * @param[in] key Key to route
+	 * @param[out] lock Lock of the shard
+	 * @return Shard which holds the key
+	 */
+	Shard* lockShard(const T& key,
+			std::shared_lock<std::shared_mutex>& lock) const;
+	/**
+	 * Get the shard of a key in the current routing table (without locking it)
+	 * @param[in] key Key to route
+	 * @return Shard whose range held the key when the table was read
+	 */
+	Shard* route(const T& key) const;
+	/**
+	 * Split a shard in two halves if it is still over the maximum size
+	 * @param[in|out] shard Shard to split
+	 */
+	void split(Shard* shard);
+	/**
+	 * Free the routing tables which no reader can be reading any more
+	 */
+	void reclaim();
+
+	/**
+	 * Current routing table
+	 */
+	std::atomic<const Routing*> routing;
+	/**
+	 * Number of keys a shard is split at (0 for never)
+	 */
+	size_t maxShardSize;
+	/**
+	 * Lock which makes splits run one at a time
+	 */
+	std::mutex splitMutex;
+	/**
+	 * All the shards (they are only freed by the destructor)
+	 */
+	std::vector<std::unique_ptr<Shard>> allShards;
+	/**
+	 * Routing tables replaced by splits, with the epoch they were retired at
+	 */
+	std::deque<std::pair<uint64_t, const Routing*>> retired;
+};
+
+} /* namespace tree */
+
+#endif /* SRC_TREE_SHARDEDTREE_H_ */
@@ -0,0 +1,321 @@
+/**
+ * @file SnapshotAVLTree.cpp
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#include "SnapshotAVLTree.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace tree {
+
+template<typename T>
+SnapshotAVLTree<T>::SnapshotAVLTree(std::pmr::memory_resource* resource) :
+		root(nullptr), count(0), pool(resource), version(0), unlinked(), retired() {
+}
+
+template<typename T>
+SnapshotAVLTree<T>::~SnapshotAVLTree() {
+	destroySubtree(this->root.load(std::memory_order_relaxed));
+	for (const std::pair<uint64_t, NodeType*>& entry : this->retired)
+		pool.destroy(entry.second);
+	pool.release();
+}
+
+template<typename T>
+bool SnapshotAVLTree<T>::insert(const T& key) {
+	std::lock_guard<std::mutex> lock(writerMutex);
+	++(this->version);
+	bool inserted = false;
+	NodeType* newRoot = insert(this->root.load(std::memory_order_relaxed), key,
+			inserted);
+	if (inserted) {
+		this->count.fetch_add(1, std::memory_order_relaxed);
+		publish(newRoot);
+	}
+	return inserted;
+}
+
+template<typename T>
+bool SnapshotAVLTree<T>::remove(const T& key) {
+	std::lock_guard<std::mutex> lock(writerMutex);
+	++(this->version);
+	bool removed = false;
+	NodeType* newRoot = remove(this->root.load(std::memory_order_relaxed), key,
+			removed);
+	if (removed) {
+		this->count.fetch_sub(1, std::memory_order_relaxed);
+		publish(newRoot);
+	}
+	return removed;
+}
+
+template<typename T>
+void SnapshotAVLTree<T>::clear() {
+	std::lock_guard<std::mutex> lock(writerMutex);
+	NodeType* oldRoot = this->root.load(std::memory_order_relaxed);
+	if (oldRoot == nullptr)
+		return;
+	// Readers may still be going down the old version => retire all its nodes
+	std::vector<NodeType*> pending(1, oldRoot);
+	while (!pending.empty()) {
+		NodeType* node = pending.back();
+		pending.pop_back();
+		if (node->left != nullptr)
+			pending.push_back(node->left);
+		if (node->right != nullptr)
+			pending.push_back(node->right);
+		this->unlinked.push_back(node);
+	}
+	this->count.store(0, std::memory_order_relaxed);
+	publish(nullptr);
+}
+
+template<typename T>
+bool SnapshotAVLTree<T>::contains(const T& key) const {
+	EpochGuard guard;
+	const NodeType* node = this->root.load(std::memory_order_seq_cst);
+	while (node != nullptr) {
+		if (key < node->key)
+			node = node->left;
+		else if (node->key < key)
+			node = node->right;
+		else
+			return true;
+	}
+	return false;
+}
+
+template<typename T>
+size_t SnapshotAVLTree<T>::size() const {
+	return this->count.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+void SnapshotAVLTree<T>::getInorder(std::list<T>& orderedList) const {
+	EpochGuard guard;
+	getInorder(this->root.load(std::memory_order_seq_cst), orderedList);
+}
+
+template<typename T>
+void SnapshotAVLTree<T>::getPreorder(std::list<T>& orderedList) const {
+	EpochGuard guard;
+	getPreorder(this->root.load(std::memory_order_seq_cst), orderedList);
+}
+
+template<typename T>
+unsigned int SnapshotAVLTree<T>::getHeight() const {
+	EpochGuard guard;
+	return height(this->root.load(std::memory_order_seq_cst));
+}
+
+template<typename T>
+void SnapshotAVLTree<T>::getInorder(const NodeType* root,
+		std::list<T>& orderedList) const {
+	if (root == nullptr)
+		return;
+	getInorder(root->left, orderedList);
+	orderedList.push_back(root->key);
+	getInorder(root->right, orderedList);
+}
+
+template<typename T>
+void SnapshotAVLTree<T>::getPreorder(const NodeType* root,
+		std::list<T>& orderedList) const {
+	if (root == nullptr)
+		return;
+	orderedList.push_back(root->key);
+	getPreorder(root->left, orderedList);
+	getPreorder(root->right, orderedList);
+}
+
+template<typename T>
+typename SnapshotAVLTree<T>::NodeType* SnapshotAVLTree<T>::insert(
+		NodeType* node, const T& key, bool& inserted) {
+	if (node == nullptr) {
+		inserted = true;
+		return pool.create(key, this->version);
+	}
+	// Nothing is copied on the way down: only the nodes above a change are
+	if (key < node->key) {
+		NodeType* left = insert(node->left, key, inserted);
+		if (!inserted)
+			return node;
+		node = writable(node);
+		node->left = left;
+	} else if (node->key < key) {
+		NodeType* right = insert(node->right, key, inserted);
+		if (!inserted)
+			return node;
+		node = writable(node);
+		node->right = right;
+	} else
+		return node;
+	return balance(node);
+}
+
+template<typename T>
+typename SnapshotAVLTree<T>::NodeType* SnapshotAVLTree<T>::remove(
+		NodeType* node, const T& key, bool& removed) {
+	if (node == nullptr)
+		return nullptr;
+	if (key < node->key) {
+		NodeType* left = remove(node->left, key, removed);
+		if (!removed)
+			return node;
+		node = writable(node);
+		node->left = left;
+	} else if (node->key < key) {
+		NodeType* right = remove(node->right, key, removed);
+		if (!removed)
+			return node;
+		node = writable(node);
+		node->right = right;
+	} else {
+		removed = true;
+		if ((node->left == nullptr) || (node->right == nullptr)) {
+			NodeType* child = (node->left != nullptr) ? node->left : node->right;
+			retire(node);
+			return child;
+		}
+		// Two children => the in-order successor takes the place of the node
+		NodeType* successor;
+		NodeType* right = removeMin(node->right, successor);
+		node = writable(node);
+		node->key = successor->key;
+		node->right = right;
+		retire(successor);
+	}
+	return balance(node);
+}
+
+template<typename T>
+typename SnapshotAVLTree<T>::NodeType* SnapshotAVLTree<T>::removeMin(
+		NodeType* node, NodeType*& min) {
+	if (node->left == nullptr) {
+		min = node;
+		return node->right;
+	}
+	NodeType* left = removeMin(node->left, min);
+	node = writable(node);
+	node->left = left;
+	return balance(node);
+}
+
+template<typename T>
+typename SnapshotAVLTree<T>::NodeType* SnapshotAVLTree<T>::writable(
+		NodeType* node) {
+	if (node->version == this->version)
+		return node;
+	NodeType* copy = pool.create(*node);
+	copy->version = this->version;
+	retire(node);
+	return copy;
+}
+
+template<typename T>
+int SnapshotAVLTree<T>::height(const NodeType* node) {
+	return (node == nullptr) ? 0 : node->height;
+}
+
+template<typename T>
+void SnapshotAVLTree<T>::updateHeight(NodeType* node) {
+	node->height = 1 + std::max(height(node->left), height(node->right));
+}
+
+template<typename T>
+typename SnapshotAVLTree<T>::NodeType* SnapshotAVLTree<T>::rotateLeft(
+		NodeType* z) {
+	NodeType* y = writable(z->right);
+	z->right = y->left;
+	y->left = z;
+	updateHeight(z);
+	updateHeight(y);
+	return y;
+}
+
+template<typename T>
+typename SnapshotAVLTree<T>::NodeType* SnapshotAVLTree<T>::rotateRight(
+		NodeType* z) {
+	NodeType* y = writable(z->left);
+	z->left = y->right;
+	y->right = z;
+	updateHeight(z);
+	updateHeight(y);
+	return y;
+}
+
+template<typename T>
+typename SnapshotAVLTree<T>::NodeType* SnapshotAVLTree<T>::balance(
+		NodeType* z) {
+	updateHeight(z);
+	int balance = height(z->right) - height(z->left);
+	if (std::abs(balance) <= 1)
+		return z;
+	// The child (and grandchild) which are rotated are copied as well
+	if (balance < 0) { // => L
+		if (height(z->left->right) > height(z->left->left)) // => L+R
+			z->left = rotateLeft(writable(z->left));
+		return rotateRight(z);
+	}
+	// => R
+	if (height(z->right->left) > height(z->right->right)) // => R+L
+		z->right = rotateRight(writable(z->right));
+	return rotateLeft(z);
+}
+
+template<typename T>
+void SnapshotAVLTree<T>::retire(NodeType* node) {
+	if (node->version == this->version)
+		pool.destroy(node);
+	else
+		this->unlinked.push_back(node);
+}
+
+template<typename T>
+void SnapshotAVLTree<T>::publish(NodeType* newRoot) {
+	this->root.store(newRoot, std::memory_order_seq_cst);
+	if (this->unlinked.empty())
+		return;
+	// Readers which start from now on do not reach the unlinked nodes
+	uint64_t epoch = EpochDomain::instance().retire();
+	for (NodeType* node : this->unlinked)
+		this->retired.emplace_back(epoch, node);
+	this->unlinked.clear();
+	if (this->retired.size() >= RECLAIM_BATCH)
+		reclaim();
+}
+
+template<typename T>
+void SnapshotAVLTree<T>::reclaim() {
+	uint64_t safe = EpochDomain::instance().safeEpoch();
+	while (!this->retired.empty() && (this->retired.front().first < safe)) {
+		pool.destroy(this->retired.front().second);
+		this->retired.pop_front();
+	}
+}
+
+template<typename T>
+void SnapshotAVLTree<T>::destroySubtree(NodeType* node) {
+	if (node == nullptr)
+		return;
+	std::vector<NodeType*> pending(1, node);
+	while (!pending.empty()) {
+		node = pending.back();
+		pending.pop_back();
+		if (node->left != nullptr)
+			pending.push_back(node->left);
+		if (node->right != nullptr)
+			pending.push_back(node->right);
+		pool.destroy(node);
+	}
+}
+
+template class SnapshotAVLTree<int> ;
+template class SnapshotAVLTree<float> ;
+template class SnapshotAVLTree<double> ;
+template class SnapshotAVLTree<std::string> ;
+
+} /* namespace tree */
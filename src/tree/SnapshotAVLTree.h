@@ -0,0 +1,236 @@
+/**
+ * @file SnapshotAVLTree.h
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#ifndef SRC_TREE_SNAPSHOTAVLTREE_H_
+#define SRC_TREE_SNAPSHOTAVLTREE_H_
+
+#include "EpochReclamation.h"
+#include "NodePool.h"
+#include "SnapshotNode.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tree {
+
+/**
+ * This class implements an AVL tree whose readers never wait, while the tree is
+ * being changed, in the way of read-copy-update (RCU):
+ * - Readers load the root once and go down a version of the tree which does not
+ *   change any more, so every lookup or traversal sees a consistent snapshot.
+ *   They take no locks; they only announce themselves to the epoch domain (see
+ *   EpochReclamation.h).
+ * - Changes are made by one writer at a time (writers take a mutex among them).
+ *   The writer copies the nodes in the path from the root to the change, and the
+ *   nodes moved by the rotations which balance it (copy-on-write), and then
+ *   publishes the new root atomically.
+ * - The nodes replaced by a change are freed once no reader can be reading them
+ *   any more (epoch-based reclamation).
+ * The balancing is the same as in AVLTree. Each change creates O(log n) nodes, so
+ * the tree suits many more reads than changes.
+ */
+template<typename T>
+class SnapshotAVLTree {
+public:
+	typedef SnapshotNode<T> NodeType;
+
+	/**
+	 * Class constructor
+	 * @param[in] resource Memory resource backing the nodes
+	 */
+	explicit SnapshotAVLTree(std::pmr::memory_resource* resource =
+			std::pmr::get_default_resource());
+	/**
+	 * Class destructor. It must not run concurrently with any other operation
+	 */
+	virtual ~SnapshotAVLTree();
+	SnapshotAVLTree(const SnapshotAVLTree&) = delete;
+	SnapshotAVLTree& operator=(const SnapshotAVLTree&) = delete;
+	/**
+	 * Insert a new key in the tree
+	 * @param[in] key Key to insert in the tree
+	 * @return Returns true if the key has been inserted, false if it already
+	 * existed
+	 */
+	bool insert(const T& key);
+	/**
+	 * Removes a key from the tree (if exists)
+	 * @param[in] key Key to remove
+	 * @return Returns whether the key has been removed or not
+	 */
+	bool remove(const T& key);
+	/**
+	 * Remove all the keys from the tree
+	 */
+	void clear();
+	/**
+	 * Verifies whether a key is in the tree
+	 * @param[in] key Key to find
+	 * @return Returns true if the key is in the tree
+	 */
+	bool contains(const T& key) const;
+	/**
+	 * Get the number of keys in the tree
+	 * @return Number of keys
+	 */
+	size_t size() const;
+	/**
+	 * Go along a snapshot of the tree in an in-order order
+	 * @param[out] orderedList List in an in-order order
+	 */
+	void getInorder(std::list<T>& orderedList) const;
+	/**
+	 * Go along a snapshot of the tree in a pre-order order
+	 * @param[out] orderedList List in a pre-order order
+	 */
+	void getPreorder(std::list<T>& orderedList) const;
+	/**
+	 * Get the height of a snapshot of the tree
+	 * @return Height of the tree
+	 */
+	unsigned int getHeight() const;
+private:
+	/**
+	 * Number of replaced nodes which are waiting before trying to free them
+	 */
+	static const size_t RECLAIM_BATCH = 128;
+
+	/**
+	 * Insert a key in a subtree
+	 * @param[in] node Root of the subtree
+	 * @param[in] key Key to insert
+	 * @param[out] inserted Whether the key has been inserted
+	 * @return Returns the root of the new subtree
+	 */
+	NodeType* insert(NodeType* node, const T& key, bool& inserted);
+	/**
+	 * Remove a key from a subtree
+	 * @param[in] node Root of the subtree
+	 * @param[in] key Key to remove
+	 * @param[out] removed Whether the key has been removed
+	 * @return Returns the root of the new subtree
+	 */
+	NodeType* remove(NodeType* node, const T& key, bool& removed);
+	/**
+	 * Unlink the node with the minimum key from a subtree
+	 * @param[in] node Root of the subtree (not empty)
+	 * @param[out] min Node with the minimum key (it is not retired)
+	 * @return Returns the root of the new subtree
+	 */
+	NodeType* removeMin(NodeType* node, NodeType*& min);
+	/**
+	 * Get a node which can be changed by the update in progress: the node itself if
+	 * it has been created by this update, or a copy of it otherwise (and then the
+	 * node is retired)
+	 * @param[in] node Node to change
+	 * @return Returns the node to change
+	 */
+	NodeType* writable(NodeType* node);
+	/**
+	 * Update the height of a node whose children have changed and balance it with
+	 * the LL, LR, RR and RL rotations (see AVLTree::balanceTree)
+	 * @param[in|out] z Node to balance (which can be changed)
+	 * @return Returns the root of the balanced subtree
+	 */
+	NodeType* balance(NodeType* z);
+	/**
+	 * Rotate a subtree to the left: the right child becomes the root of the subtree
+	 * @param[in|out] z Root of the subtree (which can be changed)
+	 * @return New root of the subtree
+	 */
+	NodeType* rotateLeft(NodeType* z);
+	/**
+	 * Rotate a subtree to the right: the left child becomes the root of the subtree
+	 * @param[in|out] z Root of the subtree (which can be changed)
+	 * @return New root of the subtree
+	 */
+	NodeType* rotateRight(NodeType* z);
+	/**
+	 * Get the cached height of a subtree
+	 * @param[in] node Root of the subtree
+	 * @return Height of the subtree (0 for an empty one)
+	 */
+	static int height(const NodeType* node);
+	/**
+	 * Recompute the cached height of a node from the height of its children
+	 * @param[in|out] node Node to update
+	 */
+	static void updateHeight(NodeType* node);
+	/**
+	 * Unlink a node from the tree. It is destroyed at once if readers have never
+	 * reached it, or once they are done with it otherwise
+	 * @param[in] node Node to unlink
+	 */
+	void retire(NodeType* node);
+	/**
+	 * Make the new version of the tree visible to the readers, and free the nodes
+	 * they are done with
+	 * @param[in] newRoot Root of the new version
+	 */
+	void publish(NodeType* newRoot);
+	/**
+	 * Destroy the retired nodes which no reader can be reading any more
+	 */
+	void reclaim();
+	/**
+	 * Destroy all the nodes of a subtree
+	 * @param[in] node Root of the subtree
+	 */
+	void destroySubtree(NodeType* node);
+	/**
+	 * Go along the tree in an in-order order.
+	 * @param[in] root Root node
+	 * @param[out] orderedList List in an in-order order
+	 */
+	void getInorder(const NodeType* root, std::list<T>& orderedList) const;
+	/**
+	 * Go along the tree in a pre-order order.
+	 * @param[in] root Root node
+	 * @param[out] orderedList List in a pre-order order
+	 */
+	void getPreorder(const NodeType* root, std::list<T>& orderedList) const;
+
+	/**
+	 * Root of the current version of the tree
+	 */
+	std::atomic<NodeType*> root;
+	/**
+	 * Number of keys in the current version
+	 */
+	std::atomic<size_t> count;
+	/**
+	 * Pool where the nodes are allocated (only used by the writer)
+	 */
+	NodePool<NodeType> pool;
+	/**
+	 * Lock which makes changes run one at a time
+	 */
+	std::mutex writerMutex;
+	/**
+	 * Number of the update in progress (or of the last one)
+	 */
+	uint64_t version;
+	/**
+	 * Nodes unlinked by the update in progress
+	 */
+	std::vector<NodeType*> unlinked;
+	/**
+	 * Nodes unlinked by the previous updates, with the epoch they were retired at
+	 */
+	std::deque<std::pair<uint64_t, NodeType*>> retired;
+};
+
+} /* namespace tree */
+
+#endif /* SRC_TREE_SNAPSHOTAVLTREE_H_ */
@@ -0,0 +1,38 @@
+/**
+ * @file SnapshotNode.h
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#ifndef SRC_TREE_SNAPSHOTNODE_H_
+#define SRC_TREE_SNAPSHOTNODE_H_
+
+#include <cstdint>
+
+namespace tree {
+
+/**
+ * This structure represents a node of a SnapshotAVLTree. Once a node is reachable
+ * by the readers it is never changed: the writer changes a copy of it instead
+ */
+template<typename T>
+struct SnapshotNode {
+	// Key of the node
+	T key;
+	// Height of the subtree rooted at this node (1 for a leaf)
+	unsigned char height;
+	// Update of the tree which created the node. The nodes created by the update
+	// in progress are not reachable by the readers yet, so they can be changed
+	uint64_t version;
+	// Children
+	SnapshotNode* left;
+	SnapshotNode* right;
+	// Constructor
+	SnapshotNode(const T& key, uint64_t version) :
+			key(key), height(1), version(version), left(nullptr), right(nullptr) {
+	}
+};
+
+} /* namespace tree */
+
+#endif /* SRC_TREE_SNAPSHOTNODE_H_ */
@@ -0,0 +1,152 @@
+/**
+ * @file SplayTree.cpp
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#include "SplayTree.h"
+
+#include <string>
+
+namespace tree {
+
+template<typename T, typename N>
+SplayTree<T, N>::SplayTree(SplayMode mode, unsigned int splayDepth,
+		std::pmr::memory_resource* resource) :
+		BinarySearchTree<T, N>(resource), mode(mode), splayDepth(splayDepth) {
+}
+
+template<typename T, typename N>
+typename SplayTree<T, N>::SplayMode SplayTree<T, N>::getSplayMode() const {
+	return this->mode;
+}
+
+template<typename T, typename N>
+unsigned int SplayTree<T, N>::getSplayDepth() const {
+	return this->splayDepth;
+}
+
+template<typename T, typename N>
+void SplayTree<T, N>::rebalanceInsert(Node<T>* node, NodePath<T>& path) {
+	splay(node, path);
+}
+
+template<typename T, typename N>
+bool SplayTree<T, N>::deleteNode(const T& key) {
+	NodePath<T> path;
+	if (!BinarySearchTree<T, N>::deleteNode(key, &path))
+		return false;
+	if (!path.empty()) {
+		Node<T>* parent = path.top();
+		path.pop();
+		splay(parent, path);
+	}
+	return true;
+}
+
+template<typename T, typename N>
+N* SplayTree<T, N>::search(const T& key) {
+	NodePath<T> path;
+	Node<T>* node = this->root;
+	while (node != nullptr) {
+		if (node->key == key) {
+			splay(node, path);
+			return static_cast<N*>(node);
+		}
+		path.push(node);
+		node = (key < node->key) ? node->left : node->right;
+	}
+	// Not found => the last node reached is splayed, so that a miss pays for its
+	// descent as well
+	if (!path.empty()) {
+		node = path.top();
+		path.pop();
+		splay(node, path);
+	}
+	return nullptr;
+}
+
+template<typename T, typename N>
+void SplayTree<T, N>::splay(Node<T>* node, NodePath<T>& path) {
+	/*
+	 *		ZIG-ZIG (the node and its parent are on the same side)
+	 *		___________________________________________________________
+	 *		       g                    p                    x
+	 *		      / \                 /   \                 / \
+	 *		     p   D               x     g               A   p
+	 *		    / \       ->        / \   / \      ->         / \
+	 *		   x   C               A   B C   D               B   g
+	 *		  / \                                               / \
+	 *		 A   B                                             C   D
+	 *		A semi-splay stops after the first rotation and goes on from p.
+	 *
+	 *		ZIG-ZAG (the node and its parent are on different sides)
+	 *		___________________________________________________________
+	 *		     g                                x
+	 *		    / \                             /   \
+	 *		   p   D                           p     g
+	 *		  / \          ->                 / \   / \
+	 *		 A   x                           A   B C   D
+	 *		    / \
+	 *		   B   C
+	 */
+	if (path.size() <= this->splayDepth) {
+		path.clear();
+		return;
+	}
+	while (!path.empty()) {
+		Node<T>* parent = path.top();
+		path.pop();
+		// ZIG: the parent is the root
+		if (path.empty()) {
+			this->replaceChild(nullptr, parent, rotateUp(parent, node));
+			break;
+		}
+		Node<T>* grandparent = path.top();
+		path.pop();
+		Node<T>* subtree;
+		if ((grandparent->left == parent) == (parent->left == node)) {
+			subtree = rotateUp(grandparent, parent);
+			if (this->mode == SEMI_SPLAY)
+				node = parent;
+			else
+				subtree = rotateUp(parent, node);
+		} else {
+			if (grandparent->left == parent)
+				grandparent->left = rotateUp(parent, node);
+			else
+				grandparent->right = rotateUp(parent, node);
+			subtree = rotateUp(grandparent, node);
+		}
+		this->replaceChild(path.empty() ? nullptr : path.top(), grandparent,
+				subtree);
+	}
+	path.clear();
+}
+
+template<typename T, typename N>
+Node<T>* SplayTree<T, N>::rotateUp(Node<T>* parent, Node<T>* child) {
+	if (parent->left == child) {
+		parent->left = child->right;
+		child->right = parent;
+	} else {
+		parent->right = child->left;
+		child->left = parent;
+	}
+	BinarySearchTree<T, N>::setSize(parent,
+			1 + BinarySearchTree<T, N>::subtreeSize(parent->left)
+					+ BinarySearchTree<T, N>::subtreeSize(parent->right));
+	BinarySearchTree<T, N>::setSize(child,
+			1 + BinarySearchTree<T, N>::subtreeSize(child->left)
+					+ BinarySearchTree<T, N>::subtreeSize(child->right));
+	return child;
+}
+
+template class SplayTree<int> ;
+template class SplayTree<float> ;
+template class SplayTree<double> ;
+template class SplayTree<std::string> ;
+template class SplayTree<int, ExtendedNode<int, int>> ;
+template class SplayTree<int, SizedNode<Node<int>>> ;
+
+} /* namespace tree */
@@ -0,0 +1,121 @@
+/**
+ * @file SplayTree.h
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#ifndef SRC_TREE_SPLAYTREE_H_
+#define SRC_TREE_SPLAYTREE_H_
+
+#include "BinarySearchTree.h"
+#include "Node.h"
+#include "NodePath.h"
+
+namespace tree {
+
+/**
+ * This class implements a splay tree as a particular case of a BinaryTree. It
+ * keeps no balance data: every search, insertion and deletion moves the node it
+ * reaches up towards the root with rotations (splaying), so the keys which are
+ * used often stay close to the root and are found after a few steps, while any
+ * sequence of operations costs O(log n) per operation amortized.
+ * With semi-splaying, a node whose parent and grandparent are on the same side
+ * only lifts its parent, so every access rewrites about half of the path and a
+ * key needs several accesses to reach the root: the shape changes less for keys
+ * which are used once. Besides, nodes which are already close to the root can be
+ * left in place (see the splay depth): the keys which are used the most are then
+ * found without writing to the tree at all.
+ * NOTE: searches change the tree, so they must not run at the same time as any
+ * other operation (including other searches). Iterators, lower_bound and the
+ * traversals do not splay.
+ */
+template<typename T, typename N = Node<T>>
+class SplayTree: public BinarySearchTree<T, N> {
+public:
+	/**
+	 * How far a node is moved up by each access
+	 */
+	enum SplayMode {
+		// The node becomes the root
+		FULL_SPLAY,
+		// The node goes up about half of its depth
+		SEMI_SPLAY
+	};
+
+	/**
+	 * Class constructor
+	 * @param[in] mode How far accessed nodes are moved up
+	 * @param[in] splayDepth Depth (number of ancestors) up to which accessed nodes
+	 * are left in place. 0 splays every access; about log2 of the number of hot
+	 * keys keeps them near the root without rewriting the path on each lookup
+	 * @param[in] resource Memory resource backing the nodes created by the tree
+	 */
+	explicit SplayTree(SplayMode mode = FULL_SPLAY, unsigned int splayDepth = 0,
+			std::pmr::memory_resource* resource =
+					std::pmr::get_default_resource());
+	/**
+	 * Get how far accessed nodes are moved up
+	 * @return Splay mode of the tree
+	 */
+	SplayMode getSplayMode() const;
+	/**
+	 * Get the depth up to which accessed nodes are left in place
+	 * @return Splay depth of the tree
+	 */
+	unsigned int getSplayDepth() const;
+	/**
+	 * Removes a node with a given value, and splay its parent
+	 * @param[in] key Key to remove from the tree
+	 * @see BinaryTree
+	 */
+	bool deleteNode(const T& key);
+	/**
+	 * The search of a BinarySearchTree is kept for const trees: it finds the node
+	 * without splaying it
+	 */
+	using BinarySearchTree<T, N>::search;
+	/**
+	 * Look for a node with a value, and splay it (or the last node reached, if the
+	 * value is not found)
+	 * @param[in] key Key to search in the tree
+	 * @return Returns the node with the given value, or nullptr in case it was not found
+	 */
+	N* search(const T& key);
+protected:
+	/**
+	 * Splay a new node
+	 * @param[in] node Node which has been linked
+	 * @param[in|out] path Nodes from the root to the parent of the node (it is
+	 * cleared)
+	 */
+	void rebalanceInsert(Node<T>* node, NodePath<T>& path);
+private:
+	/**
+	 * Move a node up its path with zig-zig, zig-zag and zig rotations, unless it is
+	 * not deeper than the splay depth
+	 * @param[in] node Node to move up
+	 * @param[in|out] path Nodes from the root to the parent of the node (it is
+	 * cleared)
+	 */
+	void splay(Node<T>* node, NodePath<T>& path);
+	/**
+	 * Rotate a node over its parent. The link from the grandparent is not changed
+	 * @param[in] parent Parent of the node
+	 * @param[in] child Node to move up
+	 * @return Returns the child, which is the new root of the subtree
+	 */
+	static Node<T>* rotateUp(Node<T>* parent, Node<T>* child);
+
+	/**
+	 * How far accessed nodes are moved up
+	 */
+	SplayMode mode;
+	/**
+	 * Depth up to which accessed nodes are left in place
+	 */
+	unsigned int splayDepth;
+};
+
+} /* namespace tree */
+
+#endif /* SRC_TREE_SPLAYTREE_H_ */
@@ -0,0 +1,366 @@
+/**
+ * @file StaticSearchTree.cpp
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#include "StaticSearchTree.h"
+#include "NodeSearch.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tree {
+
+namespace {
+
+/**
+ * Number of lookups which go down the tree in lockstep in a batch
+ */
+const size_t BATCH_LANES = 16;
+
+/**
+ * Header of a file written by StaticSearchTree::write. The array goes right after
+ * it, so it is aligned to a cache line in the mapping
+ */
+struct alignas(64) TableHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t keySize;
+	// Whether keys are floating-point (bit 0) and signed (bit 1)
+	uint32_t keyKind;
+	uint64_t count;
+};
+
+const char TABLE_MAGIC[8] = { 'E', 'Y', 'T', 'Z', 'T', 'A', 'B', 'L' };
+const uint32_t TABLE_VERSION = 1;
+
+template<typename T>
+constexpr uint32_t tableKeyKind() {
+	return (std::is_floating_point<T>::value ? 1 : 0)
+			| (std::is_signed<T>::value ? 2 : 0);
+}
+
+/**
+ * Get the position of the lower bound from the position where a lookup leaves
+ * the tree. Each step down is a bit (1 for right), so the lower bound is the last
+ * node where the lookup went left: drop the trailing right steps and that left one
+ * @param[in] pos Position past the bottom of the tree
+ * @return Position of the lower bound, or 0 if there is none
+ */
+inline size_t lowerBoundFromExit(size_t pos) {
+	return pos >> __builtin_ffsll(static_cast<long long>(~pos));
+}
+
+/**
+ * Get the number of levels of a tree
+ * @param[in] count Number of keys
+ * @return Height of the tree
+ */
+inline unsigned int levels(size_t count) {
+	return (count == 0) ? 0 : 64 - __builtin_clzll(count);
+}
+
+/**
+ * Go down the tree for a batch of keys with vector instructions. Only int, float
+ * and double keys have a kernel, so other types are not processed at all
+ * @param[in] tree Keys in the Eytzinger order
+ * @param[in] count Number of keys in the tree
+ * @param[in] keys Keys to find
+ * @param[in] n Number of keys to find
+ * @param[out] positions Position where each lookup leaves the tree
+ * @return Number of keys processed (from the beginning)
+ */
+template<typename T>
+size_t descendBatch(const T* tree, size_t count, const T* keys, size_t n,
+		size_t* positions) {
+	return 0;
+}
+
+#ifdef TREE_NODESEARCH_X86
+// All the levels but the last one are complete, so every lookup goes down them.
+// At the last level, lanes which are already past the bottom are masked out
+
+__attribute__((target("avx2")))
+size_t descendAvx2(const int* tree, size_t count, const int* keys, size_t n,
+		size_t* positions) {
+	// Positions are 32-bit, and they go up to 2 * count + 1
+	if (count >= (size_t(1) << 30))
+		return 0;
+	const unsigned int height = levels(count);
+	const __m256i bottom = _mm256_set1_epi32(static_cast<int>(count + 1));
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i probe = _mm256_loadu_si256(
+				reinterpret_cast<const __m256i*>(keys + i));
+		__m256i pos = _mm256_set1_epi32(1);
+		for (unsigned int level = 1; level < height; ++level) {
+			__m256i lt = _mm256_cmpgt_epi32(probe,
+					_mm256_i32gather_epi32(tree, pos, 4));
+			pos = _mm256_sub_epi32(_mm256_add_epi32(pos, pos), lt);
+		}
+		__m256i active = _mm256_cmpgt_epi32(bottom, pos);
+		__m256i lt = _mm256_cmpgt_epi32(probe,
+				_mm256_mask_i32gather_epi32(_mm256_setzero_si256(), tree, pos,
+						active, 4));
+		pos = _mm256_blendv_epi8(pos,
+				_mm256_sub_epi32(_mm256_add_epi32(pos, pos), lt), active);
+		uint32_t lanes[8];
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), pos);
+		std::copy(lanes, lanes + 8, positions + i);
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+size_t descendAvx2(const float* tree, size_t count, const float* keys,
+		size_t n, size_t* positions) {
+	if (count >= (size_t(1) << 30))
+		return 0;
+	const unsigned int height = levels(count);
+	const __m256i bottom = _mm256_set1_epi32(static_cast<int>(count + 1));
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 probe = _mm256_loadu_ps(keys + i);
+		__m256i pos = _mm256_set1_epi32(1);
+		for (unsigned int level = 1; level < height; ++level) {
+			__m256i lt = _mm256_castps_si256(
+					_mm256_cmp_ps(_mm256_i32gather_ps(tree, pos, 4), probe,
+							_CMP_LT_OQ));
+			pos = _mm256_sub_epi32(_mm256_add_epi32(pos, pos), lt);
+		}
+		__m256i active = _mm256_cmpgt_epi32(bottom, pos);
+		__m256i lt = _mm256_castps_si256(
+				_mm256_cmp_ps(
+						_mm256_mask_i32gather_ps(_mm256_setzero_ps(), tree, pos,
+								_mm256_castsi256_ps(active), 4), probe,
+						_CMP_LT_OQ));
+		pos = _mm256_blendv_epi8(pos,
+				_mm256_sub_epi32(_mm256_add_epi32(pos, pos), lt), active);
+		uint32_t lanes[8];
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), pos);
+		std::copy(lanes, lanes + 8, positions + i);
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+size_t descendAvx2(const double* tree, size_t count, const double* keys,
+		size_t n, size_t* positions) {
+	const unsigned int height = levels(count);
+	const __m256i bottom = _mm256_set1_epi64x(
+			static_cast<long long>(count + 1));
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256d probe = _mm256_loadu_pd(keys + i);
+		__m256i pos = _mm256_set1_epi64x(1);
+		for (unsigned int level = 1; level < height; ++level) {
+			__m256i lt = _mm256_castpd_si256(
+					_mm256_cmp_pd(
+							_mm256_i64gather_pd(tree, pos, 8), probe,
+							_CMP_LT_OQ));
+			pos = _mm256_sub_epi64(_mm256_add_epi64(pos, pos), lt);
+		}
+		__m256i active = _mm256_cmpgt_epi64(bottom, pos);
+		__m256i lt = _mm256_castpd_si256(
+				_mm256_cmp_pd(
+						_mm256_mask_i64gather_pd(_mm256_setzero_pd(), tree, pos,
+								_mm256_castsi256_pd(active), 8), probe,
+						_CMP_LT_OQ));
+		pos = _mm256_blendv_epi8(pos,
+				_mm256_sub_epi64(_mm256_add_epi64(pos, pos), lt), active);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(positions + i), pos);
+	}
+	return i;
+}
+
+size_t descendBatch(const int* tree, size_t count, const int* keys, size_t n,
+		size_t* positions) {
+	if (nodeSearchIsa() != NodeSearchIsa::AVX2)
+		return 0;
+	return descendAvx2(tree, count, keys, n, positions);
+}
+
+size_t descendBatch(const float* tree, size_t count, const float* keys,
+		size_t n, size_t* positions) {
+	if (nodeSearchIsa() != NodeSearchIsa::AVX2)
+		return 0;
+	return descendAvx2(tree, count, keys, n, positions);
+}
+
+size_t descendBatch(const double* tree, size_t count, const double* keys,
+		size_t n, size_t* positions) {
+	if (nodeSearchIsa() != NodeSearchIsa::AVX2)
+		return 0;
+	return descendAvx2(tree, count, keys, n, positions);
+}
+#endif
+
+}
+
+template<typename T>
+StaticSearchTree<T>::StaticSearchTree(std::vector<T> sortedKeys) :
+		storage(), keys(nullptr), count(0) {
+	sortedKeys.erase(std::unique(sortedKeys.begin(), sortedKeys.end()),
+			sortedKeys.end());
+	this->count = sortedKeys.size();
+	std::shared_ptr<std::vector<T>> array = std::make_shared<std::vector<T>>(
+			this->count + 1);
+	size_t next = 0;
+	build(sortedKeys, *array, next, 1);
+	this->keys = array->data();
+	this->storage = array;
+}
+
+template<typename T>
+void StaticSearchTree<T>::build(std::vector<T>& sortedKeys,
+		std::vector<T>& array, size_t& next, size_t pos) {
+	if (pos > this->count)
+		return;
+	build(sortedKeys, array, next, 2 * pos);
+	array[pos] = std::move(sortedKeys[next++]);
+	build(sortedKeys, array, next, 2 * pos + 1);
+}
+
+template<typename T>
+bool StaticSearchTree<T>::write(const std::string& path) const {
+	if (!std::is_trivially_copyable<T>::value)
+		return false;
+	std::FILE* file = std::fopen(path.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+	TableHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, TABLE_MAGIC, sizeof(header.magic));
+	header.version = TABLE_VERSION;
+	header.keySize = sizeof(T);
+	header.keyKind = tableKeyKind<T>();
+	header.count = this->count;
+	bool written = (std::fwrite(&header, sizeof(header), 1, file) == 1)
+			&& (std::fwrite(this->keys, sizeof(T), this->count + 1, file)
+					== this->count + 1);
+	return (std::fclose(file) == 0) && written;
+}
+
+template<typename T>
+bool StaticSearchTree<T>::map(const std::string& path) {
+	if (!std::is_trivially_copyable<T>::value)
+		return false;
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat status;
+	if ((fstat(fd, &status) != 0)
+			|| (static_cast<size_t>(status.st_size) < sizeof(TableHeader))) {
+		close(fd);
+		return false;
+	}
+	size_t size = status.st_size;
+	void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	// The mapping keeps the file open
+	close(fd);
+	if (mapping == MAP_FAILED)
+		return false;
+	const TableHeader* header = static_cast<const TableHeader*>(mapping);
+	bool valid = (std::memcmp(header->magic, TABLE_MAGIC, sizeof(header->magic))
+			== 0) && (header->version == TABLE_VERSION)
+			&& (header->keySize == sizeof(T))
+			&& (header->keyKind == tableKeyKind<T>())
+			&& (header->count < (size - sizeof(TableHeader)) / sizeof(T));
+	if (!valid) {
+		munmap(mapping, size);
+		return false;
+	}
+	this->count = header->count;
+	this->keys = reinterpret_cast<const T*>(header + 1);
+	this->storage = std::shared_ptr<const void>(mapping, [size](const void* p) {
+		munmap(const_cast<void*>(p), size);
+	});
+	return true;
+}
+
+template<typename T>
+size_t StaticSearchTree<T>::size() const {
+	return this->count;
+}
+
+template<typename T>
+bool StaticSearchTree<T>::empty() const {
+	return this->count == 0;
+}
+
+template<typename T>
+size_t StaticSearchTree<T>::lowerBoundPosition(const T& key) const {
+	// The descendants of a node some levels below (as many as keys fit in a
+	// cache line) are contiguous, so they are requested while going down
+	const size_t prefetchStride = std::max<size_t>(1, 64 / sizeof(T));
+	const T* tree = this->keys;
+	size_t pos = 1;
+	while (pos <= this->count) {
+		__builtin_prefetch(tree + pos * prefetchStride);
+		pos = 2 * pos + (tree[pos] < key);
+	}
+	return lowerBoundFromExit(pos);
+}
+
+template<typename T>
+const T* StaticSearchTree<T>::lower_bound(const T& key) const {
+	size_t pos = lowerBoundPosition(key);
+	return (pos == 0) ? nullptr : &(this->keys[pos]);
+}
+
+template<typename T>
+const T* StaticSearchTree<T>::search(const T& key) const {
+	size_t pos = lowerBoundPosition(key);
+	if ((pos != 0) && (this->keys[pos] == key))
+		return &(this->keys[pos]);
+	return nullptr;
+}
+
+template<typename T>
+bool StaticSearchTree<T>::contains(const T& key) const {
+	return search(key) != nullptr;
+}
+
+template<typename T>
+void StaticSearchTree<T>::searchBatch(const T* keys, size_t count,
+		const T** results) const {
+	const T* tree = this->keys;
+	const unsigned int height = levels(this->count);
+	size_t positions[BATCH_LANES];
+	for (size_t i = 0; i < count; i += BATCH_LANES) {
+		size_t n = std::min(BATCH_LANES, count - i);
+		// Vector kernels go first, and the keys they leave are processed in
+		// lockstep one by one
+		size_t done = descendBatch(tree, this->count, keys + i, n, positions);
+		for (size_t j = done; j < n; ++j)
+			positions[j] = 1;
+		for (unsigned int level = 1; level < height; ++level)
+			for (size_t j = done; j < n; ++j)
+				positions[j] = 2 * positions[j] + (tree[positions[j]] < keys[i + j]);
+		for (size_t j = done; j < n; ++j)
+			if (positions[j] <= this->count)
+				positions[j] = 2 * positions[j]
+						+ (tree[positions[j]] < keys[i + j]);
+		for (size_t j = 0; j < n; ++j) {
+			size_t pos = lowerBoundFromExit(positions[j]);
+			results[i + j] =
+					((pos != 0) && (tree[pos] == keys[i + j])) ? tree + pos : nullptr;
+		}
+	}
+}
+
+template class StaticSearchTree<int> ;
+template class StaticSearchTree<float> ;
+template class StaticSearchTree<double> ;
+template class StaticSearchTree<std::string> ;
+
+} /* namespace tree */
@@ -0,0 +1,123 @@
+/**
+ * @file StaticSearchTree.h
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#ifndef SRC_TREE_STATICSEARCHTREE_H_
+#define SRC_TREE_STATICSEARCHTREE_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tree {
+
+/**
+ * This class implements an immutable search tree kept in a single array, in the
+ * Eytzinger (breadth-first) order: the children of the key at position X are at
+ * 2X and 2X+1, starting X at position 1. There are no pointers to follow, the
+ * top levels of the tree share a few cache lines, and a lookup goes down without
+ * branching on the comparisons (the next position is computed from them), while
+ * the keys some levels below are prefetched.
+ * It is meant for lookup tables which are built once (see
+ * BinarySearchTree::freeze) and queried many times. For trivially copyable keys,
+ * the array can be written to a file and mapped back in memory (mmap) as it is,
+ * so loading a table does not read nor allocate anything. Copies of a tree share
+ * its keys, which never change.
+ */
+template<typename T>
+class StaticSearchTree {
+public:
+	/**
+	 * Class constructor
+	 * @param[in] sortedKeys Keys of the tree, sorted in ascending order (repeated
+	 * keys are kept only once)
+	 */
+	explicit StaticSearchTree(std::vector<T> sortedKeys = std::vector<T>());
+	/**
+	 * Get the number of keys in the tree
+	 * @return Number of keys
+	 */
+	size_t size() const;
+	/**
+	 * Verifies whether the tree is empty
+	 * @return Returns true if there are no keys in the tree
+	 */
+	bool empty() const;
+	/**
+	 * Search a given key in the tree
+	 * @param[in] key Key to find
+	 * @return Returns a pointer to the key in the tree, or nullptr if it is not
+	 * found
+	 */
+	const T* search(const T& key) const;
+	/**
+	 * Verifies whether a key is in the tree
+	 * @param[in] key Key to find
+	 * @return Returns true if the key is in the tree
+	 */
+	bool contains(const T& key) const;
+	/**
+	 * Get the first key which is not lower than a given one
+	 * @param[in] key Key to compare with
+	 * @return Returns a pointer to the first key >= key in the tree, or nullptr
+	 * if there is none
+	 */
+	const T* lower_bound(const T& key) const;
+	/**
+	 * Search many keys at once. Lookups go down the tree in lockstep, so their
+	 * cache misses overlap, and for int, float and double keys they compare and
+	 * load (gather) several keys per instruction when the CPU supports AVX2
+	 * @param[in] keys Keys to find
+	 * @param[in] count Number of keys to find
+	 * @param[out] results For each key, a pointer to it in the tree, or nullptr if
+	 * it is not found
+	 */
+	void searchBatch(const T* keys, size_t count, const T** results) const;
+	/**
+	 * Write the tree to a file: a small header followed by the array as it is in
+	 * memory, so it can only be mapped on machines with the same byte order and
+	 * type sizes. Only trivially copyable keys can be written
+	 * @param[in] path Path of the file (it is replaced if it exists)
+	 * @return Returns whether the file has been written
+	 */
+	bool write(const std::string& path) const;
+	/**
+	 * Replace the tree by one written to a file, mapping the file in memory
+	 * (read-only) and using its array in place. The mapping lasts as long as the
+	 * tree or a copy of it
+	 * @param[in] path Path of the file
+	 * @return Returns whether the file has been mapped (otherwise the tree is not
+	 * changed)
+	 */
+	bool map(const std::string& path);
+private:
+	/**
+	 * Fill the array in the Eytzinger order with an in-order walk of the implicit
+	 * tree
+	 * @param[in] sortedKeys Keys sorted in ascending order
+	 * @param[out] array Array in the Eytzinger order
+	 * @param[in|out] next Position of the next key to take from sortedKeys
+	 * @param[in] pos Position of the subtree root in the array
+	 */
+	void build(std::vector<T>& sortedKeys, std::vector<T>& array, size_t& next,
+			size_t pos);
+	/**
+	 * Get the position of the first key which is not lower than a given one
+	 * @param[in] key Key to compare with
+	 * @return Position in the array, or 0 if there is none
+	 */
+	size_t lowerBoundPosition(const T& key) const;
+
+	// Memory which holds the array: a vector, or a mapped file
+	std::shared_ptr<const void> storage;
+	// Keys in the Eytzinger order, from position 1 (position 0 is not used)
+	const T* keys;
+	size_t count;
+};
+
+} /* namespace tree */
+
+#endif /* SRC_TREE_STATICSEARCHTREE_H_ */
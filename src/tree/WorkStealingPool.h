@@ -0,0 +1,273 @@
+/**
+ * @file WorkStealingPool.h
+ * @author Ronald T. Fernandez
+ * @version 1.0
+ */
+
+#ifndef SRC_TREE_WORKSTEALINGPOOL_H_
+#define SRC_TREE_WORKSTEALINGPOOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace tree {
+
+/**
+ * Set of tasks which a thread forks and then waits for (see WorkStealingPool)
+ */
+class TaskGroup {
+public:
+	TaskGroup() :
+			pending(0), error(), errorMutex() {
+	}
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+private:
+	friend class WorkStealingPool;
+	std::atomic<size_t> pending;
+	// Exception thrown by the first task of the group which failed
+	std::exception_ptr error;
+	std::mutex errorMutex;
+};
+
+/**
+ * This class implements a pool of threads for fork-join parallelism with work
+ * stealing. Every worker has a queue of its own: the tasks it forks are pushed at
+ * the back and it takes them back from there (the most recent ones first, whose
+ * data is still in its caches), while idle workers steal the oldest tasks (the
+ * biggest ones, in a recursive split) from the front of the queues of the others.
+ * A thread which waits for a group of tasks runs tasks in the meantime, so nested
+ * forks do not block the pool. Threads which are not workers (e.g. the one which
+ * starts a traversal) push their tasks to a shared queue, and they help too while
+ * they wait. A task which throws is still counted as finished, and its exception
+ * is thrown again by wait in the thread which forked it.
+ */
+class WorkStealingPool {
+public:
+	/**
+	 * Class constructor
+	 * @param[in] threads Number of threads running tasks, counting the thread which
+	 * waits for them (so threads - 1 workers are started)
+	 */
+	explicit WorkStealingPool(unsigned int threads =
+			std::thread::hardware_concurrency()) :
+			queues(), workers(), queued(0), sleepMutex(), wakeUp(), stopping(false) {
+		size_t nWorkers = std::max(1u, threads) - 1;
+		for (size_t i = 0; i <= nWorkers; ++i)
+			queues.emplace_back(new Queue());
+		for (size_t i = 0; i < nWorkers; ++i)
+			workers.emplace_back([this, i]() {
+				run(i);
+			});
+	}
+	/**
+	 * Class destructor. It waits for the workers to finish
+	 */
+	~WorkStealingPool() {
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			stopping = true;
+		}
+		wakeUp.notify_all();
+		for (std::thread& worker : workers)
+			worker.join();
+	}
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+	/**
+	 * Get the pool shared by the whole process, with a thread per core
+	 * @return Work-stealing pool
+	 */
+	static WorkStealingPool& instance() {
+		static WorkStealingPool pool;
+		return pool;
+	}
+	/**
+	 * Get the number of threads which run tasks (counting the waiting one)
+	 * @return Number of threads
+	 */
+	unsigned int size() const {
+		return static_cast<unsigned int>(workers.size() + 1);
+	}
+	/**
+	 * Fork a task. It may run in any thread of the pool
+	 * @param[in|out] group Group of the task
+	 * @param[in] task Task to run
+	 */
+	void submit(TaskGroup& group, std::function<void()> task) {
+		group.pending.fetch_add(1, std::memory_order_relaxed);
+		Queue& queue = *(queues[current()]);
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.tasks.push_back(Task { std::move(task), &group });
+		}
+		queued.fetch_add(1, std::memory_order_seq_cst);
+		if (!workers.empty()) {
+			// Taking the lock makes sure that a worker which is going to sleep
+			// either sees the task or gets the notification
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+			}
+			wakeUp.notify_one();
+		}
+	}
+	/**
+	 * Wait for the tasks of a group to finish, running tasks in the meantime. If
+	 * any of them has thrown, the exception of the first one is thrown again once
+	 * all of them have finished
+	 * @param[in] group Group of tasks
+	 */
+	void wait(TaskGroup& group) {
+		drain(group);
+		if (group.error) {
+			std::exception_ptr error = std::move(group.error);
+			group.error = nullptr;
+			std::rethrow_exception(error);
+		}
+	}
+	/**
+	 * Run a function in the calling thread and then wait for a group of tasks (see
+	 * wait). The tasks usually refer to the frame of the caller, so they are waited
+	 * for even if the function throws (then its exception is the one thrown)
+	 * @param[in|out] group Group of tasks
+	 * @param[in] function Function to run while the tasks run
+	 */
+	template<typename F>
+	void runAndWait(TaskGroup& group, F&& function) {
+		try {
+			function();
+		} catch (...) {
+			drain(group);
+			throw;
+		}
+		wait(group);
+	}
+private:
+	/**
+	 * Task in a queue
+	 */
+	struct Task {
+		std::function<void()> function;
+		TaskGroup* group;
+	};
+	/**
+	 * Queue of tasks, in a cache line of its own
+	 */
+	struct alignas(64) Queue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	/**
+	 * Wait for the tasks of a group to finish, running tasks in the meantime
+	 * @param[in] group Group of tasks
+	 */
+	void drain(TaskGroup& group) {
+		size_t self = current();
+		while (group.pending.load(std::memory_order_acquire) != 0)
+			if (!runOne(self))
+				std::this_thread::yield();
+	}
+	/**
+	 * Get the queue of the calling thread
+	 * @return Position of the queue (the shared one for threads which are not
+	 * workers of this pool)
+	 */
+	size_t current() const {
+		return (worker().first == this) ? worker().second : queues.size() - 1;
+	}
+	/**
+	 * Get the pool and the position of the calling thread, if it is a worker
+	 * @return Pool (or nullptr) and position of the worker
+	 */
+	static std::pair<const WorkStealingPool*, size_t>& worker() {
+		thread_local std::pair<const WorkStealingPool*, size_t> self(nullptr, 0);
+		return self;
+	}
+	/**
+	 * Run a task: the newest one of a queue, or the oldest one of any other
+	 * @param[in] self Queue of the calling thread
+	 * @return Returns false if there were no tasks
+	 */
+	bool runOne(size_t self) {
+		Task task;
+		bool found = false;
+		{
+			Queue& queue = *(queues[self]);
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (!queue.tasks.empty()) {
+				task = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+				found = true;
+			}
+		}
+		for (size_t i = 1; !found && (i < queues.size()); ++i) {
+			Queue& queue = *(queues[(self + i) % queues.size()]);
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (!queue.tasks.empty()) {
+				task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+				found = true;
+			}
+		}
+		if (!found)
+			return false;
+		queued.fetch_sub(1, std::memory_order_relaxed);
+		// The task is counted as finished however it ends, or the thread waiting
+		// for its group would never stop. An exception is kept for that thread
+		struct Finish {
+			TaskGroup* group;
+			~Finish() {
+				group->pending.fetch_sub(1, std::memory_order_release);
+			}
+		} finish { task.group };
+		try {
+			task.function();
+		} catch (...) {
+			std::lock_guard<std::mutex> lock(task.group->errorMutex);
+			if (!task.group->error)
+				task.group->error = std::current_exception();
+		}
+		return true;
+	}
+	/**
+	 * Loop of a worker: run tasks, and sleep while there are none
+	 * @param[in] index Position of the worker
+	 */
+	void run(size_t index) {
+		worker() = std::make_pair(this, index);
+		for (;;) {
+			if (runOne(index))
+				continue;
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			wakeUp.wait(lock, [this]() {
+				return stopping || (queued.load(std::memory_order_seq_cst) != 0);
+			});
+			if (stopping)
+				return;
+		}
+	}
+
+	// A queue per worker, and the shared one at the end
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+	// Number of tasks in all the queues
+	std::atomic<size_t> queued;
+	std::mutex sleepMutex;
+	std::condition_variable wakeUp;
+	bool stopping;
+};
+
+} /* namespace tree */
+
+#endif /* SRC_TREE_WORKSTEALINGPOOL_H_ */